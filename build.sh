@@ -17,15 +17,70 @@ cd build
 CXX_FLAGS=$(pkg-config --cflags gtkmm-3.0 libnotify ayatana-appindicator3-0.1)
 LD_FLAGS=$(pkg-config --libs gtkmm-3.0 libnotify ayatana-appindicator3-0.1)
 
+# The core library: reminder model, in-memory store, scheduler, time
+# utilities, storage engines, history, backups and instrumentation. It is
+# compiled without the GTK flags, so a GTK header creeping into it breaks
+# the build, and every binary below links against it.
+CORE_FLAGS="-I/usr/include/sqlite3"
+
+echo "Compiling core library..."
+g++ -c ../src/clock.cpp $CORE_FLAGS
+g++ -c ../src/time_utils.cpp $CORE_FLAGS
+g++ -c ../src/scheduler.cpp $CORE_FLAGS
+g++ -c ../src/reminder_store.cpp $CORE_FLAGS
+g++ -c ../src/simulation.cpp $CORE_FLAGS
+g++ -c ../src/sqlite_storage.cpp $CORE_FLAGS
+g++ -c ../src/log_storage.cpp $CORE_FLAGS
+g++ -c ../src/reminder_snapshot.cpp $CORE_FLAGS
+g++ -c ../src/undo_journal.cpp $CORE_FLAGS
+g++ -c ../src/delivery_history.cpp $CORE_FLAGS
+g++ -c ../src/database_backup.cpp $CORE_FLAGS
+g++ -c ../src/database_maintenance.cpp $CORE_FLAGS
+g++ -c ../src/metrics.cpp $CORE_FLAGS
+g++ -c ../src/control_channel.cpp $CORE_FLAGS
+g++ -c ../src/watchdog.cpp $CORE_FLAGS
+g++ -c ../src/notification_sink.cpp $CORE_FLAGS
+g++ -c ../src/notification_sinks.cpp $CORE_FLAGS
+g++ -c ../src/reminder_query.cpp $CORE_FLAGS
+g++ -c ../src/ics_parser.cpp $CORE_FLAGS
+g++ -c ../src/ics_subscriptions.cpp $CORE_FLAGS
+ar rcs libreminder-core.a clock.o time_utils.o scheduler.o reminder_store.o simulation.o sqlite_storage.o log_storage.o reminder_snapshot.o undo_journal.o delivery_history.o database_backup.o database_maintenance.o metrics.o control_channel.o watchdog.o notification_sink.o notification_sinks.o reminder_query.o ics_parser.o ics_subscriptions.o
+
 # Compile each source file
 echo "Compiling source files..."
 g++ -c ../src/main.cpp $CXX_FLAGS -I/usr/include/sqlite3
 g++ -c ../src/reminder_app.cpp $CXX_FLAGS -I/usr/include/sqlite3
 g++ -c ../src/reminder_popup_window.cpp $CXX_FLAGS -I/usr/include/sqlite3
+g++ -c ../src/reminder_editor.cpp $CXX_FLAGS
+g++ -c ../src/notification_bridge.cpp $CXX_FLAGS
+g++ -c ../src/loadgen.cpp $CORE_FLAGS
+g++ -c ../src/storage_bench.cpp $CORE_FLAGS
+g++ -c ../src/ui_bench.cpp $CORE_FLAGS
+g++ -c ../src/core_tests.cpp $CORE_FLAGS
+g++ -c ../src/reminder_service.cpp $CXX_FLAGS -I/usr/include/sqlite3
+g++ -c ../src/reminderd.cpp $CXX_FLAGS -I/usr/include/sqlite3
 
 # Link all objects
 echo "Linking objects..."
-g++ main.o reminder_app.o reminder_popup_window.o -o reminder $LD_FLAGS -lsqlite3 -lpthread
+g++ main.o reminder_app.o reminder_popup_window.o reminder_editor.o notification_bridge.o libreminder-core.a -o reminder $LD_FLAGS -lsqlite3 -lpthread
+
+# Soak and load generator, driven against a running instance
+g++ loadgen.o libreminder-core.a -o reminder-loadgen -lpthread
+
+# Storage engine benchmark
+g++ storage_bench.o libreminder-core.a -o reminder-storage-bench -lsqlite3
+
+# GUI benchmark under a headless display
+g++ ui_bench.o libreminder-core.a -o reminder-ui-bench -lsqlite3
+
+# Multi-user service for shared hosts; needs libnotify but not GTK
+g++ reminderd.o reminder_service.o notification_bridge.o libreminder-core.a -o reminderd $(pkg-config --libs libnotify) -lsqlite3 -lpthread
+
+# Checks for the core library; links nothing but the library, and a
+# failing check stops the build
+g++ core_tests.o libreminder-core.a -o reminder-core-tests -lsqlite3 -lpthread
+echo "Running core tests..."
+./reminder-core-tests
 
 # Check if build was successful
 if [ -f reminder ]; then
@@ -0,0 +1,69 @@
+#include "clock.h"
+
+std::tm Clock::local_time(time_point when) const
+{
+    // localtime_r is comparatively expensive and callers tend to convert the
+    // same second many times in a row, so remember the last conversion
+    thread_local std::time_t cached_time = -1;
+    thread_local std::tm cached_tm;
+
+    std::time_t when_time = std::chrono::system_clock::to_time_t(when);
+    if (when_time != cached_time)
+    {
+        localtime_r(&when_time, &cached_tm);
+        cached_time = when_time;
+    }
+    return cached_tm;
+}
+
+Clock::time_point Clock::from_local_time(std::tm local_tm) const
+{
+    // Let mktime work out whether DST applies
+    local_tm.tm_isdst = -1;
+    return std::chrono::system_clock::from_time_t(std::mktime(&local_tm));
+}
+
+Clock::time_point SystemClock::now() const
+{
+    return std::chrono::system_clock::now();
+}
+
+void SystemClock::wait_until(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, time_point when)
+{
+    cv.wait_until(lock, when);
+}
+
+SystemClock &system_clock()
+{
+    static SystemClock clock;
+    return clock;
+}
+
+ManualClock::ManualClock(time_point start) : m_now(start)
+{
+}
+
+Clock::time_point ManualClock::now() const
+{
+    return m_now;
+}
+
+void ManualClock::wait_until(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, time_point when)
+{
+    // Virtual time does not pass while waiting; whoever drives the clock
+    // calls Scheduler::pop_due directly instead of relying on the thread
+    if (m_now < when)
+    {
+        cv.wait(lock);
+    }
+}
+
+void ManualClock::set(time_point when)
+{
+    m_now = when;
+}
+
+void ManualClock::advance(std::chrono::system_clock::duration by)
+{
+    m_now += by;
+}
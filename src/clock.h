@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+
+// Source of time for the scheduler and the time helpers. The application
+// uses SystemClock; the simulator uses ManualClock to replay days of
+// scheduling in seconds.
+class Clock
+{
+public:
+    typedef std::chrono::system_clock::time_point time_point;
+
+    virtual ~Clock() {}
+
+    virtual time_point now() const = 0;
+
+    // Block on the condition variable until when, or until it is notified
+    virtual void wait_until(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, time_point when) = 0;
+
+    // Local calendar conversions
+    std::tm local_time(time_point when) const;
+    time_point from_local_time(std::tm local_tm) const;
+};
+
+class SystemClock : public Clock
+{
+public:
+    time_point now() const override;
+    void wait_until(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, time_point when) override;
+};
+
+// Shared instance used when no clock is injected
+SystemClock &system_clock();
+
+// Virtual time that only moves when told to
+class ManualClock : public Clock
+{
+public:
+    explicit ManualClock(time_point start);
+
+    time_point now() const override;
+    void wait_until(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, time_point when) override;
+
+    void set(time_point when);
+    void advance(std::chrono::system_clock::duration by);
+
+private:
+    time_point m_now;
+};
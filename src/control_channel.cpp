@@ -0,0 +1,301 @@
+#include "control_channel.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Longest request line accepted before the client is dropped
+static const size_t MAX_LINE_LENGTH = 64 * 1024;
+
+std::string control_socket_path()
+{
+    const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir)
+    {
+        return std::string(runtime_dir) + "/reminder-app.sock";
+    }
+
+    return "/tmp/reminder-app-" + std::to_string(getuid()) + ".sock";
+}
+
+std::string instance_lock_path()
+{
+    return control_socket_path() + ".lock";
+}
+
+std::vector<std::string> split_fields(const std::string &line)
+{
+    std::vector<std::string> fields;
+    size_t start = 0;
+
+    while (true)
+    {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab - start));
+        if (tab == std::string::npos)
+            break;
+        start = tab + 1;
+    }
+
+    return fields;
+}
+
+std::string join_fields(const std::vector<std::string> &fields)
+{
+    std::string line;
+
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        if (i > 0)
+            line += '\t';
+
+        // Separators inside a field would change the framing
+        for (char c : fields[i])
+        {
+            line += (c == '\t' || c == '\n' || c == '\r') ? ' ' : c;
+        }
+    }
+
+    return line;
+}
+
+static bool fill_address(const std::string &path, sockaddr_un &address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Control socket path too long: " << path << std::endl;
+        return false;
+    }
+
+    std::strcpy(address.sun_path, path.c_str());
+    return true;
+}
+
+static void write_all(int fd, const std::string &data)
+{
+    size_t sent = 0;
+
+    while (sent < data.size())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        sent += static_cast<size_t>(n);
+    }
+}
+
+ControlServer::ControlServer() : m_fd(-1)
+{
+}
+
+ControlServer::~ControlServer()
+{
+    close();
+}
+
+bool ControlServer::listen(const std::string &path)
+{
+    sockaddr_un address;
+    if (!fill_address(path, address))
+        return false;
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd == -1)
+    {
+        std::cerr << "Failed to create control socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    unlink(path.c_str());
+
+    // Only the owner may connect
+    mode_t old_mask = umask(0077);
+    int rc = bind(m_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    umask(old_mask);
+
+    if (rc == -1 || ::listen(m_fd, 8) == -1)
+    {
+        std::cerr << "Failed to bind control socket " << path << ": " << std::strerror(errno) << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_path = path;
+    return true;
+}
+
+void ControlServer::close()
+{
+    for (auto &entry : m_buffers)
+    {
+        ::close(entry.first);
+    }
+    m_buffers.clear();
+
+    if (m_fd != -1)
+    {
+        ::close(m_fd);
+        unlink(m_path.c_str());
+        m_fd = -1;
+    }
+}
+
+int ControlServer::fd() const
+{
+    return m_fd;
+}
+
+int ControlServer::accept_client()
+{
+    if (m_fd == -1)
+        return -1;
+
+    int client = accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client == -1)
+        return -1;
+
+    m_buffers[client] = std::string();
+    return client;
+}
+
+bool ControlServer::read_client(int client, const CommandHandler &handler)
+{
+    auto it = m_buffers.find(client);
+    if (it == m_buffers.end())
+        return false;
+
+    char chunk[4096];
+    while (true)
+    {
+        ssize_t n = recv(client, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+        {
+            close_client(client);
+            return false;
+        }
+
+        it->second.append(chunk, static_cast<size_t>(n));
+    }
+
+    // Hand out complete lines; the handler may reply or close the client
+    size_t newline;
+    while ((it = m_buffers.find(client)) != m_buffers.end() &&
+           (newline = it->second.find('\n')) != std::string::npos)
+    {
+        std::string line = it->second.substr(0, newline);
+        it->second.erase(0, newline + 1);
+        handler(client, split_fields(line));
+    }
+
+    if (it == m_buffers.end())
+        return false;
+
+    if (it->second.size() > MAX_LINE_LENGTH)
+    {
+        std::cerr << "Dropping control client sending an oversized request" << std::endl;
+        close_client(client);
+        return false;
+    }
+
+    return true;
+}
+
+void ControlServer::reply(int client, const std::string &line)
+{
+    if (m_buffers.find(client) == m_buffers.end())
+        return;
+
+    write_all(client, line + "\n");
+}
+
+void ControlServer::close_client(int client)
+{
+    auto it = m_buffers.find(client);
+    if (it == m_buffers.end())
+        return;
+
+    ::close(client);
+    m_buffers.erase(it);
+}
+
+ControlClient::ControlClient() : m_fd(-1)
+{
+}
+
+ControlClient::~ControlClient()
+{
+    close();
+}
+
+bool ControlClient::connect(const std::string &path)
+{
+    sockaddr_un address;
+    if (!fill_address(path, address))
+        return false;
+
+    close();
+    m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_fd == -1)
+        return false;
+
+    if (::connect(m_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1)
+    {
+        std::cerr << "Failed to connect to " << path << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void ControlClient::close()
+{
+    if (m_fd != -1)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_buffer.clear();
+}
+
+std::string ControlClient::request(const std::vector<std::string> &fields)
+{
+    if (m_fd == -1)
+        return std::string();
+
+    write_all(m_fd, join_fields(fields) + "\n");
+
+    size_t newline;
+    while ((newline = m_buffer.find('\n')) == std::string::npos)
+    {
+        char chunk[4096];
+        ssize_t n = recv(m_fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            close();
+            return std::string();
+        }
+        m_buffer.append(chunk, static_cast<size_t>(n));
+    }
+
+    std::string line = m_buffer.substr(0, newline);
+    m_buffer.erase(0, newline + 1);
+    return line;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Local control channel for driving a running instance from scripts and the
+// load generator. Requests and replies are single lines of tab separated
+// fields over a Unix socket that only the user can open:
+//
+//   add <HH:MM[:SS]> <title>       -> ok <id>
+//   edit <id> <HH:MM[:SS]> <title> -> ok <id>
+//   toggle <id>                    -> ok <id>
+//   delete <id>                    -> ok <id>
+//   stats                          -> ok key=value...
+//   reset                          -> ok, clears the latency statistics
+//   ui <action> [<arg>]            -> ok ms=<until the main loop is idle>
+//
+// ui actions script the windows for benchmarks: show, hide, popup,
+// popup-hide, scroll <fraction>, edit <id> (opens the edit dialog),
+// close-dialog, refresh (rebuild every row), refresh-popup, filter <index>.
+//
+// Failures reply "error <message>". Neither side depends on GTK; the
+// application watches the descriptors from its main loop.
+
+// $XDG_RUNTIME_DIR/reminder-app.sock, or a per-user path in /tmp
+std::string control_socket_path();
+
+// Lock file held by the running instance, next to its socket, so an
+// instance started with another XDG_RUNTIME_DIR (e.g. by a benchmark) is
+// independent of the user's own
+std::string instance_lock_path();
+
+std::vector<std::string> split_fields(const std::string &line);
+std::string join_fields(const std::vector<std::string> &fields);
+
+class ControlServer
+{
+public:
+    typedef std::function<void(int client, const std::vector<std::string> &fields)> CommandHandler;
+
+    ControlServer();
+    virtual ~ControlServer();
+
+    // Bind the socket, replacing a stale one. The caller holds the instance
+    // lock, so nobody else is serving on the path.
+    bool listen(const std::string &path);
+    void close();
+    int fd() const;
+
+    // Accept one pending connection; returns the client descriptor or -1
+    int accept_client();
+
+    // Read what the client sent and run the handler once per complete line.
+    // Returns false once the client has disconnected.
+    bool read_client(int client, const CommandHandler &handler);
+
+    // Replies may be sent later, from another main loop callback; a reply to
+    // a client that has gone away is dropped
+    void reply(int client, const std::string &line);
+    void close_client(int client);
+
+private:
+    int m_fd;
+    std::string m_path;
+    std::map<int, std::string> m_buffers; // Partial input per connected client
+};
+
+class ControlClient
+{
+public:
+    ControlClient();
+    virtual ~ControlClient();
+
+    bool connect(const std::string &path);
+    void close();
+
+    // Send one request and wait for its reply line. Empty on failure.
+    std::string request(const std::vector<std::string> &fields);
+
+private:
+    int m_fd;
+    std::string m_buffer;
+};
@@ -0,0 +1,907 @@
+// Checks for the core library: scheduling rules, time helpers, the
+// in-memory store, the storage engines, the startup snapshot, the calendar
+// rules, the query command and the notification sinks. build.sh runs it
+// after linking; it exits non-zero if any check fails, which stops the
+// build.
+#include "clock.h"
+#include "ics_parser.h"
+#include "log_storage.h"
+#include "notification_sinks.h"
+#include "reminder_query.h"
+#include "reminder_snapshot.h"
+#include "reminder_store.h"
+#include "scheduler.h"
+#include "sqlite_storage.h"
+#include "time_utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int g_checks = 0;
+static int g_failures = 0;
+static std::string g_dir;
+static std::vector<std::string> g_scratch;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(bool ok, const char *expression, const char *file, int line)
+{
+    g_checks++;
+    if (!ok)
+    {
+        g_failures++;
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    }
+}
+
+// A file in the scratch directory, removed with its SQLite companions at exit
+static std::string scratch(const std::string &name)
+{
+    std::string path = g_dir + "/" + name;
+    g_scratch.push_back(path);
+    return path;
+}
+
+static void remove_scratch()
+{
+    for (const auto &path : g_scratch)
+    {
+        for (const char *suffix : {"", "-wal", "-shm", "-journal", ".tmp"})
+        {
+            unlink((path + suffix).c_str());
+        }
+    }
+    rmdir(g_dir.c_str());
+}
+
+// A local wall-clock time in the test time zone
+static Clock::time_point local(int year, int month, int day, int hour, int minute, int second = 0)
+{
+    std::tm tm_buf = {};
+    tm_buf.tm_year = year - 1900;
+    tm_buf.tm_mon = month - 1;
+    tm_buf.tm_mday = day;
+    tm_buf.tm_hour = hour;
+    tm_buf.tm_min = minute;
+    tm_buf.tm_sec = second;
+    return system_clock().from_local_time(tm_buf);
+}
+
+static Reminder make_reminder(int id, const std::string &time, const std::string &title = "Reminder")
+{
+    Reminder reminder{};
+    reminder.id = id;
+    reminder.title = title;
+    reminder.time = time;
+    return reminder;
+}
+
+static bool has_deadline(const std::vector<Deadline> &deadlines, int reminder_id, DeadlineKind kind)
+{
+    return std::any_of(deadlines.begin(), deadlines.end(), [&](const Deadline &deadline)
+                       { return deadline.reminder_id == reminder_id && deadline.kind == kind; });
+}
+
+static void test_time_utils()
+{
+    int hour, minute, second;
+    CHECK(parse_reminder_time("09:05", hour, minute, second) && hour == 9 && minute == 5 && second == 0);
+    CHECK(parse_reminder_time("23:59:58", hour, minute, second) && hour == 23 && minute == 59 && second == 58);
+    CHECK(!is_valid_reminder_time("24:00"));
+    CHECK(!is_valid_reminder_time("12:60"));
+    CHECK(!is_valid_reminder_time("9:00"));
+    CHECK(!is_valid_reminder_time("12:00:5"));
+    CHECK(!is_valid_reminder_time("ab:cd"));
+
+    CHECK(format_reminder_time(7, 3, 0) == "07:03");
+    CHECK(format_reminder_time(7, 3, 9) == "07:03:09");
+    CHECK(shift_reminder_time("23:50", 15) == "00:05");
+    CHECK(shift_reminder_time("00:10:30", -20) == "23:50:30");
+    CHECK(shift_reminder_time("bad", 15) == "bad");
+
+    CHECK(convert_to_12hour_format("00:05") == "12:05 AM");
+    CHECK(convert_to_12hour_format("12:00") == "12:00 PM");
+    CHECK(convert_to_12hour_format("13:45:30") == "01:45:30 PM");
+
+    // Due during its minute, or its second, then tomorrow's
+    ManualClock clock(local(2024, 1, 15, 9, 0, 30));
+    CHECK(next_occurrence(clock, "09:00", false) == local(2024, 1, 15, 9, 0));
+    CHECK(next_occurrence(clock, "09:00:00", false) == local(2024, 1, 16, 9, 0));
+    CHECK(next_occurrence(clock, "09:00:30", false) == local(2024, 1, 15, 9, 0, 30));
+    CHECK(next_occurrence(clock, "10:00", true) == local(2024, 1, 16, 10, 0));
+    CHECK(next_occurrence(clock, "25:00", false) == Clock::time_point::max());
+    CHECK(next_midnight(clock) == local(2024, 1, 16, 0, 0));
+}
+
+static void test_time_utils_dst()
+{
+    // 2024-03-10 springs forward at 02:00: the day is 23 hours long
+    ManualClock spring(local(2024, 3, 10, 1, 0));
+    CHECK(next_occurrence(spring, "03:30", false) - spring.now() == std::chrono::minutes(90));
+    CHECK(next_midnight(spring) - spring.now() == std::chrono::hours(22));
+    CHECK(next_occurrence(spring, "00:30", false) == local(2024, 3, 11, 0, 30));
+
+    // 2024-11-03 falls back at 02:00: the day is 25 hours long
+    ManualClock fall(local(2024, 11, 3, 0, 0));
+    CHECK(next_occurrence(fall, "12:00", false) - fall.now() == std::chrono::hours(13));
+    CHECK(next_midnight(fall) - fall.now() == std::chrono::hours(25));
+}
+
+static void test_scheduler_arm()
+{
+    ManualClock clock(local(2024, 1, 15, 9, 0, 30));
+    Scheduler scheduler(clock);
+    Scheduler::time_point when;
+
+    scheduler.arm(make_reminder(1, "10:00"));
+    CHECK(scheduler.next_fire(1, when) && when == local(2024, 1, 15, 10, 0));
+
+    // Already past today, or already fired today
+    scheduler.arm(make_reminder(2, "08:00"));
+    CHECK(scheduler.next_fire(2, when) && when == local(2024, 1, 16, 8, 0));
+    Reminder fired = make_reminder(3, "10:00");
+    fired.notified = true;
+    scheduler.arm(fired);
+    CHECK(scheduler.next_fire(3, when) && when == local(2024, 1, 16, 10, 0));
+
+    // Never armed: completed, or a time that can't be read
+    Reminder completed = make_reminder(4, "11:00");
+    completed.completed = true;
+    scheduler.arm(completed);
+    CHECK(!scheduler.next_fire(4, when));
+    scheduler.arm(make_reminder(5, "99:99"));
+    CHECK(!scheduler.next_fire(5, when));
+
+    // Completing an armed reminder drops every deadline it had
+    scheduler.schedule(1, DeadlineKind::Snooze, local(2024, 1, 15, 9, 30));
+    Reminder done = make_reminder(1, "10:00");
+    done.completed = true;
+    scheduler.arm(done);
+    CHECK(!scheduler.next_fire(1, when));
+    CHECK(scheduler.size() == 2);
+
+    CHECK(scheduler.next_deadline(when) && when == local(2024, 1, 16, 8, 0));
+}
+
+static void test_scheduler_escalate()
+{
+    ManualClock clock(local(2024, 1, 15, 9, 0));
+    Scheduler scheduler(clock);
+
+    Reminder reminder = make_reminder(1, "08:55");
+    reminder.notified = true;
+    reminder.escalate_minutes = 5;
+    scheduler.arm(reminder);
+
+    std::vector<Deadline> upcoming = scheduler.upcoming(10);
+    CHECK(upcoming.size() == 2);
+    CHECK(upcoming.size() == 2 && upcoming[0].kind == DeadlineKind::Escalation &&
+          upcoming[0].when == local(2024, 1, 15, 9, 5));
+
+    // Arming again keeps the pending escalation where it is
+    clock.advance(std::chrono::minutes(1));
+    scheduler.arm(reminder);
+    upcoming = scheduler.upcoming(10);
+    CHECK(!upcoming.empty() && upcoming[0].when == local(2024, 1, 15, 9, 5));
+
+    // After it fires, escalate() queues the next one from now
+    std::vector<Deadline> due = scheduler.pop_due(local(2024, 1, 15, 9, 5));
+    CHECK(due.size() == 1 && due[0].kind == DeadlineKind::Escalation);
+    clock.set(local(2024, 1, 15, 9, 5));
+    scheduler.escalate(reminder);
+    upcoming = scheduler.upcoming(10);
+    CHECK(!upcoming.empty() && upcoming[0].kind == DeadlineKind::Escalation &&
+          upcoming[0].when == local(2024, 1, 15, 9, 10));
+
+    // A snooze stands in for the escalation
+    Scheduler snoozed(clock);
+    snoozed.schedule(1, DeadlineKind::Snooze, local(2024, 1, 15, 9, 20));
+    snoozed.arm(reminder);
+    CHECK(!has_deadline(snoozed.upcoming(10), 1, DeadlineKind::Escalation));
+
+    // No escalation for a reminder that hasn't fired, or without a policy
+    reminder.notified = false;
+    scheduler.arm(reminder);
+    CHECK(!has_deadline(scheduler.upcoming(10), 1, DeadlineKind::Escalation));
+    Reminder once = make_reminder(2, "08:00");
+    once.notified = true;
+    scheduler.escalate(once);
+    CHECK(!has_deadline(scheduler.upcoming(10), 2, DeadlineKind::Escalation));
+}
+
+static void test_scheduler_preload()
+{
+    ManualClock clock(local(2024, 1, 15, 9, 0));
+    Scheduler scheduler(clock);
+
+    scheduler.preload({Deadline{local(2024, 1, 15, 9, 30), 100, DeadlineKind::Primary},
+                       Deadline{local(2024, 1, 15, 9, 40), 101, DeadlineKind::Primary},
+                       Deadline{local(2024, 1, 15, 9, 50), 102, DeadlineKind::Primary}});
+    scheduler.schedule(7, DeadlineKind::Snooze, local(2024, 1, 15, 9, 35));
+    CHECK(scheduler.size() == 4);
+
+    // Arming a preloaded reminder supersedes its preloaded deadline
+    scheduler.arm(make_reminder(101, "11:00"));
+    Scheduler::time_point when;
+    CHECK(scheduler.next_fire(101, when) && when == local(2024, 1, 15, 11, 0));
+    CHECK(scheduler.next_fire(102, when) && when == local(2024, 1, 15, 9, 50));
+
+    // Queued and preloaded deadlines come out merged in fire order
+    std::vector<Deadline> due = scheduler.pop_due(local(2024, 1, 15, 9, 45));
+    CHECK(due.size() == 2);
+    CHECK(due.size() == 2 && due[0].reminder_id == 100 && due[1].reminder_id == 7);
+    CHECK(scheduler.pop_due(local(2024, 1, 15, 9, 45)).empty());
+
+    // Once the reminders are armed one by one the run is dropped
+    scheduler.drop_preloaded();
+    CHECK(!scheduler.next_fire(102, when));
+    CHECK(scheduler.size() == 1);
+    due = scheduler.pop_due(local(2024, 1, 15, 12, 0));
+    CHECK(due.size() == 1 && due[0].reminder_id == 101);
+}
+
+static void test_reminder_store()
+{
+    ReminderStore store;
+    Reminder work = make_reminder(1, "09:00", "Standup");
+    work.tags = {"work"};
+    work.priority = PRIORITY_HIGH;
+    Reminder home = make_reminder(2, "18:00", "Groceries");
+    home.tags = {"home"};
+    home.priority = PRIORITY_LOW;
+    Reminder done = make_reminder(3, "10:00", "Report");
+    done.tags = {"work"};
+    done.completed = true;
+    Reminder fired = make_reminder(4, "08:00", "Pills");
+    fired.notified = true;
+    for (const auto &reminder : {work, home, done, fired})
+    {
+        store.upsert(reminder);
+    }
+
+    ReminderFilter filter;
+    CHECK(store.query(filter) == std::vector<int>({1, 2, 3, 4}));
+    filter.hide_completed = true;
+    CHECK(store.query(filter) == std::vector<int>({1, 2, 4}));
+    filter.pending_today = true;
+    CHECK(store.query(filter) == std::vector<int>({1, 2}));
+
+    filter = ReminderFilter();
+    filter.tag = "work";
+    CHECK(store.query(filter) == std::vector<int>({1, 3}));
+    filter.min_priority = PRIORITY_HIGH;
+    CHECK(store.query(filter) == std::vector<int>({1}));
+    filter.tag = "nowhere";
+    CHECK(store.query(filter).empty());
+
+    CHECK(store.fired_count() == 1);
+    CHECK(store.tags() == std::vector<std::string>({"home", "work"}));
+
+    // Updates move a reminder between indexes
+    work.completed = true;
+    store.upsert(work);
+    store.remove(2);
+    filter = ReminderFilter();
+    filter.hide_completed = true;
+    CHECK(store.query(filter) == std::vector<int>({4}));
+    CHECK(store.tags() == std::vector<std::string>({"work"}));
+    CHECK(store.size() == 3 && !store.find(2));
+}
+
+static off_t file_size(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+static std::vector<Reminder> load_log(const std::string &path)
+{
+    LogStorage log(false);
+    std::vector<Reminder> reminders;
+    if (log.open(path))
+        log.load_all(reminders);
+    return reminders;
+}
+
+static void test_log_storage_replay()
+{
+    std::string path = scratch("reminders.log");
+
+    int first, second;
+    {
+        LogStorage log(false);
+        CHECK(log.open(path));
+        first = log.insert(make_reminder(0, "09:00", "First"));
+        second = log.insert(make_reminder(0, "10:00", "Second"));
+
+        // A batch is one record
+        CHECK(log.begin());
+        log.insert(make_reminder(0, "11:00", "Third"));
+        log.set_flag(first, ReminderFlag::Completed, true);
+        log.remove(second);
+        CHECK(log.commit());
+        CHECK(log.records() == 5);
+
+        // A rolled back batch leaves the ids as begin() found them
+        CHECK(log.begin());
+        int dropped = log.insert(make_reminder(0, "15:00", "Dropped"));
+        log.remove(dropped);
+        log.remove(first);
+        log.rollback();
+        CHECK(!log.restore(make_reminder(first, "09:00", "First")));
+        CHECK(log.insert(make_reminder(0, "16:00", "Again")) == dropped);
+        CHECK(log.remove(dropped));
+    }
+
+    std::vector<Reminder> loaded = load_log(path);
+    CHECK(loaded.size() == 2);
+    CHECK(loaded.size() == 2 && loaded[0].id == first && loaded[0].completed && loaded[1].title == "Third");
+
+    // A record torn by a crash is cut off, and the rest is kept
+    off_t whole = file_size(path);
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.write("\x20\x00\x00\x00\x12\x34", 6);
+    }
+    CHECK(load_log(path).size() == 2);
+    CHECK(file_size(path) == whole);
+
+    // A batch torn halfway is dropped as a whole
+    {
+        LogStorage log(false);
+        CHECK(log.open(path));
+        log.begin();
+        log.insert(make_reminder(0, "12:00", "Fourth"));
+        log.insert(make_reminder(0, "13:00", "Fifth"));
+        log.commit();
+    }
+    off_t with_batch = file_size(path);
+    CHECK(truncate(path.c_str(), whole + (with_batch - whole) / 2) == 0);
+    loaded = load_log(path);
+    CHECK(loaded.size() == 2);
+    CHECK(file_size(path) == whole);
+
+    // Appends after the cut land where it was
+    {
+        LogStorage log(false);
+        CHECK(log.open(path));
+        CHECK(log.insert(make_reminder(0, "14:00", "Sixth")) != -1);
+    }
+    loaded = load_log(path);
+    CHECK(loaded.size() == 3 && loaded.back().title == "Sixth");
+}
+
+// An update to a reminder deleted underneath it fails, in either engine,
+// and leaves it deleted
+static void test_stale_update()
+{
+    SqliteStorage sqlite(false);
+    LogStorage log(false);
+    CHECK(sqlite.open(scratch("stale.db")));
+    CHECK(log.open(scratch("stale.log")));
+
+    for (StorageEngine *engine : {static_cast<StorageEngine *>(&sqlite), static_cast<StorageEngine *>(&log)})
+    {
+        Reminder reminder = make_reminder(0, "09:00", "Edited elsewhere");
+        reminder.id = engine->insert(reminder);
+        CHECK(engine->update(reminder, false));
+        CHECK(engine->remove(reminder.id));
+
+        reminder.title = "Edited here";
+        CHECK(!engine->update(reminder, false));
+        std::vector<Reminder> loaded;
+        CHECK(engine->load_all(loaded) && loaded.empty());
+    }
+    CHECK(!sqlite.contains(1));
+}
+
+static void test_snapshot()
+{
+    std::string path = scratch("reminders.snapshot");
+    ManualClock clock(local(2024, 1, 15, 9, 0));
+
+    std::map<int, Reminder> reminders;
+    reminders[1] = make_reminder(1, "10:00", "Alpha");
+    reminders[2] = make_reminder(2, "08:30:15", "Beta");
+    reminders[2].notified = true;
+    reminders[3] = make_reminder(3, "12:00", "Done");
+    reminders[3].completed = true;
+    reminders[4] = make_reminder(4, "09:00", "Gamma");
+    reminders[4].notified = true;
+    CHECK(write_reminder_snapshot(path, reminders, 42, clock));
+
+    ReminderSnapshot snapshot;
+    std::string error;
+    CHECK(snapshot.open(path, error));
+    CHECK(snapshot.size() == 3);
+    CHECK(snapshot.sync_version() == 42);
+    if (snapshot.size() == 3)
+    {
+        // Sorted by time of day; completed reminders left out
+        CHECK(snapshot.entry(0).id == 2 && snapshot.title(snapshot.entry(0)) == "Beta");
+        CHECK(snapshot.entry(0).seconds == 8 * 3600 + 30 * 60 + 15);
+        CHECK(snapshot.entry(1).id == 4 && snapshot.entry(2).id == 1);
+    }
+
+    // Same rules as Scheduler::arm: fired today means tomorrow
+    std::vector<Deadline> deadlines = snapshot.primary_deadlines(clock);
+    CHECK(deadlines.size() == 3);
+    if (deadlines.size() == 3)
+    {
+        CHECK(deadlines[0].reminder_id == 1 && deadlines[0].when == local(2024, 1, 15, 10, 0));
+        CHECK(deadlines[1].reminder_id == 2 && deadlines[1].when == local(2024, 1, 16, 8, 30, 15));
+        CHECK(deadlines[2].reminder_id == 4 && deadlines[2].when == local(2024, 1, 16, 9, 0));
+    }
+
+    // The next day the notified flags are stale
+    ManualClock next_day(local(2024, 1, 16, 8, 0));
+    deadlines = snapshot.primary_deadlines(next_day);
+    CHECK(!deadlines.empty() && deadlines[0].reminder_id == 2 && deadlines[0].when == local(2024, 1, 16, 8, 30, 15));
+
+    // Times after a DST switch, today or tomorrow, keep their wall clock time
+    ManualClock spring_forward(local(2024, 3, 10, 1, 0));
+    deadlines = snapshot.primary_deadlines(spring_forward);
+    CHECK(deadlines.size() == 3 && deadlines[2].reminder_id == 1 && deadlines[2].when == local(2024, 3, 10, 10, 0));
+    ManualClock eve(local(2024, 3, 9, 11, 0));
+    deadlines = snapshot.primary_deadlines(eve);
+    CHECK(deadlines.size() == 3 && deadlines[0].reminder_id == 2 && deadlines[0].when == local(2024, 3, 10, 8, 30, 15));
+    snapshot.close();
+
+    // A damaged snapshot is rejected
+    std::string bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    std::string damaged = bytes;
+    damaged[damaged.size() - 1] ^= 0x20;
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << damaged;
+    }
+    CHECK(!snapshot.open(path, error) && error == "checksum mismatch");
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << bytes.substr(0, bytes.size() - 4);
+    }
+    CHECK(!snapshot.open(path, error));
+}
+
+static IcsEvent daily_event(int start_date)
+{
+    IcsEvent event;
+    event.uid = "test";
+    event.start_date = start_date;
+    event.start_seconds = 9 * 3600;
+    event.frequency = IcsEvent::DAILY;
+    return event;
+}
+
+static void test_ics_rules()
+{
+    // 2024-01-01 is a Monday
+    IcsEvent event = daily_event(20240101);
+    event.interval = 2;
+    event.count = 3;
+    CHECK(ics_occurs_on(event, 20240101));
+    CHECK(!ics_occurs_on(event, 20240102));
+    CHECK(ics_occurs_on(event, 20240105));
+    CHECK(!ics_occurs_on(event, 20240107));
+    CHECK(!ics_occurs_on(event, 20231231));
+
+    event = daily_event(20240101);
+    event.until_date = 20240110;
+    event.excluded_dates = {20240103};
+    CHECK(ics_occurs_on(event, 20240110));
+    CHECK(!ics_occurs_on(event, 20240111));
+    CHECK(!ics_occurs_on(event, 20240103));
+    CHECK(ics_occurs_on(event, 20240104));
+
+    // Monday, Wednesday, Friday, four times
+    event = daily_event(20240101);
+    event.frequency = IcsEvent::WEEKLY;
+    event.weekdays = 1 << 1 | 1 << 3 | 1 << 5;
+    event.count = 4;
+    CHECK(ics_occurs_on(event, 20240103));
+    CHECK(!ics_occurs_on(event, 20240104));
+    CHECK(ics_occurs_on(event, 20240108));
+    CHECK(!ics_occurs_on(event, 20240110));
+
+    // Counting from a start in the middle of the week
+    event = daily_event(20240103);
+    event.frequency = IcsEvent::WEEKLY;
+    event.weekdays = 1 << 1 | 1 << 3;
+    event.count = 3;
+    CHECK(!ics_occurs_on(event, 20240101));
+    CHECK(ics_occurs_on(event, 20240108));
+    CHECK(ics_occurs_on(event, 20240110));
+    CHECK(!ics_occurs_on(event, 20240115));
+
+    // Every other Tuesday, the start's own weekday
+    event = daily_event(20240102);
+    event.frequency = IcsEvent::WEEKLY;
+    event.interval = 2;
+    CHECK(!ics_occurs_on(event, 20240109));
+    CHECK(ics_occurs_on(event, 20240116));
+
+    // Only timed, live events become reminders
+    event = daily_event(20240101);
+    event.cancelled = true;
+    CHECK(!ics_occurs_on(event, 20240101));
+    event = daily_event(20240101);
+    event.start_seconds = -1;
+    CHECK(!ics_occurs_on(event, 20240101));
+    event = daily_event(20240101);
+    event.frequency = IcsEvent::OTHER;
+    CHECK(ics_occurs_on(event, 20240101) && !ics_occurs_on(event, 20240201));
+}
+
+static void test_ics_parse()
+{
+    std::istringstream feed(
+        "BEGIN:VCALENDAR\r\n"
+        "BEGIN:VEVENT\r\n"
+        "UID:weekly@example.com\r\n"
+        "DTSTART;TZID=Europe/Berlin:20240101T073000\r\n"
+        "SUMMARY:Team s\r\n"
+        " ync\\, weekly\r\n"
+        "RRULE:FREQ=WEEKLY;BYDAY=MO,WE,FR;COUNT=4\r\n"
+        "EXDATE:20240103T073000\r\n"
+        "BEGIN:VALARM\r\n"
+        "SUMMARY:Not the event\r\n"
+        "END:VALARM\r\n"
+        "END:VEVENT\r\n"
+        "END:VCALENDAR\r\n");
+
+    std::vector<IcsEvent> events;
+    CHECK(parse_ics(feed, system_clock(), [&](const IcsEvent &event)
+                    { events.push_back(event); }));
+    CHECK(events.size() == 1);
+    if (events.size() != 1)
+        return;
+
+    const IcsEvent &event = events[0];
+    CHECK(event.summary == "Team sync, weekly");
+    CHECK(event.start_date == 20240101 && event.start_seconds == 7 * 3600 + 30 * 60);
+    CHECK(ics_reminder_time(event) == "07:30");
+    CHECK(ics_occurs_on(event, 20240105));
+    CHECK(!ics_occurs_on(event, 20240103));
+    CHECK(!ics_occurs_on(event, 20240110));
+}
+
+static std::string query(const std::string &db_path, QueryKind kind, const Clock &clock,
+                         const std::string &since = "", const std::string &until = "")
+{
+    QueryOptions options;
+    options.kind = kind;
+    options.format = QueryFormat::Tsv;
+    options.db_path = db_path;
+    options.since = since;
+    options.until = until;
+
+    // The IDs of the matches, in order
+    std::ostringstream out;
+    if (run_query(options, clock, out) != 0)
+        return "error";
+
+    std::istringstream rows(out.str());
+    std::string line, ids;
+    std::getline(rows, line);
+    while (std::getline(rows, line))
+    {
+        ids += (ids.empty() ? "" : " ") + line.substr(0, line.find('\t'));
+    }
+    return ids;
+}
+
+static void test_query_bounds()
+{
+    std::string path = scratch("query.db");
+    {
+        SqliteStorage storage;
+        CHECK(storage.open(path));
+        storage.insert(make_reminder(0, "12:29:59", "Just past"));
+        storage.insert(make_reminder(0, "12:30", "This minute"));
+        storage.insert(make_reminder(0, "12:30:10", "Earlier this minute"));
+        storage.insert(make_reminder(0, "12:31", "Next minute"));
+        Reminder done = make_reminder(0, "13:00", "Done");
+        done.completed = true;
+        storage.insert(done);
+        storage.insert(make_reminder(0, "08:00", "Morning"));
+    }
+
+    // Due until its minute is over, overdue after
+    ManualClock clock(local(2024, 1, 15, 12, 30, 20));
+    CHECK(query(path, QueryKind::List, clock) == "6 1 2 3 4 5");
+    CHECK(query(path, QueryKind::Due, clock) == "2 3 4");
+    CHECK(query(path, QueryKind::Overdue, clock) == "6 1");
+
+    // --until to the minute covers its seconds; --since can't reach back
+    // past now for due reminders
+    CHECK(query(path, QueryKind::Due, clock, "", "12:30") == "2 3");
+    CHECK(query(path, QueryKind::Due, clock, "08:00", "12:31") == "2 3 4");
+    CHECK(query(path, QueryKind::Overdue, clock, "12:00") == "1");
+    CHECK(query(path, QueryKind::List, clock, "12:30", "12:30:10") == "2 3");
+    CHECK(query(path, QueryKind::Due, clock, "bad") == "error");
+
+    QueryOptions options;
+    options.kind = QueryKind::Due;
+    options.db_path = path;
+    options.count = true;
+    std::ostringstream out;
+    CHECK(run_query(options, clock, out) == 0 && out.str() == "3\n");
+}
+
+// A local HTTP endpoint standing in for a webhook receiver. Each
+// connection gets the next status in the list; the requests are kept.
+class StandInServer
+{
+public:
+    explicit StandInServer(std::vector<int> statuses) : m_statuses(std::move(statuses)), m_port(0)
+    {
+        m_listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (m_listener != -1 && bind(m_listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 &&
+            listen(m_listener, 4) == 0 &&
+            getsockname(m_listener, reinterpret_cast<sockaddr *>(&address), &length) == 0)
+        {
+            m_port = ntohs(address.sin_port);
+            m_thread = std::thread(&StandInServer::run, this);
+        }
+    }
+
+    ~StandInServer()
+    {
+        stop();
+        if (m_listener != -1)
+            close(m_listener);
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(m_port) + "/hook";
+    }
+
+    // Stop accepting and hand over the requests received
+    std::vector<std::string> stop()
+    {
+        if (m_listener != -1)
+            shutdown(m_listener, SHUT_RDWR);
+        if (m_thread.joinable())
+            m_thread.join();
+        return m_requests;
+    }
+
+private:
+    std::vector<int> m_statuses;
+    std::vector<std::string> m_requests;
+    int m_listener;
+    int m_port;
+    std::thread m_thread;
+
+    void run()
+    {
+        for (int status : m_statuses)
+        {
+            int fd = accept(m_listener, nullptr, nullptr);
+            if (fd == -1)
+                return;
+
+            // Headers, then as much body as Content-Length says
+            std::string request;
+            char buffer[4096];
+            size_t body_end = std::string::npos;
+            while (body_end == std::string::npos || request.size() < body_end)
+            {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n <= 0)
+                    break;
+                request.append(buffer, n);
+
+                size_t headers_end = request.find("\r\n\r\n");
+                size_t length_at = request.find("Content-Length: ");
+                if (body_end == std::string::npos && headers_end != std::string::npos && length_at != std::string::npos)
+                    body_end = headers_end + 4 + std::stoul(request.substr(length_at + 16));
+            }
+            m_requests.push_back(request);
+
+            std::string response = "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : " Error") +
+                                   "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+            close(fd);
+        }
+    }
+};
+
+static DeliveryEvent make_event(int reminder_id, const std::string &title)
+{
+    DeliveryEvent event{};
+    event.reminder_id = reminder_id;
+    event.title = title;
+    event.time = "09:00";
+    event.priority = PRIORITY_HIGH;
+    event.kind = DeadlineKind::Primary;
+    event.deadline = local(2024, 1, 15, 9, 0);
+    event.delivered = event.deadline + std::chrono::milliseconds(250);
+    return event;
+}
+
+static bool starts_with(const std::string &text, const std::string &prefix)
+{
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+static std::string request_body(const std::string &request)
+{
+    size_t headers_end = request.find("\r\n\r\n");
+    return headers_end == std::string::npos ? "" : request.substr(headers_end + 4);
+}
+
+static void test_webhook_sink()
+{
+    std::vector<DeliveryEvent> batch = {make_event(1, "Standup"), make_event(2, "Say \"hi\"")};
+
+    StandInServer accepting({200});
+    WebhookSink sink(accepting.url());
+    CHECK(sink.valid());
+    CHECK(sink.deliver(batch));
+    std::vector<std::string> requests = accepting.stop();
+    CHECK(requests.size() == 1);
+    if (requests.size() == 1)
+    {
+        CHECK(starts_with(requests[0], "POST /hook HTTP/1.1\r\n"));
+        CHECK(requests[0].find("\r\nHost: 127.0.0.1\r\n") != std::string::npos);
+        CHECK(requests[0].find("\r\nContent-Type: application/json\r\n") != std::string::npos);
+        CHECK(request_body(requests[0]) == delivery_events_json(batch));
+    }
+
+    std::string json = delivery_events_json(batch);
+    CHECK(starts_with(json, "{\"events\":[{\"reminder_id\":1,"));
+    CHECK(json.find("\"title\":\"Say \\\"hi\\\"\"") != std::string::npos);
+    CHECK(json.find("\"kind\":\"primary\"") != std::string::npos);
+    CHECK(json.find("\"lateness_ms\":250") != std::string::npos);
+
+    // A failed post is retried, and the retry succeeds
+    StandInServer flaky({500, 200});
+    CHECK(WebhookSink(flaky.url()).deliver(batch));
+    requests = flaky.stop();
+    CHECK(requests.size() == 2);
+    CHECK(requests.size() == 2 && request_body(requests[1]) == json);
+
+    // After WEBHOOK_ATTEMPTS (3) failures the batch is given up
+    StandInServer failing({500, 500, 500, 500});
+    CHECK(!WebhookSink(failing.url()).deliver(batch));
+    CHECK(failing.stop().size() == 3);
+
+    CHECK(!WebhookSink("https://example.com/hook").valid());
+}
+
+// Records when each batch arrived; the first delivery is slow
+class RecordingSink : public NotificationSink
+{
+public:
+    std::vector<std::pair<std::chrono::steady_clock::time_point, size_t>> batches;
+
+    const char *name() const override
+    {
+        return "recording";
+    }
+
+    SinkPolicy policy() const override
+    {
+        SinkPolicy policy;
+        policy.max_batch = 2;
+        policy.max_delay = std::chrono::milliseconds(300);
+        return policy;
+    }
+
+    bool deliver(const std::vector<DeliveryEvent> &batch) override
+    {
+        batches.emplace_back(std::chrono::steady_clock::now(), batch.size());
+        if (batches.size() == 1)
+            std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        return true;
+    }
+};
+
+static void test_sink_queue_batching()
+{
+    RecordingSink *sink = new RecordingSink();
+    SinkQueue queue{std::unique_ptr<NotificationSink>(sink)};
+    auto started = std::chrono::steady_clock::now();
+
+    // A lone event waits max_delay for company; three more arrive while
+    // it is being delivered
+    queue.push(make_event(1, "First"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(350));
+    for (int id = 2; id <= 4; id++)
+    {
+        queue.push(make_event(id, "Later"));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(900));
+    queue.stop();
+
+    CHECK(queue.delivered() == 4);
+    CHECK(sink->batches.size() == 3);
+    if (sink->batches.size() == 3)
+    {
+        auto at = [&](size_t i)
+        { return std::chrono::duration_cast<std::chrono::milliseconds>(sink->batches[i].first - started).count(); };
+        CHECK(sink->batches[0].second == 1 && at(0) >= 300);
+        CHECK(sink->batches[1].second == 2 && sink->batches[2].second == 1);
+
+        // The leftover event has already waited out max_delay, so it
+        // goes straight after the full batch instead of 300 ms later
+        CHECK(at(2) - at(1) < 150);
+    }
+}
+
+struct TestCase
+{
+    const char *name;
+    void (*run)();
+};
+
+int main()
+{
+    // A fixed zone with DST, so results don't depend on the machine
+    setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+    tzset();
+
+    char dir[] = "/tmp/reminder-core-tests-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    g_dir = dir;
+
+    const TestCase tests[] = {
+        {"time_utils", test_time_utils},
+        {"time_utils_dst", test_time_utils_dst},
+        {"scheduler_arm", test_scheduler_arm},
+        {"scheduler_escalate", test_scheduler_escalate},
+        {"scheduler_preload", test_scheduler_preload},
+        {"reminder_store", test_reminder_store},
+        {"log_storage_replay", test_log_storage_replay},
+        {"stale_update", test_stale_update},
+        {"snapshot", test_snapshot},
+        {"ics_rules", test_ics_rules},
+        {"ics_parse", test_ics_parse},
+        {"query_bounds", test_query_bounds},
+        {"webhook_sink", test_webhook_sink},
+        {"sink_queue_batching", test_sink_queue_batching},
+    };
+
+    int failed_tests = 0;
+    for (const auto &test : tests)
+    {
+        int failures = g_failures;
+        test.run();
+        bool ok = g_failures == failures;
+        failed_tests += !ok;
+        std::cout << (ok ? "PASS " : "FAIL ") << test.name << std::endl;
+    }
+
+    remove_scratch();
+
+    std::cout << failed_tests << " of " << sizeof(tests) / sizeof(tests[0]) << " tests failed ("
+              << g_failures << " of " << g_checks << " checks)" << std::endl;
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+#include "database_backup.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sqlite3.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *BACKUP_PREFIX = "reminders-";
+static const char *BACKUP_SUFFIX = ".db";
+
+static std::string read_setting(sqlite3 *db, const char *key)
+{
+    std::string value;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db, "SELECT value FROM settings WHERE key = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        {
+            value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return value;
+}
+
+BackupOptions load_backup_options(const std::string &db_path)
+{
+    BackupOptions options;
+    options.db_path = db_path;
+
+    size_t slash = db_path.rfind('/');
+    options.dir = (slash == std::string::npos ? std::string(".") : db_path.substr(0, slash)) + "/reminders-backups";
+
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(db_path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK)
+    {
+        std::string dir = read_setting(db, "backup_dir");
+        std::string keep = read_setting(db, "backup_keep");
+        std::string interval = read_setting(db, "backup_interval_hours");
+
+        if (!dir.empty())
+            options.dir = dir;
+        if (!keep.empty())
+            options.keep = std::max(std::atoi(keep.c_str()), 1);
+        if (!interval.empty())
+            options.interval_hours = std::atoi(interval.c_str());
+    }
+    sqlite3_close(db);
+
+    return options;
+}
+
+static bool is_snapshot_name(const std::string &name)
+{
+    size_t prefix = strlen(BACKUP_PREFIX);
+    size_t suffix = strlen(BACKUP_SUFFIX);
+    return name.size() > prefix + suffix &&
+           name.compare(0, prefix, BACKUP_PREFIX) == 0 &&
+           name.compare(name.size() - suffix, suffix, BACKUP_SUFFIX) == 0;
+}
+
+std::vector<std::string> list_backups(const std::string &dir)
+{
+    std::vector<std::string> snapshots;
+
+    DIR *handle = opendir(dir.c_str());
+    if (!handle)
+        return snapshots;
+
+    while (struct dirent *entry = readdir(handle))
+    {
+        if (is_snapshot_name(entry->d_name))
+        {
+            snapshots.push_back(dir + "/" + entry->d_name);
+        }
+    }
+    closedir(handle);
+
+    // Names carry a sortable timestamp
+    std::sort(snapshots.begin(), snapshots.end());
+    return snapshots;
+}
+
+bool verify_database(const std::string &path, std::string &error)
+{
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+    {
+        error = sqlite3_errmsg(db);
+        sqlite3_close(db);
+        return false;
+    }
+
+    bool ok = false;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA integrity_check;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            std::string result = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+            ok = result == "ok";
+            if (!ok)
+                error = "integrity check failed: " + result;
+        }
+        else
+        {
+            error = sqlite3_errmsg(db);
+        }
+        sqlite3_finalize(stmt);
+    }
+    else
+    {
+        error = sqlite3_errmsg(db);
+    }
+
+    // A valid file that is not a reminders database is no use either
+    if (ok && sqlite3_exec(db, "SELECT COUNT(*) FROM reminders;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        error = sqlite3_errmsg(db);
+        ok = false;
+    }
+
+    sqlite3_close(db);
+    return ok;
+}
+
+static std::string snapshot_name()
+{
+    std::time_t now = std::time(nullptr);
+    std::tm tm_buf;
+    localtime_r(&now, &tm_buf);
+
+    char buffer[64];
+    std::strftime(buffer, sizeof(buffer), "%Y%m%d-%H%M%S", &tm_buf);
+    return std::string(BACKUP_PREFIX) + buffer + BACKUP_SUFFIX;
+}
+
+static void rotate_backups(const BackupOptions &options)
+{
+    std::vector<std::string> snapshots = list_backups(options.dir);
+    for (size_t i = 0; i + options.keep < snapshots.size(); i++)
+    {
+        if (unlink(snapshots[i].c_str()) == 0)
+        {
+            std::cout << "Removed old backup " << snapshots[i] << std::endl;
+        }
+    }
+}
+
+// Copy all pages from one open database to another, a slice at a time
+static bool copy_pages(sqlite3 *from, sqlite3 *to, const BackupOptions &options, const std::atomic<bool> &cancel)
+{
+    sqlite3_backup *backup = sqlite3_backup_init(to, "main", from, "main");
+    if (!backup)
+    {
+        std::cerr << "Failed to start backup: " << sqlite3_errmsg(to) << std::endl;
+        return false;
+    }
+
+    int rc;
+    while (true)
+    {
+        rc = sqlite3_backup_step(backup, options.pages_per_step);
+        if (rc == SQLITE_DONE || cancel)
+            break;
+
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED)
+            break;
+
+        std::this_thread::sleep_for(options.pause);
+    }
+
+    sqlite3_backup_finish(backup);
+
+    if (rc != SQLITE_DONE && !cancel)
+    {
+        std::cerr << "Backup failed: " << sqlite3_errstr(rc) << std::endl;
+    }
+    return rc == SQLITE_DONE;
+}
+
+bool backup_database(const BackupOptions &options, const std::atomic<bool> &cancel, std::string &snapshot)
+{
+    mkdir(options.dir.c_str(), 0700);
+
+    snapshot = options.dir + "/" + snapshot_name();
+    std::string partial = snapshot + ".partial";
+    unlink(partial.c_str());
+
+    sqlite3 *from = nullptr;
+    sqlite3 *to = nullptr;
+    if (sqlite3_open_v2(options.db_path.c_str(), &from, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK ||
+        sqlite3_open_v2(partial.c_str(), &to, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Can't open database for backup: " << sqlite3_errmsg(from ? from : to) << std::endl;
+        sqlite3_close(from);
+        sqlite3_close(to);
+        return false;
+    }
+    sqlite3_busy_timeout(from, 2000);
+
+    auto started = std::chrono::steady_clock::now();
+
+    // Pin one snapshot of the source for the whole copy. Without it every
+    // write from the app would restart the backup from the first page.
+    sqlite3_exec(from, "BEGIN; SELECT COUNT(*) FROM sqlite_master;", nullptr, nullptr, nullptr);
+    bool ok = copy_pages(from, to, options, cancel);
+    sqlite3_exec(from, "COMMIT;", nullptr, nullptr, nullptr);
+
+    // A snapshot should be a single self-contained file
+    if (ok)
+    {
+        sqlite3_exec(to, "PRAGMA journal_mode=DELETE;", nullptr, nullptr, nullptr);
+    }
+
+    sqlite3_close(from);
+    sqlite3_close(to);
+
+    std::string error;
+    if (ok && !verify_database(partial, error))
+    {
+        std::cerr << "Backup did not verify: " << error << std::endl;
+        ok = false;
+    }
+
+    if (!ok || rename(partial.c_str(), snapshot.c_str()) != 0)
+    {
+        unlink(partial.c_str());
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Backed up reminders to " << snapshot << " in " << seconds << " s" << std::endl;
+
+    rotate_backups(options);
+    return true;
+}
+
+bool restore_database(const BackupOptions &options, const std::string &snapshot)
+{
+    std::string error;
+    if (!verify_database(snapshot, error))
+    {
+        std::cerr << "Not restoring " << snapshot << ": " << error << std::endl;
+        return false;
+    }
+
+    // Keep what is being replaced, in case the wrong snapshot was picked.
+    // Rotation must not remove the snapshot being restored meanwhile.
+    BackupOptions safety = options;
+    safety.keep = std::max(options.keep, static_cast<int>(list_backups(options.dir).size()) + 1);
+    std::atomic<bool> cancel(false);
+    std::string previous;
+    if (access(options.db_path.c_str(), F_OK) == 0 && !backup_database(safety, cancel, previous))
+    {
+        std::cerr << "Not restoring: could not back up the current database first" << std::endl;
+        return false;
+    }
+
+    sqlite3 *from = nullptr;
+    sqlite3 *to = nullptr;
+    if (sqlite3_open_v2(snapshot.c_str(), &from, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK ||
+        sqlite3_open_v2(options.db_path.c_str(), &to, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Can't open database for restore: " << sqlite3_errmsg(from ? from : to) << std::endl;
+        sqlite3_close(from);
+        sqlite3_close(to);
+        return false;
+    }
+    sqlite3_busy_timeout(to, 2000);
+
+    bool ok = copy_pages(from, to, options, cancel);
+    sqlite3_close(from);
+    sqlite3_close(to);
+
+    if (ok && !verify_database(options.db_path, error))
+    {
+        std::cerr << "Restored database did not verify: " << error << std::endl;
+        ok = false;
+    }
+
+    if (ok)
+    {
+        std::cout << "Restored reminders from " << snapshot;
+        if (!previous.empty())
+            std::cout << "; the previous contents are in " << previous;
+        std::cout << std::endl;
+    }
+    return ok;
+}
+
+BackupWorker::BackupWorker() : m_running(false),
+                               m_cancel(false)
+{
+}
+
+BackupWorker::~BackupWorker()
+{
+    stop();
+}
+
+bool BackupWorker::start(const BackupOptions &options)
+{
+    if (m_running)
+        return false;
+
+    // Reap the thread of the previous backup
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    m_cancel = false;
+    m_running = true;
+    m_thread = std::thread([this, options]()
+                           {
+                               std::string snapshot;
+                               backup_database(options, m_cancel, snapshot);
+                               m_running = false; });
+    return true;
+}
+
+bool BackupWorker::running() const
+{
+    return m_running;
+}
+
+void BackupWorker::stop()
+{
+    m_cancel = true;
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
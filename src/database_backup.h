@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where snapshots go and how the copy is paced. Loaded from the settings
+// table of the database being backed up.
+struct BackupOptions
+{
+    std::string db_path;
+    std::string dir;                    // Snapshot directory
+    int keep = 7;                       // Snapshots kept by rotation
+    int interval_hours = 24;            // Automatic backups, 0 = off
+    int pages_per_step = 128;           // Pages copied per slice
+    std::chrono::milliseconds pause{10}; // Pause between slices
+};
+
+BackupOptions load_backup_options(const std::string &db_path);
+
+// Snapshot files in the directory, oldest first
+std::vector<std::string> list_backups(const std::string &dir);
+
+// Integrity check plus a read of the reminders table
+bool verify_database(const std::string &path, std::string &error);
+
+// Copy the database with the online backup API in small slices. The source
+// is read inside one read transaction, so in WAL mode the copy is a
+// consistent snapshot and writers are never blocked. The snapshot is
+// verified, renamed into place and the oldest ones rotated out. Returns
+// false on failure or when cancel is set.
+bool backup_database(const BackupOptions &options, const std::atomic<bool> &cancel, std::string &snapshot);
+
+// Replace the database with a verified snapshot. The current contents are
+// backed up first, and the result is verified again.
+bool restore_database(const BackupOptions &options, const std::string &snapshot);
+
+// Runs backup_database on a background thread
+class BackupWorker
+{
+public:
+    BackupWorker();
+    virtual ~BackupWorker();
+
+    // False if a backup is still running
+    bool start(const BackupOptions &options);
+    bool running() const;
+
+    // Cancel a running backup and wait for its thread
+    void stop();
+
+private:
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_cancel;
+};
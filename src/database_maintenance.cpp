@@ -0,0 +1,279 @@
+#include "database_maintenance.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <dirent.h>
+
+// A database created before auto_vacuum was turned on needs one full
+// VACUUM to switch; that only happens while it is this small
+static const int CONVERT_MAX_PAGES = 256;
+static const int MAX_VACUUM_PAGES = 4096;
+
+// SQLite's default, restored after a pass
+static const int WAL_AUTOCHECKPOINT_PAGES = 1000;
+
+static std::string read_first_line(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+bool on_ac_power()
+{
+    const std::string root = "/sys/class/power_supply/";
+    DIR *dir = opendir(root.c_str());
+    if (!dir)
+        return true;
+
+    // Mains, USB and the like report online; batteries don't
+    bool has_battery = false;
+    bool external_online = false;
+    while (struct dirent *entry = readdir(dir))
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        std::string supply = root + entry->d_name + "/";
+        std::string type = read_first_line(supply + "type");
+        if (type == "Battery")
+            has_battery = true;
+        else if (read_first_line(supply + "online") == "1")
+            external_online = true;
+    }
+    closedir(dir);
+
+    return external_online || !has_battery;
+}
+
+DatabaseMaintenance::DatabaseMaintenance(std::chrono::milliseconds budget)
+    : m_db(nullptr), m_phase(Phase::Done), m_budget(budget), m_vacuum_pages(64),
+      m_freed_pages(0), m_slices(0), m_longest_slice_ms(0)
+{
+}
+
+void DatabaseMaintenance::start(sqlite3 *db)
+{
+    m_db = db;
+    m_phase = Phase::Convert;
+
+    // Automatic checkpoints would run inside the slices after each commit
+    // and throw off their sizing; the pass ends with a checkpoint instead
+    sqlite3_wal_autocheckpoint(m_db, 0);
+    m_analyze.clear();
+    m_freed_pages = 0;
+    m_slices = 0;
+    m_longest_slice_ms = 0;
+}
+
+void DatabaseMaintenance::cancel()
+{
+    if (m_phase != Phase::Done)
+        sqlite3_wal_autocheckpoint(m_db, WAL_AUTOCHECKPOINT_PAGES);
+    m_phase = Phase::Done;
+    m_analyze.clear();
+}
+
+bool DatabaseMaintenance::running() const
+{
+    return m_phase != Phase::Done;
+}
+
+bool DatabaseMaintenance::step()
+{
+    if (!m_db || m_phase == Phase::Done)
+        return false;
+
+    auto started = std::chrono::steady_clock::now();
+    switch (m_phase)
+    {
+    case Phase::Convert:
+        convert();
+        break;
+    case Phase::Vacuum:
+        vacuum();
+        break;
+    case Phase::Analyze:
+        analyze();
+        break;
+    case Phase::Checkpoint:
+        checkpoint();
+        break;
+    case Phase::Done:
+        break;
+    }
+
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    m_slices++;
+    m_longest_slice_ms = std::max(m_longest_slice_ms, elapsed);
+
+    return m_phase != Phase::Done;
+}
+
+int DatabaseMaintenance::freed_pages() const
+{
+    return m_freed_pages;
+}
+
+int DatabaseMaintenance::slices() const
+{
+    return m_slices;
+}
+
+double DatabaseMaintenance::longest_slice_ms() const
+{
+    return m_longest_slice_ms;
+}
+
+int DatabaseMaintenance::pragma_int(const char *sql)
+{
+    int value = -1;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+void DatabaseMaintenance::convert()
+{
+    int mode = pragma_int("PRAGMA auto_vacuum;");
+    int pages = pragma_int("PRAGMA page_count;");
+
+    if (mode == 0 && pages > CONVERT_MAX_PAGES)
+    {
+        std::cout << "Database maintenance: " << pages << " pages is too large to switch to incremental vacuum without blocking; skipping vacuum." << std::endl;
+    }
+    else if (mode == 0 && pragma_int("PRAGMA freelist_count;") > 0)
+    {
+        // Rewrites the whole file, which is only a few milliseconds at this size
+        char *err_msg = nullptr;
+        if (sqlite3_exec(m_db, "PRAGMA auto_vacuum=INCREMENTAL; VACUUM;", nullptr, nullptr, &err_msg) == SQLITE_OK)
+        {
+            m_freed_pages += std::max(pages - pragma_int("PRAGMA page_count;"), 0);
+        }
+        else
+        {
+            std::cerr << "Database maintenance: VACUUM failed: " << err_msg << std::endl;
+            sqlite3_free(err_msg);
+        }
+    }
+
+    m_phase = pragma_int("PRAGMA auto_vacuum;") == 2 ? Phase::Vacuum : Phase::Analyze;
+}
+
+void DatabaseMaintenance::vacuum()
+{
+    int free_pages = pragma_int("PRAGMA freelist_count;");
+    if (free_pages <= 0)
+    {
+        m_phase = Phase::Analyze;
+        return;
+    }
+
+    int pages = std::min(m_vacuum_pages, free_pages);
+    std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(pages) + ");";
+
+    auto started = std::chrono::steady_clock::now();
+    char *err_msg = nullptr;
+    if (sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
+    {
+        // Busy or failing: leave the rest for the next pass
+        std::cerr << "Database maintenance: incremental vacuum failed: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        m_phase = Phase::Analyze;
+        return;
+    }
+    m_freed_pages += pages;
+
+    // Size the next slice so it holds the write lock for about the budget
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    if (elapsed > m_budget)
+        m_vacuum_pages = std::max(m_vacuum_pages / 2, 1);
+    else if (elapsed < m_budget / 4)
+        m_vacuum_pages = std::min(m_vacuum_pages * 2, MAX_VACUUM_PAGES);
+}
+
+void DatabaseMaintenance::analyze()
+{
+    if (m_analyze.empty())
+    {
+        // ANALYZE samples at most this many rows per index, so each table
+        // is a short write
+        sqlite3_exec(m_db, "PRAGMA analysis_limit=400;", nullptr, nullptr, nullptr);
+
+        // PRAGMA optimize only refreshes statistics that exist and have
+        // gone stale; the first time, each table is analyzed on its own
+        bool has_statistics = false;
+        std::vector<std::string> tables;
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(m_db, "SELECT name FROM sqlite_schema WHERE type = 'table';", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                std::string name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+                if (name == "sqlite_stat1")
+                    has_statistics = true;
+                else if (name.compare(0, 7, "sqlite_") != 0)
+                    tables.push_back(name);
+            }
+            sqlite3_finalize(stmt);
+        }
+
+        if (has_statistics)
+        {
+            m_analyze.push_back("PRAGMA optimize;");
+        }
+        else
+        {
+            for (const auto &table : tables)
+            {
+                std::string quoted;
+                for (char c : table)
+                {
+                    quoted += c == '"' ? "\"\"" : std::string(1, c);
+                }
+                m_analyze.push_back("ANALYZE \"" + quoted + "\";");
+            }
+        }
+
+        if (m_analyze.empty())
+        {
+            m_phase = Phase::Checkpoint;
+            return;
+        }
+    }
+
+    char *err_msg = nullptr;
+    if (sqlite3_exec(m_db, m_analyze.back().c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
+    {
+        std::cerr << "Database maintenance: " << m_analyze.back() << " failed: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+    }
+    m_analyze.pop_back();
+
+    if (m_analyze.empty())
+        m_phase = Phase::Checkpoint;
+}
+
+void DatabaseMaintenance::checkpoint()
+{
+    // A passive checkpoint copies what it can without taking the write
+    // lock or waiting on readers, so it may take longer than a slice
+    // without holding anyone up. The size limit makes SQLite truncate the
+    // WAL file the next time it starts over from the beginning.
+    sqlite3_exec(m_db, "PRAGMA journal_size_limit=1048576;", nullptr, nullptr, nullptr);
+
+    int log_frames = 0, checkpointed = 0;
+    if (sqlite3_wal_checkpoint_v2(m_db, nullptr, SQLITE_CHECKPOINT_PASSIVE, &log_frames, &checkpointed) != SQLITE_OK)
+    {
+        std::cerr << "Database maintenance: checkpoint failed: " << sqlite3_errmsg(m_db) << std::endl;
+    }
+
+    sqlite3_wal_autocheckpoint(m_db, WAL_AUTOCHECKPOINT_PAGES);
+    m_phase = Phase::Done;
+}
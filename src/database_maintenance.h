@@ -0,0 +1,61 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Whether the machine runs on mains power. True when there is no mains
+// supply to ask about, e.g. on a desktop.
+bool on_ac_power();
+
+// One maintenance pass over a database, split into slices the caller runs
+// one at a time while the app is idle. A pass returns free pages to the
+// file system with incremental vacuum, refreshes the planner statistics
+// and checkpoints and truncates the WAL. Each slice is sized to hold the
+// write lock for about the budget, so other connections only ever wait
+// that long. Slices run on the caller's connection; no transaction may be
+// open on it in between.
+class DatabaseMaintenance
+{
+public:
+    explicit DatabaseMaintenance(std::chrono::milliseconds budget = std::chrono::milliseconds(5));
+
+    void start(sqlite3 *db);
+    void cancel();
+    bool running() const;
+
+    // Run the next slice. Returns false once the pass is finished.
+    bool step();
+
+    // Totals of the current or last pass
+    int freed_pages() const;
+    int slices() const;
+    double longest_slice_ms() const;
+
+private:
+    enum class Phase
+    {
+        Convert,
+        Vacuum,
+        Analyze,
+        Checkpoint,
+        Done
+    };
+
+    sqlite3 *m_db;
+    Phase m_phase;
+    std::chrono::milliseconds m_budget;
+    int m_vacuum_pages;                  // Pages per incremental vacuum slice, adapted to the budget
+    std::vector<std::string> m_analyze;  // Statements left in the analyze phase
+
+    int m_freed_pages;
+    int m_slices;
+    double m_longest_slice_ms;
+
+    int pragma_int(const char *sql);
+    void convert();
+    void vacuum();
+    void analyze();
+    void checkpoint();
+};
@@ -0,0 +1,162 @@
+#include "delivery_history.h"
+#include <ctime>
+#include <iostream>
+
+bool create_delivery_history_schema(sqlite3 *db)
+{
+    // Times are milliseconds since the epoch, except completed_at, which is
+    // in seconds like reminders.completed_at
+    const char *sql =
+        "CREATE TABLE IF NOT EXISTS deliveries("
+        "id INTEGER PRIMARY KEY,"
+        "reminder_id INTEGER NOT NULL,"
+        "kind TEXT NOT NULL,"
+        "notice INTEGER NOT NULL DEFAULT 0,"
+        "day TEXT NOT NULL,"
+        "deadline_ms INTEGER NOT NULL,"
+        "lateness_ms INTEGER NOT NULL,"
+        "completed_at INTEGER);"
+        "CREATE INDEX IF NOT EXISTS idx_deliveries_day ON deliveries(day, lateness_ms);"
+        "CREATE INDEX IF NOT EXISTS idx_deliveries_reminder ON deliveries(reminder_id, kind, completed_at);"
+        // The completion time the writer stamped on the reminder, so a
+        // simulated clock applies here too; the wall clock if there is none
+        "DROP TRIGGER IF EXISTS deliveries_completed;"
+        "CREATE TRIGGER IF NOT EXISTS deliveries_completed_at AFTER UPDATE OF completed ON reminders "
+        "WHEN NEW.completed = 1 AND OLD.completed = 0 "
+        "BEGIN "
+        "UPDATE deliveries SET completed_at = coalesce(NEW.completed_at, strftime('%s', 'now')) "
+        "WHERE reminder_id = NEW.id AND completed_at IS NULL; "
+        "END;";
+
+    char *err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+    {
+        std::cerr << "SQL error when creating delivery history: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        return false;
+    }
+    return true;
+}
+
+static sqlite3_int64 epoch_ms(Clock::time_point when)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(when.time_since_epoch()).count();
+}
+
+static std::string local_day(Clock::time_point when)
+{
+    std::time_t seconds = std::chrono::system_clock::to_time_t(when);
+    std::tm tm_buf;
+    localtime_r(&seconds, &tm_buf);
+
+    char buffer[16];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", &tm_buf);
+    return buffer;
+}
+
+bool append_deliveries(sqlite3 *db, const std::vector<DeliveryEvent> &batch)
+{
+    const char *sql = "INSERT INTO deliveries (reminder_id, kind, notice, day, deadline_ms, lateness_ms) "
+                      "VALUES (?, ?, ?, ?, ?, ?);";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    // One transaction per batch: a single fsync however many rows it holds
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to start delivery history transaction: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+        return false;
+    }
+
+    bool ok = true;
+    for (const auto &event : batch)
+    {
+        sqlite3_bind_int(stmt, 1, event.reminder_id);
+        sqlite3_bind_text(stmt, 2, deadline_kind_name(event.kind), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, event.notice);
+        std::string day = local_day(event.deadline);
+        sqlite3_bind_text(stmt, 4, day.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 5, epoch_ms(event.deadline));
+        sqlite3_bind_int64(stmt, 6, epoch_ms(event.delivered) - epoch_ms(event.deadline));
+
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            std::cerr << "Failed to record delivery: " << sqlite3_errmsg(db) << std::endl;
+            ok = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+    return ok;
+}
+
+int purge_deliveries(sqlite3 *db, const std::string &before_day)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "DELETE FROM deliveries WHERE day < ?;", -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+        return 0;
+    }
+
+    sqlite3_bind_text(stmt, 1, before_day.c_str(), -1, SQLITE_TRANSIENT);
+    int purged = sqlite3_step(stmt) == SQLITE_DONE ? sqlite3_changes(db) : 0;
+    sqlite3_finalize(stmt);
+    return purged;
+}
+
+DeliveryHistorySink::DeliveryHistorySink(const std::string &db_path) : m_db_path(db_path),
+                                                                       m_db(nullptr)
+{
+}
+
+DeliveryHistorySink::~DeliveryHistorySink()
+{
+    if (m_db)
+    {
+        sqlite3_close(m_db);
+    }
+}
+
+const char *DeliveryHistorySink::name() const
+{
+    return "history";
+}
+
+SinkPolicy DeliveryHistorySink::policy() const
+{
+    // Rows are small and the history should be complete, so queue generously
+    SinkPolicy policy;
+    policy.capacity = 16384;
+    policy.max_batch = 512;
+    policy.max_delay = std::chrono::milliseconds(1000);
+    return policy;
+}
+
+bool DeliveryHistorySink::deliver(const std::vector<DeliveryEvent> &batch)
+{
+    if (!m_db)
+    {
+        if (sqlite3_open_v2(m_db_path.c_str(), &m_db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Can't open database for delivery history: " << sqlite3_errmsg(m_db) << std::endl;
+            sqlite3_close(m_db);
+            m_db = nullptr;
+            return false;
+        }
+
+        // The main loop's connection may be mid-write
+        sqlite3_busy_timeout(m_db, 2000);
+    }
+
+    return append_deliveries(m_db, batch);
+}
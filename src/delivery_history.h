@@ -0,0 +1,36 @@
+#pragma once
+
+#include "notification_sink.h"
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+// Append-only log of fired reminders in the reminders database. Rows carry
+// the local day and the lateness so per-day SLO queries read one index, and
+// a trigger on reminders stamps completed_at on a reminder's open deliveries
+// when it is completed.
+bool create_delivery_history_schema(sqlite3 *db);
+
+// Insert a batch in one transaction
+bool append_deliveries(sqlite3 *db, const std::vector<DeliveryEvent> &batch);
+
+// Drop deliveries of days before the given "YYYY-MM-DD"; returns the count
+int purge_deliveries(sqlite3 *db, const std::string &before_day);
+
+// Writes the delivery history from the sink's thread over its own
+// connection, so batching never contends with the main loop's handle
+// beyond SQLite's own locking.
+class DeliveryHistorySink : public NotificationSink
+{
+public:
+    explicit DeliveryHistorySink(const std::string &db_path);
+    virtual ~DeliveryHistorySink();
+
+    const char *name() const override;
+    SinkPolicy policy() const override;
+    bool deliver(const std::vector<DeliveryEvent> &batch) override;
+
+private:
+    std::string m_db_path;
+    sqlite3 *m_db; // Opened on first use, on the sink's thread
+};
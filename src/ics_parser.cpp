@@ -0,0 +1,358 @@
+#include "ics_parser.h"
+#include "time_utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+static const char *WEEKDAY_NAMES[] = {"SU", "MO", "TU", "WE", "TH", "FR", "SA"};
+
+// Days since 1970-01-01 of a YYYYMMDD date
+static int day_number(int date)
+{
+    int y = date / 10000;
+    int m = date / 100 % 100;
+    int d = date % 100;
+
+    // Civil date to days, counting from March so leap days come last
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// 0 = Sunday
+static int weekday_of(int date)
+{
+    return ((day_number(date) + 4) % 7 + 7) % 7;
+}
+
+static int date_of(const std::tm &tm)
+{
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+static std::string upper(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                   { return std::toupper(c); });
+    return text;
+}
+
+static bool all_digits(const std::string &text, size_t from, size_t length)
+{
+    if (text.size() < from + length)
+        return false;
+    for (size_t i = from; i < from + length; i++)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(text[i])))
+            return false;
+    }
+    return true;
+}
+
+// "YYYYMMDD" or "YYYYMMDDTHHMMSS[Z]" to a local date and, unless the value
+// is a date, a local time of day in seconds (else -1)
+static bool parse_date_time(const std::string &value, const Clock &clock, int &date, int &seconds)
+{
+    if (!all_digits(value, 0, 8))
+        return false;
+
+    date = std::atoi(value.substr(0, 8).c_str());
+    seconds = -1;
+    if (value.size() < 15 || value[8] != 'T' || !all_digits(value, 9, 6))
+        return true;
+
+    int hour = std::atoi(value.substr(9, 2).c_str());
+    int minute = std::atoi(value.substr(11, 2).c_str());
+    int second = std::atoi(value.substr(13, 2).c_str());
+
+    if (value.size() > 15 && value[15] == 'Z')
+    {
+        std::tm utc = {};
+        utc.tm_year = date / 10000 - 1900;
+        utc.tm_mon = date / 100 % 100 - 1;
+        utc.tm_mday = date % 100;
+        utc.tm_hour = hour;
+        utc.tm_min = minute;
+        utc.tm_sec = second;
+
+        std::tm local = clock.local_time(Clock::time_point(std::chrono::seconds(timegm(&utc))));
+        date = date_of(local);
+        hour = local.tm_hour;
+        minute = local.tm_min;
+        second = local.tm_sec;
+    }
+
+    if (hour > 23 || minute > 59 || second > 59)
+        return false;
+
+    seconds = hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+// TEXT values escape backslashes, commas, semicolons and newlines
+static std::string unescape_text(const std::string &value)
+{
+    if (value.find('\\') == std::string::npos)
+        return value;
+
+    std::string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        if (value[i] == '\\' && i + 1 < value.size())
+        {
+            char next = value[++i];
+            result += next == 'n' || next == 'N' ? '\n' : next;
+        }
+        else
+        {
+            result += value[i];
+        }
+    }
+    return result;
+}
+
+static void parse_rrule(const std::string &value, const Clock &clock, IcsEvent &event)
+{
+    std::stringstream ss(value);
+    std::string part;
+    while (std::getline(ss, part, ';'))
+    {
+        size_t equals = part.find('=');
+        if (equals == std::string::npos)
+            continue;
+
+        std::string key = upper(part.substr(0, equals));
+        std::string rule = part.substr(equals + 1);
+        if (key == "FREQ")
+        {
+            rule = upper(rule);
+            event.frequency = rule == "DAILY" ? IcsEvent::DAILY : rule == "WEEKLY" ? IcsEvent::WEEKLY
+                                                                                  : IcsEvent::OTHER;
+        }
+        else if (key == "INTERVAL")
+        {
+            event.interval = std::max(std::atoi(rule.c_str()), 1);
+        }
+        else if (key == "COUNT")
+        {
+            event.count = std::max(std::atoi(rule.c_str()), 0);
+        }
+        else if (key == "UNTIL")
+        {
+            int seconds;
+            parse_date_time(rule, clock, event.until_date, seconds);
+        }
+        else if (key == "BYDAY")
+        {
+            // Ordinals like "1MO" only mean something to monthly rules
+            std::stringstream days(upper(rule));
+            std::string day;
+            while (std::getline(days, day, ','))
+            {
+                for (int i = 0; i < 7 && day.size() >= 2; i++)
+                {
+                    if (day.compare(day.size() - 2, 2, WEEKDAY_NAMES[i]) == 0)
+                        event.weekdays |= 1 << i;
+                }
+            }
+        }
+    }
+}
+
+// Parameters (TZID, VALUE, ...) are ignored: the value's own form says
+// whether it is a date, a UTC time or a local one
+static void parse_property(const std::string &name, const std::string &value, const Clock &clock, IcsEvent &event)
+{
+    if (name == "UID")
+    {
+        event.uid = value;
+    }
+    else if (name == "SEQUENCE")
+    {
+        event.sequence = std::atoi(value.c_str());
+    }
+    else if (name == "SUMMARY")
+    {
+        event.summary = unescape_text(value);
+    }
+    else if (name == "DESCRIPTION")
+    {
+        event.description = unescape_text(value);
+    }
+    else if (name == "STATUS")
+    {
+        event.cancelled = upper(value) == "CANCELLED";
+    }
+    else if (name == "DTSTART")
+    {
+        // An all-day event (VALUE=DATE) has no time to remind at and is
+        // left without start_seconds
+        if (!parse_date_time(value, clock, event.start_date, event.start_seconds))
+            event.start_date = 0;
+    }
+    else if (name == "RECURRENCE-ID")
+    {
+        int seconds;
+        event.recurrence_id = value;
+        parse_date_time(value, clock, event.recurrence_date, seconds);
+    }
+    else if (name == "RRULE")
+    {
+        parse_rrule(value, clock, event);
+    }
+    else if (name == "EXDATE")
+    {
+        std::stringstream ss(value);
+        std::string excluded;
+        while (std::getline(ss, excluded, ','))
+        {
+            int date, seconds;
+            if (parse_date_time(excluded, clock, date, seconds))
+                event.excluded_dates.push_back(date);
+        }
+    }
+}
+
+bool parse_ics(std::istream &in, const Clock &clock, const std::function<void(const IcsEvent &)> &on_event)
+{
+    IcsEvent event;
+    bool in_event = false;
+    int nested = 0;
+
+    auto process = [&](const std::string &line)
+    {
+        // NAME;PARAM=VALUE;PARAM="a:b":VALUE, the first colon outside quotes
+        size_t colon = std::string::npos;
+        bool quoted = false;
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            if (line[i] == '"')
+                quoted = !quoted;
+            else if (line[i] == ':' && !quoted)
+            {
+                colon = i;
+                break;
+            }
+        }
+        if (colon == std::string::npos)
+            return;
+
+        size_t semicolon = line.find(';');
+        std::string name = upper(line.substr(0, semicolon < colon ? semicolon : colon));
+        std::string value = line.substr(colon + 1);
+
+        if (name == "BEGIN")
+        {
+            if (in_event)
+                nested++;
+            else if (upper(value) == "VEVENT")
+            {
+                event = IcsEvent();
+                in_event = true;
+                nested = 0;
+            }
+        }
+        else if (name == "END" && in_event)
+        {
+            if (nested > 0)
+                nested--;
+            else if (upper(value) == "VEVENT")
+            {
+                on_event(event);
+                in_event = false;
+            }
+        }
+        else if (in_event && nested == 0)
+        {
+            parse_property(name, value, clock, event);
+        }
+    };
+
+    // Long lines are folded: a line starting with a space or tab continues
+    // the one before it
+    std::string line, logical;
+    bool have_line = false;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (!line.empty() && (line[0] == ' ' || line[0] == '\t'))
+        {
+            if (have_line)
+                logical.append(line, 1, std::string::npos);
+            continue;
+        }
+
+        if (have_line)
+            process(logical);
+        logical.swap(line);
+        have_line = true;
+    }
+    if (have_line)
+        process(logical);
+
+    return !in.bad();
+}
+
+bool ics_occurs_on(const IcsEvent &event, int date)
+{
+    if (event.cancelled || event.start_seconds < 0 || event.start_date == 0 || date < event.start_date)
+        return false;
+    if (std::find(event.excluded_dates.begin(), event.excluded_dates.end(), date) != event.excluded_dates.end())
+        return false;
+    if (date == event.start_date)
+        return true;
+    if (event.until_date && date > event.until_date)
+        return false;
+
+    int days = day_number(date) - day_number(event.start_date);
+    if (event.frequency == IcsEvent::DAILY)
+    {
+        return days % event.interval == 0 && (!event.count || days / event.interval < event.count);
+    }
+    if (event.frequency != IcsEvent::WEEKLY)
+        return false;
+
+    int weekdays = event.weekdays ? event.weekdays : 1 << weekday_of(event.start_date);
+    if (!(weekdays & (1 << weekday_of(date))))
+        return false;
+
+    // Weeks start on Monday; count them from the start's week
+    int start_offset = (weekday_of(event.start_date) + 6) % 7;
+    int date_offset = (weekday_of(date) + 6) % 7;
+    int week = (days + start_offset) / 7;
+    if (week % event.interval != 0)
+        return false;
+    if (!event.count)
+        return true;
+
+    // Occurrences before this one: the rest of the first week, the full
+    // weeks in between, then the days before it in its own week
+    int first_week = 0, per_week = 0, earlier = 0;
+    for (int offset = 0; offset < 7; offset++)
+    {
+        if (!(weekdays & (1 << (offset + 1) % 7)))
+            continue;
+        per_week++;
+        first_week += offset >= start_offset;
+        earlier += offset < date_offset && (week > 0 || offset >= start_offset);
+    }
+    int before = week == 0 ? earlier : first_week + (week / event.interval - 1) * per_week + earlier;
+    return before < event.count;
+}
+
+int ics_local_date(const Clock &clock)
+{
+    return date_of(clock.local_time(clock.now()));
+}
+
+std::string ics_reminder_time(const IcsEvent &event)
+{
+    return format_reminder_time(event.start_seconds / 3600, event.start_seconds / 60 % 60, event.start_seconds % 60);
+}
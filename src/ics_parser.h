@@ -0,0 +1,52 @@
+#pragma once
+
+#include "clock.h"
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+// The parts of an iCalendar VEVENT that can become a reminder. Dates are
+// local YYYYMMDD numbers. UTC times are converted to local time; times
+// with a TZID are taken as local.
+struct IcsEvent
+{
+    std::string uid;
+    std::string recurrence_id; // Set on an override of one instance of a series
+    int recurrence_date = 0;
+    int sequence = 0;
+    std::string summary;
+    std::string description;
+    int start_date = 0;
+    int start_seconds = -1; // Local time of day, -1 for all-day events
+    bool cancelled = false;
+
+    // RRULE, for the daily and weekly rules that fit a reminder
+    enum Frequency
+    {
+        NONE,
+        DAILY,
+        WEEKLY,
+        OTHER
+    } frequency = NONE;
+    int interval = 1;
+    int count = 0;      // 0 = no limit
+    int until_date = 0; // 0 = no end
+    int weekdays = 0;   // Bit per weekday, Sunday = bit 0; 0 = the start's weekday
+    std::vector<int> excluded_dates;
+};
+
+// Read VEVENTs one at a time and hand each to the callback, so a feed is
+// never held in memory. Unfolds continuation lines and skips components
+// nested in an event (e.g. VALARM). Returns false if the stream failed.
+bool parse_ics(std::istream &in, const Clock &clock, const std::function<void(const IcsEvent &)> &on_event);
+
+// Whether a timed event happens on a local date. MONTHLY and YEARLY
+// rules only count their first occurrence.
+bool ics_occurs_on(const IcsEvent &event, int date);
+
+// The clock's local date as YYYYMMDD
+int ics_local_date(const Clock &clock);
+
+// The event's start as a reminder time, "HH:MM[:SS]"
+std::string ics_reminder_time(const IcsEvent &event);
@@ -0,0 +1,408 @@
+#include "ics_subscriptions.h"
+#include "ics_parser.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// One event as last written: which reminder it became, for which day
+struct MappedEvent
+{
+    int sequence;
+    sqlite3_int64 digest;
+    int reminder_id;
+    int date;
+};
+
+// FNV-1a over what the reminder shows, so edits without a SEQUENCE bump
+// are still noticed
+static sqlite3_int64 event_digest(const IcsEvent &event, const std::string &time)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const std::string *field : {&event.summary, &event.description, &time})
+    {
+        for (unsigned char c : *field)
+        {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        hash = (hash ^ 0x1f) * 1099511628211ULL;
+    }
+    return static_cast<sqlite3_int64>(hash);
+}
+
+// The reminders of a feed are tagged with its file name, minus ".ics"
+static std::string feed_tag(const std::string &path)
+{
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (IcsSubscriptions::is_feed_file(name))
+        name.resize(name.size() - 4);
+    std::replace(name.begin(), name.end(), ',', ' ');
+    return name;
+}
+
+IcsSubscriptions::IcsSubscriptions() : m_db(nullptr), m_storage(nullptr)
+{
+}
+
+void IcsSubscriptions::attach(sqlite3 *db, StorageEngine *storage)
+{
+    m_db = db;
+    m_storage = storage;
+
+    const char *schema_sql =
+        "CREATE TABLE IF NOT EXISTS ics_files("
+        "path TEXT PRIMARY KEY,"
+        "size INTEGER,"
+        "mtime INTEGER,"
+        "synced_date INTEGER);"
+        "CREATE TABLE IF NOT EXISTS ics_events("
+        "path TEXT NOT NULL,"
+        "uid TEXT NOT NULL,"
+        "sequence INTEGER,"
+        "digest INTEGER,"
+        "reminder_id INTEGER,"
+        "date INTEGER,"
+        "PRIMARY KEY (path, uid)) WITHOUT ROWID;";
+
+    char *err_msg = nullptr;
+    if (sqlite3_exec(m_db, schema_sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+    {
+        std::cerr << "SQL error when creating subscription schema: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+    }
+}
+
+std::vector<std::string> IcsSubscriptions::split_paths(const std::string &setting)
+{
+    std::vector<std::string> paths;
+    std::stringstream ss(setting);
+    std::string path;
+
+    while (std::getline(ss, path, ';'))
+    {
+        size_t first = path.find_first_not_of(" \t");
+        size_t last = path.find_last_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+
+        path = path.substr(first, last - first + 1);
+        if (path.compare(0, 2, "~/") == 0 && getenv("HOME"))
+            path = std::string(getenv("HOME")) + path.substr(1);
+        paths.push_back(path);
+    }
+
+    return paths;
+}
+
+std::vector<std::string> IcsSubscriptions::expand(const std::vector<std::string> &paths)
+{
+    std::vector<std::string> files;
+
+    for (const auto &path : paths)
+    {
+        struct stat info;
+        DIR *dir = stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode) ? opendir(path.c_str()) : nullptr;
+        if (!dir)
+        {
+            // A file, or one that doesn't exist yet
+            files.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> feeds;
+        while (struct dirent *entry = readdir(dir))
+        {
+            if (entry->d_name[0] != '.' && is_feed_file(entry->d_name))
+                feeds.push_back(path + "/" + entry->d_name);
+        }
+        closedir(dir);
+
+        std::sort(feeds.begin(), feeds.end());
+        files.insert(files.end(), feeds.begin(), feeds.end());
+    }
+
+    return files;
+}
+
+bool IcsSubscriptions::is_feed_file(const std::string &path)
+{
+    if (path.size() < 4)
+        return false;
+
+    std::string suffix = path.substr(path.size() - 4);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), [](unsigned char c)
+                   { return std::tolower(c); });
+    return suffix == ".ics";
+}
+
+bool IcsSubscriptions::file_unchanged(const std::string &path, sqlite3_int64 size, sqlite3_int64 mtime, int today)
+{
+    bool unchanged = false;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(m_db, "SELECT size, mtime, synced_date FROM ics_files WHERE path = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            unchanged = sqlite3_column_int64(stmt, 0) == size &&
+                        sqlite3_column_int64(stmt, 1) == mtime &&
+                        sqlite3_column_int(stmt, 2) == today;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return unchanged;
+}
+
+bool IcsSubscriptions::sync_file(const std::string &path, const Clock &clock,
+                                 const std::function<const Reminder *(int)> &current, FeedChanges &changes)
+{
+    if (!m_db || !m_storage)
+        return false;
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return drop_file(path, current, changes);
+
+    // Events that happen today become reminders, so a new day means a new
+    // look at every file
+    int today = ics_local_date(clock);
+    sqlite3_int64 mtime = static_cast<sqlite3_int64>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    if (file_unchanged(path, info.st_size, mtime, today))
+        return true;
+
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "Can't read " << path << std::endl;
+        return false;
+    }
+
+    // Only today's occurrences are kept while the file streams past. An
+    // override of today's instance of a series replaces the series; one
+    // that moves another day's instance to today is an event of its own.
+    std::unordered_map<std::string, IcsEvent> wanted;
+    std::unordered_set<std::string> overridden;
+    bool read = parse_ics(in, clock, [&](const IcsEvent &event)
+                          {
+        if (event.uid.empty())
+            return;
+
+        if (event.recurrence_id.empty())
+        {
+            if (!overridden.count(event.uid) && ics_occurs_on(event, today))
+                wanted[event.uid] = event;
+        }
+        else if (event.recurrence_date == today)
+        {
+            overridden.insert(event.uid);
+            wanted.erase(event.uid);
+            if (ics_occurs_on(event, today))
+                wanted[event.uid] = event;
+        }
+        else if (ics_occurs_on(event, today))
+        {
+            wanted[event.uid + "/" + event.recurrence_id] = event;
+        } });
+
+    if (!read)
+    {
+        std::cerr << "Failed reading " << path << std::endl;
+        return false;
+    }
+
+    // What the last sync of this file wrote
+    std::unordered_map<std::string, MappedEvent> mapped;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT uid, sequence, digest, reminder_id, date FROM ics_events WHERE path = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            mapped[reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))] =
+                MappedEvent{sqlite3_column_int(stmt, 1), sqlite3_column_int64(stmt, 2),
+                            sqlite3_column_int(stmt, 3), sqlite3_column_int(stmt, 4)};
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if (!m_storage->begin())
+        return false;
+
+    sqlite3_stmt *save_stmt = nullptr, *forget_stmt = nullptr;
+    bool ok = sqlite3_prepare_v2(m_db, "INSERT OR REPLACE INTO ics_events (path, uid, sequence, digest, reminder_id, date) "
+                                       "VALUES (?, ?, ?, ?, ?, ?);",
+                                 -1, &save_stmt, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(m_db, "DELETE FROM ics_events WHERE path = ? AND uid = ?;", -1, &forget_stmt, nullptr) == SQLITE_OK;
+
+    FeedChanges written;
+    std::string tag = feed_tag(path);
+    for (auto it = wanted.begin(); ok && it != wanted.end(); ++it)
+    {
+        const IcsEvent &event = it->second;
+        std::string time = ics_reminder_time(event);
+        sqlite3_int64 digest = event_digest(event, time);
+        const Reminder *existing = nullptr;
+        bool new_day = false;
+
+        auto known = mapped.find(it->first);
+        if (known != mapped.end())
+        {
+            MappedEvent previous = known->second;
+            mapped.erase(known);
+            new_day = previous.date != today;
+
+            // Unchanged, and already written for today. A reminder the user
+            // deleted stays deleted until the event changes.
+            if (previous.sequence == event.sequence && previous.digest == digest && !new_day)
+                continue;
+            existing = current(previous.reminder_id);
+        }
+
+        Reminder reminder = existing ? *existing : Reminder{};
+        reminder.title = event.summary.empty() ? "(untitled)" : event.summary;
+        reminder.description = event.description;
+        if (!existing || existing->time != time)
+            reminder.notified = false;
+        reminder.time = time;
+
+        if (existing)
+        {
+            // Another day's occurrence of a series starts over
+            if (new_day)
+                reminder.completed = reminder.notified = false;
+            ok = m_storage->update(reminder, false);
+        }
+        else
+        {
+            reminder.completed = false;
+            reminder.priority = PRIORITY_NORMAL;
+            reminder.tags = {tag};
+            reminder.id = m_storage->insert(reminder);
+            ok = reminder.id != -1;
+        }
+        written.changed.push_back(reminder);
+
+        sqlite3_reset(save_stmt);
+        sqlite3_bind_text(save_stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(save_stmt, 2, it->first.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(save_stmt, 3, event.sequence);
+        sqlite3_bind_int64(save_stmt, 4, digest);
+        sqlite3_bind_int(save_stmt, 5, reminder.id);
+        sqlite3_bind_int(save_stmt, 6, today);
+        ok = ok && sqlite3_step(save_stmt) == SQLITE_DONE;
+    }
+
+    // Events gone from the file, or not happening today
+    for (auto it = mapped.begin(); ok && it != mapped.end(); ++it)
+    {
+        if (current(it->second.reminder_id))
+        {
+            ok = m_storage->remove(it->second.reminder_id);
+            written.removed.push_back(it->second.reminder_id);
+        }
+
+        sqlite3_reset(forget_stmt);
+        sqlite3_bind_text(forget_stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(forget_stmt, 2, it->first.c_str(), -1, SQLITE_TRANSIENT);
+        ok = ok && sqlite3_step(forget_stmt) == SQLITE_DONE;
+    }
+    sqlite3_finalize(save_stmt);
+    sqlite3_finalize(forget_stmt);
+
+    if (ok && sqlite3_prepare_v2(m_db, "INSERT OR REPLACE INTO ics_files (path, size, mtime, synced_date) VALUES (?, ?, ?, ?);", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, info.st_size);
+        sqlite3_bind_int64(stmt, 3, mtime);
+        sqlite3_bind_int(stmt, 4, today);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+    }
+
+    if (!ok)
+    {
+        std::cerr << "Failed to sync " << path << ": " << sqlite3_errmsg(m_db) << std::endl;
+        m_storage->rollback();
+        return false;
+    }
+    if (!m_storage->commit())
+        return false;
+
+    changes.changed.insert(changes.changed.end(), written.changed.begin(), written.changed.end());
+    changes.removed.insert(changes.removed.end(), written.removed.begin(), written.removed.end());
+    return true;
+}
+
+bool IcsSubscriptions::drop_file(const std::string &path, const std::function<const Reminder *(int)> &current, FeedChanges &changes)
+{
+    if (!m_db || !m_storage || !m_storage->begin())
+        return false;
+
+    std::vector<int> removed;
+    bool ok = true;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT reminder_id FROM ics_events WHERE path = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        while (ok && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            int id = sqlite3_column_int(stmt, 0);
+            if (current(id))
+            {
+                ok = m_storage->remove(id);
+                removed.push_back(id);
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    for (const char *sql : {"DELETE FROM ics_events WHERE path = ?;", "DELETE FROM ics_files WHERE path = ?;"})
+    {
+        if (!ok || sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            ok = false;
+            break;
+        }
+        sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+    }
+
+    if (!ok)
+    {
+        std::cerr << "Failed to drop " << path << ": " << sqlite3_errmsg(m_db) << std::endl;
+        m_storage->rollback();
+        return false;
+    }
+    if (!m_storage->commit())
+        return false;
+
+    changes.removed.insert(changes.removed.end(), removed.begin(), removed.end());
+    return true;
+}
+
+std::vector<std::string> IcsSubscriptions::known_files()
+{
+    std::vector<std::string> files;
+    sqlite3_stmt *stmt;
+
+    if (m_db && sqlite3_prepare_v2(m_db, "SELECT path FROM ics_files;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            files.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return files;
+}
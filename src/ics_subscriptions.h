@@ -0,0 +1,60 @@
+#pragma once
+
+#include "clock.h"
+#include "reminder.h"
+#include "storage_engine.h"
+#include <sqlite3.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// What a sync wrote, for patching the in-memory store and the views
+struct FeedChanges
+{
+    std::vector<Reminder> changed; // Added or updated, as written
+    std::vector<int> removed;
+};
+
+// Reminders kept in step with local .ics files. Each event that happens
+// today becomes a reminder tagged with the file's name. The UID, SEQUENCE
+// and a digest of what the reminder shows are remembered per event, so
+// re-reading a saved feed only writes the events that changed. Files whose
+// size and modification time are unchanged since they were last read
+// today are not read at all.
+class IcsSubscriptions
+{
+public:
+    IcsSubscriptions();
+
+    // Use the app's connection and reminder storage, creating the tables
+    // that map events to reminders
+    void attach(sqlite3 *db, StorageEngine *storage);
+
+    // Paths from the ';'-separated ics_subscriptions setting
+    static std::vector<std::string> split_paths(const std::string &setting);
+
+    // The subscribed files, with each directory replaced by the .ics
+    // files in it
+    static std::vector<std::string> expand(const std::vector<std::string> &paths);
+    static bool is_feed_file(const std::string &path);
+
+    // Bring the reminders of one file up to date, in one transaction. A
+    // file that no longer exists is dropped. current looks up a reminder
+    // as the app has it, to keep its completed state and the user's own
+    // edits to priority and tags. Returns false, with nothing written, if
+    // the file can't be read or a write fails.
+    bool sync_file(const std::string &path, const Clock &clock,
+                   const std::function<const Reminder *(int)> &current, FeedChanges &changes);
+
+    // Remove the reminders of a file that is gone or no longer subscribed
+    bool drop_file(const std::string &path, const std::function<const Reminder *(int)> &current, FeedChanges &changes);
+
+    // Every file synced before
+    std::vector<std::string> known_files();
+
+private:
+    sqlite3 *m_db;
+    StorageEngine *m_storage;
+
+    bool file_unchanged(const std::string &path, sqlite3_int64 size, sqlite3_int64 mtime, int today);
+};
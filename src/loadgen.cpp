@@ -0,0 +1,281 @@
+// Soak and load generator for a running Reminder App instance.
+//
+// Drives the instance through its control channel with a mix of
+// add/edit/toggle/delete commands at a fixed rate. New and edited reminders
+// are timed a few minutes ahead, so deadlines keep firing during the run.
+// Every sample interval it prints one tab separated line of round trip
+// latency, the instance's UI latency, RSS and notification lateness. Limits
+// turn a leak or latency creep into a non-zero exit status.
+//
+// Only reminders created by this run are touched, and they are deleted at
+// the end unless --keep is given. Run the instance under a scratch HOME to
+// keep the load away from real data.
+
+#include "clock.h"
+#include "control_channel.h"
+#include "metrics.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LoadOptions
+{
+    std::string socket_path = control_socket_path();
+    double duration_s = 3600;
+    double rate = 5;                // Commands per second
+    int mix[4] = {40, 30, 20, 10};  // add, edit, toggle, delete weights
+    int max_reminders = 500;        // Adds turn into deletes above this
+    int due_within_min = 10;        // New times fall 1..N minutes ahead
+    double sample_s = 60;
+    bool keep = false;
+
+    // Failure thresholds, 0 disables
+    double max_rss_growth_kb = 0;
+    double max_ui_p99_ms = 0;
+    double max_late_p99_ms = 0;
+};
+
+static void print_usage()
+{
+    std::cerr << "Usage: reminder-loadgen [options]\n"
+              << "  --socket PATH          control socket (default " << control_socket_path() << ")\n"
+              << "  --duration SECONDS     how long to run (default 3600)\n"
+              << "  --rate N               commands per second (default 5)\n"
+              << "  --mix A:E:T:D          add/edit/toggle/delete weights (default 40:30:20:10)\n"
+              << "  --max-reminders N      reminders kept alive at most (default 500)\n"
+              << "  --due-within MINUTES   how far ahead new reminders fire (default 10)\n"
+              << "  --sample SECONDS       reporting interval (default 60)\n"
+              << "  --keep                 leave the generated reminders in place\n"
+              << "  --max-rss-growth KB    fail if RSS grows more than this\n"
+              << "  --max-ui-p99 MS        fail if the UI latency p99 exceeds this\n"
+              << "  --max-late-p99 MS      fail if the notification lateness p99 exceeds this\n";
+}
+
+static bool parse_options(int argc, char *argv[], LoadOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--keep")
+            options.keep = true;
+        else if (arg == "--socket" && has_value)
+            options.socket_path = argv[++i];
+        else if (arg == "--duration" && has_value)
+            options.duration_s = std::atof(argv[++i]);
+        else if (arg == "--rate" && has_value)
+            options.rate = std::atof(argv[++i]);
+        else if (arg == "--max-reminders" && has_value)
+            options.max_reminders = std::atoi(argv[++i]);
+        else if (arg == "--due-within" && has_value)
+            options.due_within_min = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--sample" && has_value)
+            options.sample_s = std::atof(argv[++i]);
+        else if (arg == "--max-rss-growth" && has_value)
+            options.max_rss_growth_kb = std::atof(argv[++i]);
+        else if (arg == "--max-ui-p99" && has_value)
+            options.max_ui_p99_ms = std::atof(argv[++i]);
+        else if (arg == "--max-late-p99" && has_value)
+            options.max_late_p99_ms = std::atof(argv[++i]);
+        else if (arg == "--mix" && has_value)
+        {
+            char sep;
+            std::istringstream mix(argv[++i]);
+            if (!(mix >> options.mix[0] >> sep >> options.mix[1] >> sep >> options.mix[2] >> sep >> options.mix[3]))
+                return false;
+        }
+        else
+            return false;
+    }
+
+    return options.rate > 0 && options.sample_s > 0;
+}
+
+// Parse the key=value fields of a stats reply
+static std::map<std::string, double> parse_stats(const std::string &reply)
+{
+    std::map<std::string, double> stats;
+    std::vector<std::string> fields = split_fields(reply);
+
+    if (fields.empty() || fields[0] != "ok")
+        return stats;
+
+    for (size_t i = 1; i < fields.size(); i++)
+    {
+        size_t equals = fields[i].find('=');
+        if (equals != std::string::npos)
+        {
+            stats[fields[i].substr(0, equals)] = std::atof(fields[i].c_str() + equals + 1);
+        }
+    }
+
+    return stats;
+}
+
+// Local "HH:MM" the given number of minutes from now
+static std::string time_in_minutes(int minutes)
+{
+    Clock &clock = system_clock();
+    std::tm local_tm = clock.local_time(clock.now() + std::chrono::minutes(minutes));
+
+    std::ostringstream time;
+    time << std::setw(2) << std::setfill('0') << local_tm.tm_hour << ":"
+         << std::setw(2) << std::setfill('0') << local_tm.tm_min;
+    return time.str();
+}
+
+int main(int argc, char *argv[])
+{
+    LoadOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        print_usage();
+        return 2;
+    }
+
+    ControlClient client;
+    if (!client.connect(options.socket_path))
+        return 2;
+
+    std::map<std::string, double> baseline = parse_stats(client.request({"stats"}));
+    if (baseline.empty())
+    {
+        std::cerr << "The instance did not answer the stats command" << std::endl;
+        return 2;
+    }
+
+    std::mt19937 rng(std::random_device{}());
+    std::discrete_distribution<int> pick_command({static_cast<double>(options.mix[0]), static_cast<double>(options.mix[1]),
+                                                  static_cast<double>(options.mix[2]), static_cast<double>(options.mix[3])});
+    std::uniform_int_distribution<int> pick_due(1, options.due_within_min);
+
+    std::vector<int> ids; // Reminders created by this run
+    LatencyHistogram round_trip;
+    size_t commands = 0;
+    size_t errors = 0;
+    int next_title = 1;
+
+    std::cout << "elapsed_s\tcommands\terrors\treminders\trtt_p99_ms\tui_p99_ms\tui_max_ms\trss_kb\trss_growth_kb\tfired\tlate_p99_ms\tlate_max_ms" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.rate));
+    auto next_command = start;
+    auto next_sample = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.sample_s));
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.duration_s));
+    std::map<std::string, double> stats = baseline;
+    bool connected = true;
+
+    while (connected && std::chrono::steady_clock::now() < end)
+    {
+        std::this_thread::sleep_until(next_command);
+        next_command += interval;
+
+        int kind = pick_command(rng);
+        if (ids.empty() || (kind == 0 && static_cast<int>(ids.size()) >= options.max_reminders))
+        {
+            kind = ids.empty() ? 0 : 3;
+        }
+
+        std::vector<std::string> request;
+        size_t index = ids.empty() ? 0 : std::uniform_int_distribution<size_t>(0, ids.size() - 1)(rng);
+
+        switch (kind)
+        {
+        case 0:
+            request = {"add", time_in_minutes(pick_due(rng)), "Load " + std::to_string(next_title++)};
+            break;
+        case 1:
+            request = {"edit", std::to_string(ids[index]), time_in_minutes(pick_due(rng)), "Load edited " + std::to_string(next_title++)};
+            break;
+        case 2:
+            request = {"toggle", std::to_string(ids[index])};
+            break;
+        default:
+            request = {"delete", std::to_string(ids[index])};
+            break;
+        }
+
+        auto sent = std::chrono::steady_clock::now();
+        std::string reply = client.request(request);
+        round_trip.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+        commands++;
+
+        if (reply.empty())
+        {
+            std::cerr << "Lost the connection to the instance" << std::endl;
+            connected = false;
+            break;
+        }
+
+        std::vector<std::string> fields = split_fields(reply);
+        if (fields[0] != "ok")
+        {
+            errors++;
+        }
+        else if (kind == 0 && fields.size() > 1)
+        {
+            ids.push_back(std::atoi(fields[1].c_str()));
+        }
+        else if (kind == 3)
+        {
+            ids[index] = ids.back();
+            ids.pop_back();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_sample || now >= end)
+        {
+            next_sample = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.sample_s));
+            stats = parse_stats(client.request({"stats"}));
+
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::chrono::duration<double>(now - start).count() << "\t"
+                      << commands << "\t" << errors << "\t" << ids.size() << "\t"
+                      << round_trip.percentile(99) << "\t"
+                      << stats["ui_p99_ms"] << "\t" << stats["ui_max_ms"] << "\t"
+                      << static_cast<long>(stats["rss_kb"]) << "\t"
+                      << static_cast<long>(stats["rss_kb"] - baseline["rss_kb"]) << "\t"
+                      << static_cast<long>(stats["fired"]) << "\t"
+                      << stats["late_p99_ms"] << "\t" << stats["late_max_ms"] << std::endl;
+        }
+    }
+
+    if (connected && !options.keep)
+    {
+        for (int id : ids)
+        {
+            client.request({"delete", std::to_string(id)});
+        }
+    }
+
+    // Compare the final numbers against the limits
+    int failures = connected ? 0 : 1;
+    double rss_growth = stats["rss_kb"] - baseline["rss_kb"];
+
+    if (options.max_rss_growth_kb > 0 && rss_growth > options.max_rss_growth_kb)
+    {
+        std::cerr << "FAIL: RSS grew by " << rss_growth << " KB (limit " << options.max_rss_growth_kb << ")" << std::endl;
+        failures++;
+    }
+    if (options.max_ui_p99_ms > 0 && stats["ui_p99_ms"] > options.max_ui_p99_ms)
+    {
+        std::cerr << "FAIL: UI latency p99 " << stats["ui_p99_ms"] << " ms (limit " << options.max_ui_p99_ms << ")" << std::endl;
+        failures++;
+    }
+    if (options.max_late_p99_ms > 0 && stats["late_p99_ms"] > options.max_late_p99_ms)
+    {
+        std::cerr << "FAIL: notification lateness p99 " << stats["late_p99_ms"] << " ms (limit " << options.max_late_p99_ms << ")" << std::endl;
+        failures++;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,729 @@
+#include "log_storage.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File header: magic, then the next ID to hand out as of the last compaction
+static const char LOG_MAGIC[8] = {'R', 'M', 'D', 'L', 'O', 'G', '1', '\n'};
+static const size_t HEADER_SIZE = 16;
+
+// Record: payload length, CRC-32 of type and payload, type, payload.
+// Integers are little-endian.
+static const size_t RECORD_HEADER_SIZE = 9;
+
+enum RecordType
+{
+    RECORD_PUT = 1,
+    RECORD_REMOVE = 2,
+    RECORD_FLAG = 3,
+    RECORD_RESET_NOTIFIED = 4,
+    RECORD_BATCH = 5 // Payload is whole records, applied together
+};
+
+static uint32_t crc32(const uint8_t *data, size_t size)
+{
+    static uint32_t table[256];
+    static bool table_ready = false;
+
+    if (!table_ready)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        table_ready = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void put_u32(std::vector<uint8_t> &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+static void put_string(std::vector<uint8_t> &out, const std::string &value)
+{
+    put_u32(out, static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// Bounds-checked cursor over one record's payload
+struct PayloadReader
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok;
+
+    uint32_t u32()
+    {
+        if (end - p < 4)
+        {
+            ok = false;
+            return 0;
+        }
+        uint32_t value = get_u32(p);
+        p += 4;
+        return value;
+    }
+
+    uint8_t u8()
+    {
+        if (p == end)
+        {
+            ok = false;
+            return 0;
+        }
+        return *p++;
+    }
+
+    std::string string()
+    {
+        uint32_t size = u32();
+        if (!ok || static_cast<size_t>(end - p) < size)
+        {
+            ok = false;
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char *>(p), size);
+        p += size;
+        return value;
+    }
+};
+
+// Start a record of the given type; finish_record() fills in its header
+static std::vector<uint8_t> begin_record(RecordType type)
+{
+    std::vector<uint8_t> record(RECORD_HEADER_SIZE, 0);
+    record[8] = static_cast<uint8_t>(type);
+    return record;
+}
+
+static void finish_record(std::vector<uint8_t> &record)
+{
+    uint32_t length = static_cast<uint32_t>(record.size() - RECORD_HEADER_SIZE);
+    uint32_t checksum = crc32(record.data() + 8, record.size() - 8);
+    for (int i = 0; i < 4; i++)
+    {
+        record[i] = static_cast<uint8_t>(length >> (8 * i));
+        record[4 + i] = static_cast<uint8_t>(checksum >> (8 * i));
+    }
+}
+
+static std::vector<uint8_t> put_record(const Reminder &reminder)
+{
+    std::vector<uint8_t> record = begin_record(RECORD_PUT);
+    put_u32(record, static_cast<uint32_t>(reminder.id));
+    record.push_back(reminder.completed ? 1 : 0);
+    record.push_back(reminder.notified ? 1 : 0);
+    put_u32(record, static_cast<uint32_t>(reminder.priority));
+    put_u32(record, static_cast<uint32_t>(reminder.escalate_minutes));
+    put_string(record, reminder.title);
+    put_string(record, reminder.description);
+    put_string(record, reminder.time);
+    put_u32(record, static_cast<uint32_t>(reminder.tags.size()));
+    for (const auto &tag : reminder.tags)
+    {
+        put_string(record, tag);
+    }
+    finish_record(record);
+    return record;
+}
+
+static std::vector<uint8_t> header(int next_id)
+{
+    std::vector<uint8_t> bytes(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC));
+    put_u32(bytes, static_cast<uint32_t>(next_id));
+    put_u32(bytes, 0);
+    return bytes;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Apply one record to the replayed reminders. Returns how many records it
+// held, counting those inside a batch.
+static size_t apply_record(uint8_t type, const uint8_t *payload, size_t length,
+                           std::map<int, Reminder> &reminders, int &next_id)
+{
+    PayloadReader in{payload, payload + length, true};
+    switch (type)
+    {
+    case RECORD_PUT:
+    {
+        Reminder reminder;
+        reminder.id = static_cast<int>(in.u32());
+        reminder.completed = in.u8() != 0;
+        reminder.notified = in.u8() != 0;
+        reminder.priority = static_cast<int>(in.u32());
+        reminder.escalate_minutes = static_cast<int>(in.u32());
+        reminder.title = in.string();
+        reminder.description = in.string();
+        reminder.time = in.string();
+        uint32_t tags = in.u32();
+        for (uint32_t i = 0; in.ok && i < tags; i++)
+        {
+            reminder.tags.push_back(in.string());
+        }
+        if (in.ok)
+        {
+            next_id = std::max(next_id, reminder.id + 1);
+            reminders[reminder.id] = std::move(reminder);
+        }
+        break;
+    }
+    case RECORD_REMOVE:
+    {
+        int id = static_cast<int>(in.u32());
+        reminders.erase(id);
+        next_id = std::max(next_id, id + 1);
+        break;
+    }
+    case RECORD_FLAG:
+    {
+        int id = static_cast<int>(in.u32());
+        uint8_t flag = in.u8();
+        bool value = in.u8() != 0;
+        auto it = reminders.find(id);
+        if (in.ok && it != reminders.end())
+        {
+            (flag == static_cast<uint8_t>(ReminderFlag::Completed) ? it->second.completed : it->second.notified) = value;
+        }
+        break;
+    }
+    case RECORD_RESET_NOTIFIED:
+        for (auto &entry : reminders)
+        {
+            entry.second.notified = false;
+        }
+        break;
+    case RECORD_BATCH:
+    {
+        // Checked as a whole by the outer checksum
+        size_t applied = 0;
+        size_t offset = 0;
+        while (length - offset >= RECORD_HEADER_SIZE)
+        {
+            const uint8_t *record = payload + offset;
+            size_t inner = get_u32(record);
+            if (inner > length - offset - RECORD_HEADER_SIZE)
+                break;
+            applied += apply_record(record[8], record + RECORD_HEADER_SIZE, inner, reminders, next_id);
+            offset += RECORD_HEADER_SIZE + inner;
+        }
+        return applied;
+    }
+    default:
+        // Written by a newer version; skip it
+        break;
+    }
+
+    return 1;
+}
+
+LogStorage::LogStorage(bool sync) : m_fd(-1),
+                                    m_sync(sync),
+                                    m_next_id(1),
+                                    m_records(0),
+                                    m_compactions(0),
+                                    m_have_opened(false),
+                                    m_in_batch(false),
+                                    m_batch_records(0),
+                                    m_batch_next_id(1)
+{
+}
+
+LogStorage::~LogStorage()
+{
+    close();
+}
+
+const char *LogStorage::name() const
+{
+    return m_sync ? "log" : "log-nosync";
+}
+
+bool LogStorage::open(const std::string &path)
+{
+    close();
+
+    m_path = path;
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (m_fd == -1)
+    {
+        std::cerr << "Can't open reminder log " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) == 0 && st.st_size == 0)
+    {
+        std::vector<uint8_t> bytes = header(1);
+        if (!write_all(m_fd, bytes.data(), bytes.size()) || fdatasync(m_fd) != 0)
+        {
+            std::cerr << "Can't initialize reminder log " << path << ": " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    std::map<int, Reminder> reminders;
+    if (!replay(reminders))
+    {
+        close();
+        return false;
+    }
+
+    m_opened.clear();
+    m_opened.reserve(reminders.size());
+    for (auto &entry : reminders)
+    {
+        m_opened.push_back(std::move(entry.second));
+    }
+    m_have_opened = true;
+
+    maybe_compact();
+    return true;
+}
+
+void LogStorage::close()
+{
+    if (m_fd != -1)
+    {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    m_ids.clear();
+    m_opened.clear();
+    m_have_opened = false;
+    m_records = 0;
+    m_next_id = 1;
+    m_in_batch = false;
+    m_batch.clear();
+    m_batch_records = 0;
+    m_batch_ids.clear();
+}
+
+// Rebuild the reminders from the log, cutting off a torn tail if there is one
+bool LogStorage::replay(std::map<int, Reminder> &reminders)
+{
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+        return false;
+
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < HEADER_SIZE)
+    {
+        std::cerr << "Reminder log " << m_path << " is too short to be valid" << std::endl;
+        return false;
+    }
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "Can't map reminder log " << m_path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const uint8_t *data = static_cast<const uint8_t *>(mapped);
+    if (memcmp(data, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+    {
+        std::cerr << m_path << " is not a reminder log" << std::endl;
+        munmap(mapped, size);
+        return false;
+    }
+
+    int next_id = static_cast<int>(get_u32(data + 8));
+    size_t records = 0;
+    size_t offset = HEADER_SIZE;
+
+    while (size - offset >= RECORD_HEADER_SIZE)
+    {
+        const uint8_t *record = data + offset;
+        size_t length = get_u32(record);
+        if (length > size - offset - RECORD_HEADER_SIZE ||
+            crc32(record + 8, length + 1) != get_u32(record + 4))
+            break;
+
+        records += apply_record(record[8], record + RECORD_HEADER_SIZE, length, reminders, next_id);
+        offset += RECORD_HEADER_SIZE + length;
+    }
+
+    munmap(mapped, size);
+
+    // Whatever follows the last whole record was being written when we died
+    if (offset < size)
+    {
+        std::cerr << "Discarding " << size - offset << " bytes of incomplete records at the end of "
+                  << m_path << std::endl;
+        if (ftruncate(m_fd, static_cast<off_t>(offset)) != 0)
+        {
+            std::cerr << "Can't truncate reminder log: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    m_next_id = next_id;
+    m_records = records;
+    m_ids.clear();
+    for (const auto &entry : reminders)
+    {
+        m_ids.insert(entry.first);
+    }
+    return true;
+}
+
+bool LogStorage::load_all(std::vector<Reminder> &reminders)
+{
+    if (m_fd == -1)
+        return false;
+
+    // The first load after open() reuses the replay open() already did
+    if (m_have_opened)
+    {
+        reminders.swap(m_opened);
+        m_opened.clear();
+        m_have_opened = false;
+        return true;
+    }
+
+    std::map<int, Reminder> replayed;
+    if (!replay(replayed))
+        return false;
+
+    reminders.clear();
+    reminders.reserve(replayed.size());
+    for (auto &entry : replayed)
+    {
+        reminders.push_back(std::move(entry.second));
+    }
+    return true;
+}
+
+bool LogStorage::append(const std::vector<uint8_t> &record)
+{
+    if (m_fd == -1)
+        return false;
+
+    if (m_in_batch)
+    {
+        m_batch.insert(m_batch.end(), record.begin(), record.end());
+        m_batch_records++;
+        return true;
+    }
+
+    off_t end = lseek(m_fd, 0, SEEK_END);
+    if (end == -1)
+    {
+        std::cerr << "Failed to append to reminder log: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (!write_all(m_fd, record.data(), record.size()) || (m_sync && fdatasync(m_fd) != 0))
+    {
+        std::cerr << "Failed to append to reminder log: " << strerror(errno) << std::endl;
+
+        // Part of the record may have been written. Records appended after
+        // it would be cut off with it on the next open, so it has to go;
+        // if it can't, no further writes are accepted.
+        if (ftruncate(m_fd, end) != 0)
+        {
+            std::cerr << "Failed to remove a partial record from the reminder log: " << strerror(errno)
+                      << "; refusing further writes" << std::endl;
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        return false;
+    }
+
+    m_records++;
+    return true;
+}
+
+int LogStorage::insert(const Reminder &reminder)
+{
+    if (m_fd == -1)
+        return -1;
+
+    Reminder added = reminder;
+    added.id = m_next_id;
+    if (!append(put_record(added)))
+        return -1;
+
+    m_next_id++;
+    add_id(added.id);
+    maybe_compact();
+    return added.id;
+}
+
+bool LogStorage::restore(const Reminder &reminder)
+{
+    if (m_fd == -1 || m_ids.count(reminder.id) != 0)
+        return false;
+
+    if (!append(put_record(reminder)))
+        return false;
+
+    m_next_id = std::max(m_next_id, reminder.id + 1);
+    add_id(reminder.id);
+    maybe_compact();
+    return true;
+}
+
+bool LogStorage::update(const Reminder &reminder, bool)
+{
+    // A reminder that is gone stays gone
+    if (m_ids.count(reminder.id) == 0)
+        return false;
+
+    if (!append(put_record(reminder)))
+        return false;
+
+    maybe_compact();
+    return true;
+}
+
+bool LogStorage::remove(int id)
+{
+    if (m_ids.count(id) == 0)
+        return m_fd != -1;
+
+    std::vector<uint8_t> record = begin_record(RECORD_REMOVE);
+    put_u32(record, static_cast<uint32_t>(id));
+    finish_record(record);
+    if (!append(record))
+        return false;
+
+    drop_id(id);
+    maybe_compact();
+    return true;
+}
+
+bool LogStorage::set_flag(int id, ReminderFlag flag, bool value)
+{
+    if (m_ids.count(id) == 0)
+        return m_fd != -1;
+
+    std::vector<uint8_t> record = begin_record(RECORD_FLAG);
+    put_u32(record, static_cast<uint32_t>(id));
+    record.push_back(static_cast<uint8_t>(flag));
+    record.push_back(value ? 1 : 0);
+    finish_record(record);
+    if (!append(record))
+        return false;
+
+    maybe_compact();
+    return true;
+}
+
+bool LogStorage::reset_notified()
+{
+    std::vector<uint8_t> record = begin_record(RECORD_RESET_NOTIFIED);
+    finish_record(record);
+    if (!append(record))
+        return false;
+
+    maybe_compact();
+    return true;
+}
+
+void LogStorage::maybe_compact()
+{
+    if (!m_in_batch && m_records > COMPACT_MIN_RECORDS && m_records > COMPACT_RATIO * m_ids.size())
+    {
+        compact();
+    }
+}
+
+bool LogStorage::compact()
+{
+    if (m_fd == -1)
+        return false;
+
+    std::map<int, Reminder> reminders;
+    if (!replay(reminders))
+        return false;
+
+    size_t before = m_records;
+    std::string partial = m_path + ".compact";
+    int fd = ::open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1)
+    {
+        std::cerr << "Can't compact reminder log: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // One buffered write for the whole file
+    std::vector<uint8_t> bytes = header(m_next_id);
+    for (const auto &entry : reminders)
+    {
+        std::vector<uint8_t> record = put_record(entry.second);
+        bytes.insert(bytes.end(), record.begin(), record.end());
+    }
+
+    bool ok = write_all(fd, bytes.data(), bytes.size()) && fsync(fd) == 0;
+    ::close(fd);
+
+    if (!ok || rename(partial.c_str(), m_path.c_str()) != 0)
+    {
+        std::cerr << "Can't compact reminder log: " << strerror(errno) << std::endl;
+        unlink(partial.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable
+    size_t slash = m_path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : m_path.substr(0, slash + 1);
+    int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd != -1)
+    {
+        fsync(dir_fd);
+        ::close(dir_fd);
+    }
+
+    int reopened = ::open(m_path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (reopened == -1)
+    {
+        std::cerr << "Can't reopen compacted reminder log: " << strerror(errno) << std::endl;
+        return false;
+    }
+    ::close(m_fd);
+    m_fd = reopened;
+
+    m_records = reminders.size();
+    m_compactions++;
+    std::cout << "Compacted reminder log from " << before << " to " << m_records << " records" << std::endl;
+    return true;
+}
+
+bool LogStorage::begin()
+{
+    if (m_fd == -1 || m_in_batch)
+        return false;
+
+    m_in_batch = true;
+    m_batch = begin_record(RECORD_BATCH);
+    m_batch_records = 0;
+    m_batch_ids.clear();
+    m_batch_next_id = m_next_id;
+    return true;
+}
+
+bool LogStorage::commit()
+{
+    if (!m_in_batch)
+        return false;
+
+    m_in_batch = false;
+    if (m_batch_records == 0)
+    {
+        m_batch.clear();
+        return true;
+    }
+
+    // A single record, so a crash keeps all of the batch or none of it
+    finish_record(m_batch);
+    size_t records = m_batch_records;
+    bool ok = append(m_batch);
+    m_batch.clear();
+    m_batch_records = 0;
+    if (!ok)
+    {
+        undo_batch();
+        return false;
+    }
+
+    m_records += records - 1;
+    m_batch_ids.clear();
+    maybe_compact();
+    return true;
+}
+
+void LogStorage::rollback()
+{
+    if (!m_in_batch)
+        return;
+
+    m_in_batch = false;
+    m_batch.clear();
+    m_batch_records = 0;
+    undo_batch();
+}
+
+void LogStorage::add_id(int id)
+{
+    m_ids.insert(id);
+    if (m_in_batch)
+        m_batch_ids.emplace_back(id, true);
+}
+
+void LogStorage::drop_id(int id)
+{
+    m_ids.erase(id);
+    if (m_in_batch)
+        m_batch_ids.emplace_back(id, false);
+}
+
+// Put the ids back the way begin() found them, newest change first
+void LogStorage::undo_batch()
+{
+    for (auto it = m_batch_ids.rbegin(); it != m_batch_ids.rend(); ++it)
+    {
+        if (it->second)
+            m_ids.erase(it->first);
+        else
+            m_ids.insert(it->first);
+    }
+    m_batch_ids.clear();
+    m_next_id = m_batch_next_id;
+}
+
+size_t LogStorage::records() const
+{
+    return m_records;
+}
+
+size_t LogStorage::compactions() const
+{
+    return m_compactions;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "storage_engine.h"
+
+// Reminders as an append-only log of small checksummed records: whole
+// reminders, removals, flag changes and daily resets. Loading maps the file
+// and replays it front to back; each mutation is a single write() of a few
+// dozen bytes. Once superseded records outnumber live reminders several
+// times over, the log is compacted into one record per reminder, written
+// next to it and renamed into place.
+//
+// A record torn by a crash fails its checksum and is cut off on the next
+// open, and one left by a failed write is cut off straight away, so a
+// mutation is either wholly in the log or not at all. The file belongs to
+// one process at a time.
+class LogStorage : public StorageEngine
+{
+public:
+    // With sync on, every mutation is flushed to disk before returning
+    explicit LogStorage(bool sync = true);
+    virtual ~LogStorage();
+
+    const char *name() const override;
+
+    bool open(const std::string &path) override;
+    void close() override;
+
+    bool load_all(std::vector<Reminder> &reminders) override;
+    int insert(const Reminder &reminder) override;
+    bool restore(const Reminder &reminder) override;
+    bool update(const Reminder &reminder, bool tags_changed) override;
+    bool remove(int id) override;
+    bool set_flag(int id, ReminderFlag flag, bool value) override;
+    bool reset_notified() override;
+
+    // Mutations between begin() and commit() are buffered and written as
+    // one batch record
+    bool begin() override;
+    bool commit() override;
+    void rollback() override;
+
+    // Rewrite the log with one record per live reminder
+    bool compact();
+
+    size_t records() const;
+    size_t compactions() const;
+
+private:
+    static const size_t COMPACT_MIN_RECORDS = 1024;
+    static const size_t COMPACT_RATIO = 4;
+
+    std::string m_path;
+    int m_fd;
+    bool m_sync;
+    int m_next_id;
+    size_t m_records;
+    size_t m_compactions;
+    std::unordered_set<int> m_ids;
+
+    // What open() replayed, handed out by the first load_all()
+    std::vector<Reminder> m_opened;
+    bool m_have_opened;
+
+    // Open batch: its records, and what to undo on rollback. Each id the
+    // batch added (true) or dropped (false) is noted in order, so undoing
+    // costs as much as the batch did rather than a copy of every id.
+    bool m_in_batch;
+    std::vector<uint8_t> m_batch;
+    size_t m_batch_records;
+    std::vector<std::pair<int, bool>> m_batch_ids;
+    int m_batch_next_id;
+
+    bool replay(std::map<int, Reminder> &reminders);
+    void add_id(int id);
+    void drop_id(int id);
+    void undo_batch();
+    bool append(const std::vector<uint8_t> &record);
+    void maybe_compact();
+};
@@ -1,5 +1,9 @@
 #include "reminder_app.h"
+#include "simulation.h"
+#include "database_backup.h"
+#include "reminder_query.h"
 #include <gtkmm.h>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <vector>
@@ -10,7 +14,7 @@
 // Function to check for another running instance
 bool is_another_instance_running()
 {
-    int pid_file = open("/tmp/reminder_app.lock", O_CREAT | O_RDWR, 0666);
+    int pid_file = open(instance_lock_path().c_str(), O_CREAT | O_RDWR, 0600);
     if (pid_file == -1)
     {
         std::cerr << "Failed to open lock file" << std::endl;
@@ -29,8 +33,140 @@ bool is_another_instance_running()
     return false;
 }
 
+// Run the scheduler against a simulated clock, without GTK or the database.
+// Usage: --simulate [--reminders N] [--days D] [--step S] [--snooze-ratio R]
+//                   [--seed X] [--seconds] [--events]
+int run_simulation(int argc, char *argv[])
+{
+    SimulationOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--reminders") == 0 && has_value)
+            options.reminders = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--days") == 0 && has_value)
+            options.days = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--step") == 0 && has_value)
+            options.step_seconds = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--snooze-ratio") == 0 && has_value)
+            options.snooze_ratio = std::atof(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value)
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--seconds") == 0)
+            options.seconds = true;
+        else if (strcmp(argv[i], "--events") == 0)
+            options.print_events = true;
+    }
+
+    Simulation simulation(options);
+    return simulation.run(std::cout);
+}
+
+// Take a snapshot now, or restore one (the newest if no file is given).
+// Usage: --backup | --restore [FILE]
+int run_backup_command(int argc, char *argv[])
+{
+    std::string db_path = std::string(getenv("HOME")) + "/.local/share/reminders.db";
+    BackupOptions options = load_backup_options(db_path);
+
+    if (strcmp(argv[1], "--backup") == 0)
+    {
+        std::atomic<bool> cancel(false);
+        std::string snapshot;
+        return backup_database(options, cancel, snapshot) ? 0 : 1;
+    }
+
+    // Restoring under a running instance would leave it with stale state
+    if (is_another_instance_running())
+    {
+        std::cerr << "Quit Reminder App before restoring a backup." << std::endl;
+        return 1;
+    }
+
+    std::string snapshot;
+    if (argc > 2)
+    {
+        snapshot = argv[2];
+    }
+    else
+    {
+        std::vector<std::string> snapshots = list_backups(options.dir);
+        if (snapshots.empty())
+        {
+            std::cerr << "No backups in " << options.dir << std::endl;
+            return 1;
+        }
+        snapshot = snapshots.back();
+    }
+
+    if (!restore_database(options, snapshot))
+        return 1;
+
+    // The startup snapshot describes the database that was replaced
+    unlink(snapshot_path_for(db_path).c_str());
+    return 0;
+}
+
+// Read-only queries for scripts, answered without GTK or the instance lock.
+// Usage: list|due|overdue [--json|--tsv] [--since HH:MM] [--until HH:MM]
+//                         [--count] [--db PATH]
+int run_query_command(int argc, char *argv[])
+{
+    QueryOptions options;
+    parse_query_kind(argv[1], options.kind);
+    options.db_path = std::string(getenv("HOME")) + "/.local/share/reminders.db";
+
+    for (int i = 2; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--json") == 0)
+            options.format = QueryFormat::Json;
+        else if (strcmp(argv[i], "--tsv") == 0)
+            options.format = QueryFormat::Tsv;
+        else if (strcmp(argv[i], "--since") == 0 && has_value)
+            options.since = argv[++i];
+        else if (strcmp(argv[i], "--until") == 0 && has_value)
+            options.until = argv[++i];
+        else if (strcmp(argv[i], "--count") == 0)
+            options.count = true;
+        else if (strcmp(argv[i], "--db") == 0 && has_value)
+            options.db_path = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " " << argv[1]
+                      << " [--json|--tsv] [--since HH:MM] [--until HH:MM] [--count] [--db PATH]" << std::endl;
+            return 2;
+        }
+    }
+
+    // Results are written as they are read; nothing else shares stdout
+    std::ios::sync_with_stdio(false);
+    return run_query(options, system_clock(), std::cout);
+}
+
 int main(int argc, char *argv[])
 {
+    QueryKind kind;
+    if (argc > 1 && parse_query_kind(argv[1], kind))
+    {
+        return run_query_command(argc, argv);
+    }
+
+    if (argc > 1 && (strcmp(argv[1], "--backup") == 0 || strcmp(argv[1], "--restore") == 0))
+    {
+        return run_backup_command(argc, argv);
+    }
+
+    // The simulation neither touches the database nor needs a display
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--simulate") == 0)
+        {
+            return run_simulation(argc, argv);
+        }
+    }
+
     // Check for another running instance
     if (is_another_instance_running())
     {
@@ -0,0 +1,108 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+// Bucket 0 holds everything under 10 us; each further bucket is 10% wider
+static const double BUCKET_BASE_MS = 0.01;
+static const double BUCKET_GROWTH = 1.1;
+static const size_t BUCKET_COUNT = 256; // Tops out above an hour
+
+static size_t bucket_of(double ms)
+{
+    if (ms < BUCKET_BASE_MS)
+        return 0;
+
+    size_t bucket = 1 + static_cast<size_t>(std::log(ms / BUCKET_BASE_MS) / std::log(BUCKET_GROWTH));
+    return std::min(bucket, BUCKET_COUNT - 1);
+}
+
+static double bucket_upper_bound(size_t bucket)
+{
+    return BUCKET_BASE_MS * std::pow(BUCKET_GROWTH, static_cast<double>(bucket));
+}
+
+LatencyHistogram::LatencyHistogram() : m_buckets(BUCKET_COUNT, 0),
+                                       m_count(0),
+                                       m_sum(0.0),
+                                       m_max(0.0)
+{
+}
+
+void LatencyHistogram::record(double ms)
+{
+    if (ms < 0.0)
+        ms = 0.0;
+
+    m_buckets[bucket_of(ms)]++;
+    m_count++;
+    m_sum += ms;
+    m_max = std::max(m_max, ms);
+}
+
+void LatencyHistogram::reset()
+{
+    std::fill(m_buckets.begin(), m_buckets.end(), 0);
+    m_count = 0;
+    m_sum = 0.0;
+    m_max = 0.0;
+}
+
+size_t LatencyHistogram::count() const
+{
+    return m_count;
+}
+
+double LatencyHistogram::mean() const
+{
+    return m_count ? m_sum / m_count : 0.0;
+}
+
+double LatencyHistogram::max() const
+{
+    return m_max;
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+    if (m_count == 0)
+        return 0.0;
+
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * m_count));
+    rank = std::max<size_t>(rank, 1);
+
+    size_t seen = 0;
+    for (size_t i = 0; i < m_buckets.size(); i++)
+    {
+        seen += m_buckets[i];
+        if (seen >= rank)
+        {
+            // Never report more than was actually observed
+            return std::min(bucket_upper_bound(i), m_max);
+        }
+    }
+
+    return m_max;
+}
+
+long resident_memory_kb()
+{
+    // Second field of statm is the resident page count
+    std::ifstream statm("/proc/self/statm");
+    long size = 0;
+    long resident = 0;
+    if (!(statm >> size >> resident))
+        return 0;
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+std::string metric_field(const std::string &key, double value)
+{
+    std::ostringstream field;
+    field << key << "=" << std::fixed << std::setprecision(value == std::floor(value) ? 0 : 2) << value;
+    return field.str();
+}
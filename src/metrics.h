@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Millisecond latency recorder with fixed memory: samples fall into
+// logarithmic buckets, so hours of recording cost the same as a minute.
+// Percentiles are accurate to within a bucket (about 10%).
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(double ms);
+    void reset();
+
+    size_t count() const;
+    double mean() const;
+    double max() const;
+    double percentile(double p) const; // p in [0, 100]
+
+private:
+    std::vector<size_t> m_buckets;
+    size_t m_count;
+    double m_sum;
+    double m_max;
+};
+
+// Resident set size of this process in kilobytes, 0 if unavailable
+long resident_memory_kb();
+
+// "key=value" field for the control channel's replies
+std::string metric_field(const std::string &key, double value);
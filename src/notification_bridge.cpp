@@ -0,0 +1,214 @@
+#include "notification_bridge.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <grp.h>
+#include <libnotify/notify.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A delivery child gives up on a notification nobody closed after this long
+static const unsigned DELIVERY_TIMEOUT_SECONDS = 3600;
+
+int notification_urgency(int priority, int notice)
+{
+    int urgency = (priority == PRIORITY_LOW ? NOTIFY_URGENCY_LOW : NOTIFY_URGENCY_NORMAL) + notice;
+    return std::min(urgency, static_cast<int>(NOTIFY_URGENCY_CRITICAL));
+}
+
+std::string notification_summary(const Reminder &reminder, int notice)
+{
+    if (notice == 0)
+        return reminder.title;
+
+    return reminder.title + " (reminder " + std::to_string(notice + 1) + ")";
+}
+
+std::string notification_body(const Reminder &reminder)
+{
+    gchar *escaped = g_markup_escape_text(reminder.description.c_str(), -1);
+    std::string body = escaped;
+    g_free(escaped);
+    return body;
+}
+
+const char *notification_icon(int notice)
+{
+    return notice > 0 ? "dialog-warning" : "dialog-information";
+}
+
+const char *const SERVICE_LOCK_PATH = "/run/reminderd.lock";
+
+bool delivery_service_active()
+{
+    int fd = open(SERVICE_LOCK_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    // A shared lock is refused only while the service holds its exclusive one
+    bool held = flock(fd, LOCK_SH | LOCK_NB) == -1 && errno == EWOULDBLOCK;
+    close(fd);
+    return held;
+}
+
+static std::string session_bus_path(uid_t uid)
+{
+    return "/run/user/" + std::to_string(uid) + "/bus";
+}
+
+bool has_session_bus(uid_t uid)
+{
+    struct stat st;
+    return stat(session_bus_path(uid).c_str(), &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+pid_t spawn_delivery(const DeliveryTarget &target, const Reminder &reminder, int notice, int &action_fd)
+{
+    action_fd = -1;
+
+    // Everything the child needs is prepared before fork; between fork and
+    // exec it only makes system calls
+    std::vector<std::string> args = {"reminderd", "--deliver",
+                                     notification_summary(reminder, notice),
+                                     notification_body(reminder),
+                                     std::to_string(notification_urgency(reminder.priority, notice)),
+                                     notification_icon(notice)};
+    std::vector<std::string> env = {"DBUS_SESSION_BUS_ADDRESS=unix:path=" + session_bus_path(target.uid),
+                                    "XDG_RUNTIME_DIR=/run/user/" + std::to_string(target.uid),
+                                    "HOME=" + target.home,
+                                    "PATH=/usr/bin:/bin"};
+
+    std::vector<char *> argv;
+    for (auto &arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    std::vector<char *> envp;
+    for (auto &var : env)
+        envp.push_back(&var[0]);
+    envp.push_back(nullptr);
+
+    bool switch_user = getuid() == 0;
+    if (!switch_user && target.uid != getuid())
+    {
+        std::cerr << "Cannot deliver to uid " << target.uid << " without root privileges" << std::endl;
+        return -1;
+    }
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        std::cerr << "Failed to create delivery pipe: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        std::cerr << "Failed to fork delivery process: " << std::strerror(errno) << std::endl;
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        dup2(fds[1], STDOUT_FILENO);
+
+        // The service reads signals from a descriptor; the child must not
+        // inherit them blocked
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+
+        // Drop to the user for good before touching their session
+        if (switch_user &&
+            (setgroups(1, &target.gid) == -1 || setgid(target.gid) == -1 || setuid(target.uid) == -1))
+        {
+            _exit(127);
+        }
+
+        execve("/proc/self/exe", argv.data(), envp.data());
+        _exit(127);
+    }
+
+    close(fds[1]);
+    action_fd = fds[0];
+    return pid;
+}
+
+struct DeliveryState
+{
+    GMainLoop *loop;
+    std::string action;
+};
+
+int run_delivery(int argc, char *argv[])
+{
+    if (argc < 6)
+    {
+        std::cerr << "Usage: reminderd --deliver <summary> <body> <urgency> <icon>" << std::endl;
+        return 2;
+    }
+
+    if (!notify_init("Reminders"))
+        return 1;
+
+    DeliveryState state;
+    state.loop = g_main_loop_new(nullptr, FALSE);
+
+    NotifyNotification *notification = notify_notification_new(argv[2], argv[3], argv[5]);
+    notify_notification_set_urgency(notification, static_cast<NotifyUrgency>(std::atoi(argv[4])));
+    notify_notification_set_timeout(notification, NOTIFY_EXPIRES_DEFAULT);
+
+    NotifyActionCallback on_action = +[](NotifyNotification *, char *action, gpointer user_data)
+    {
+        auto state = static_cast<DeliveryState *>(user_data);
+        state->action = action;
+        g_main_loop_quit(state->loop);
+    };
+    notify_notification_add_action(notification, "snooze-5", "Snooze 5 min", on_action, &state, nullptr);
+    notify_notification_add_action(notification, "snooze-15", "Snooze 15 min", on_action, &state, nullptr);
+    notify_notification_add_action(notification, "snooze-60", "Snooze 1 hour", on_action, &state, nullptr);
+    notify_notification_add_action(notification, "done", "Done", on_action, &state, nullptr);
+
+    g_signal_connect(notification, "closed", G_CALLBACK(+[](NotifyNotification *, gpointer user_data)
+                                                        { g_main_loop_quit(static_cast<DeliveryState *>(user_data)->loop); }),
+                     &state);
+    g_timeout_add_seconds(DELIVERY_TIMEOUT_SECONDS, +[](gpointer user_data) -> gboolean
+                          {
+                              g_main_loop_quit(static_cast<DeliveryState *>(user_data)->loop);
+                              return G_SOURCE_REMOVE; },
+                          &state);
+
+    GError *error = nullptr;
+    int status = 0;
+    if (notify_notification_show(notification, &error))
+    {
+        g_main_loop_run(state.loop);
+        if (!state.action.empty())
+        {
+            std::cout << state.action << std::endl;
+        }
+    }
+    else
+    {
+        std::cerr << "Failed to show notification: " << (error ? error->message : "unknown error") << std::endl;
+        if (error)
+        {
+            g_error_free(error);
+        }
+        status = 1;
+    }
+
+    g_object_unref(G_OBJECT(notification));
+    g_main_loop_unref(state.loop);
+    notify_uninit();
+    return status;
+}
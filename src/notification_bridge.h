@@ -0,0 +1,43 @@
+#pragma once
+
+#include "reminder.h"
+#include <string>
+#include <sys/types.h>
+
+// Delivers reminderd's notifications into a user's desktop session. Each
+// notification is shown by a short-lived child that runs as the user and
+// talks to the user's own session bus, so the service never connects to a
+// bus as root and users never see each other's reminders. The child stays
+// until the notification is closed and reports the chosen action back.
+
+struct DeliveryTarget
+{
+    uid_t uid;
+    gid_t gid;
+    std::string home;
+};
+
+// How a notice is presented, shared with the desktop app: repeat notices
+// climb from the priority's urgency to critical and say which notice it is
+int notification_urgency(int priority, int notice); // A NotifyUrgency value
+std::string notification_summary(const Reminder &reminder, int notice);
+// Servers render the body as markup, so the description is escaped; the
+// summary is always plain text
+std::string notification_body(const Reminder &reminder);
+const char *notification_icon(int notice);
+
+// reminderd holds an exclusive lock on this file while it runs. The desktop
+// app then leaves delivery to the service so nothing is notified twice.
+extern const char *const SERVICE_LOCK_PATH;
+bool delivery_service_active();
+
+// Whether the user has a session bus to deliver to
+bool has_session_bus(uid_t uid);
+
+// Start a delivery child. Returns its pid and the read end of a pipe that
+// yields the chosen action ("done", "snooze-<minutes>") or nothing if the
+// notification was dismissed; -1 on failure.
+pid_t spawn_delivery(const DeliveryTarget &target, const Reminder &reminder, int notice, int &action_fd);
+
+// Entry point of the child: reminderd --deliver <summary> <body> <urgency> <icon>
+int run_delivery(int argc, char *argv[]);
@@ -0,0 +1,147 @@
+#include "notification_sink.h"
+#include <algorithm>
+#include <iostream>
+
+SinkQueue::SinkQueue(std::unique_ptr<NotificationSink> sink) : m_sink(std::move(sink)),
+                                                                m_policy(m_sink->policy()),
+                                                                m_stopping(false),
+                                                                m_delivered(0),
+                                                                m_dropped(0),
+                                                                m_failed(0)
+{
+    m_policy.capacity = std::max<size_t>(m_policy.capacity, 1);
+    m_policy.max_batch = std::max<size_t>(m_policy.max_batch, 1);
+    m_thread = std::thread(&SinkQueue::run, this);
+}
+
+SinkQueue::~SinkQueue()
+{
+    stop();
+}
+
+void SinkQueue::push(const DeliveryEvent &event)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping)
+            return;
+
+        if (m_queue.size() >= m_policy.capacity)
+        {
+            m_dropped++;
+            if (m_policy.overflow == SinkPolicy::DropNewest)
+                return;
+
+            m_queue.pop_front();
+            m_arrived.pop_front();
+        }
+
+        m_queue.push_back(event);
+        m_arrived.push_back(std::chrono::steady_clock::now());
+    }
+
+    m_wakeup.notify_one();
+}
+
+void SinkQueue::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_sink->cancel();
+    m_wakeup.notify_one();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+const char *SinkQueue::name() const
+{
+    return m_sink->name();
+}
+
+size_t SinkQueue::delivered() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_delivered;
+}
+
+size_t SinkQueue::dropped() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+size_t SinkQueue::failed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+void SinkQueue::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_wakeup.wait(lock, [this]()
+                      { return m_stopping || !m_queue.empty(); });
+
+        if (m_queue.empty())
+            break; // Stopping with nothing left
+
+        // Give a partial batch until max_delay after its first event to fill
+        // up. Events left over from the last batch have already waited.
+        m_wakeup.wait_until(lock, m_arrived.front() + m_policy.max_delay, [this]()
+                            { return m_stopping || m_queue.size() >= m_policy.max_batch; });
+
+        size_t count = std::min(m_queue.size(), m_policy.max_batch);
+        std::vector<DeliveryEvent> batch(m_queue.begin(), m_queue.begin() + count);
+        m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+        m_arrived.erase(m_arrived.begin(), m_arrived.begin() + count);
+
+        // The sink may be slow; producers only ever wait for the lock
+        lock.unlock();
+        bool ok = m_sink->deliver(batch);
+        lock.lock();
+
+        if (ok)
+        {
+            m_delivered += batch.size();
+        }
+        else
+        {
+            m_failed += batch.size();
+            std::cerr << "Notification sink " << m_sink->name() << " lost " << batch.size() << " event(s)" << std::endl;
+        }
+    }
+}
+
+void NotificationDispatcher::add_sink(std::unique_ptr<NotificationSink> sink)
+{
+    m_queues.push_back(std::unique_ptr<SinkQueue>(new SinkQueue(std::move(sink))));
+}
+
+void NotificationDispatcher::publish(const DeliveryEvent &event)
+{
+    for (auto &queue : m_queues)
+    {
+        queue->push(event);
+    }
+}
+
+void NotificationDispatcher::stop()
+{
+    for (auto &queue : m_queues)
+    {
+        queue->stop();
+    }
+}
+
+const std::vector<std::unique_ptr<SinkQueue>> &NotificationDispatcher::queues() const
+{
+    return m_queues;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "clock.h"
+#include "scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One reminder firing, as handed to the sinks
+struct DeliveryEvent
+{
+    int reminder_id;
+    std::string title;
+    std::string description;
+    std::string time;
+    int priority;
+    int notice; // 0 for the first notice, then one per escalation
+    DeadlineKind kind;
+    Clock::time_point deadline;
+    Clock::time_point delivered;
+};
+
+// How a sink's queue batches and what it gives up when the sink falls behind
+struct SinkPolicy
+{
+    enum Overflow
+    {
+        DropOldest, // Keep the most recent events
+        DropNewest  // Keep what is already queued
+    };
+
+    size_t capacity = 1024;
+    size_t max_batch = 64;
+    std::chrono::milliseconds max_delay{200}; // Wait this long to fill a batch
+    Overflow overflow = DropOldest;
+};
+
+// An output for fired reminders besides the desktop notification. deliver()
+// runs on the sink's own thread and returns false if the batch was lost.
+class NotificationSink
+{
+public:
+    NotificationSink() : m_cancelled(false) {}
+    virtual ~NotificationSink() {}
+
+    virtual const char *name() const = 0;
+    virtual SinkPolicy policy() const = 0;
+    virtual bool deliver(const std::vector<DeliveryEvent> &batch) = 0;
+
+    // Set on shutdown so a sink stops retrying
+    void cancel() { m_cancelled = true; }
+    bool cancelled() const { return m_cancelled; }
+
+private:
+    std::atomic<bool> m_cancelled;
+};
+
+// Bounded queue with a worker thread in front of one sink. push() never
+// blocks; when the queue is full the policy decides what is dropped.
+class SinkQueue
+{
+public:
+    explicit SinkQueue(std::unique_ptr<NotificationSink> sink);
+    virtual ~SinkQueue();
+
+    void push(const DeliveryEvent &event);
+
+    // Deliver what is queued, then stop the worker
+    void stop();
+
+    const char *name() const;
+    size_t delivered() const;
+    size_t dropped() const;
+    size_t failed() const;
+
+private:
+    std::unique_ptr<NotificationSink> m_sink;
+    SinkPolicy m_policy;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<DeliveryEvent> m_queue;
+    std::deque<std::chrono::steady_clock::time_point> m_arrived; // When each queued event arrived
+    bool m_stopping;
+    std::thread m_thread;
+
+    size_t m_delivered;
+    size_t m_dropped;
+    size_t m_failed;
+
+    void run();
+};
+
+// Fans fired reminders out to every configured sink
+class NotificationDispatcher
+{
+public:
+    void add_sink(std::unique_ptr<NotificationSink> sink);
+    void publish(const DeliveryEvent &event);
+    void stop();
+
+    const std::vector<std::unique_ptr<SinkQueue>> &queues() const;
+
+private:
+    std::vector<std::unique_ptr<SinkQueue>> m_queues;
+};
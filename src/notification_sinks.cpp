@@ -0,0 +1,403 @@
+#include "notification_sinks.h"
+#include "reminder.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char *JOURNAL_SOCKET_PATH = "/run/systemd/journal/socket";
+static const int WEBHOOK_ATTEMPTS = 3;
+static const int WEBHOOK_TIMEOUT_SECONDS = 5;
+
+std::string format_event_time(Clock::time_point when)
+{
+    std::time_t seconds = std::chrono::system_clock::to_time_t(when);
+    std::tm tm_buf;
+    localtime_r(&seconds, &tm_buf);
+
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S%z", &tm_buf);
+    return buffer;
+}
+
+long long event_lateness_ms(const DeliveryEvent &event)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(event.delivered - event.deadline).count();
+}
+
+// Tabs and newlines would break the line-per-event log format
+static std::string single_line(const std::string &text)
+{
+    std::string result = text;
+    for (char &c : result)
+    {
+        if (c == '\t' || c == '\n' || c == '\r')
+            c = ' ';
+    }
+    return result;
+}
+
+static std::string json_string(const std::string &text)
+{
+    std::string result = "\"";
+    for (unsigned char c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if (c < 0x20)
+            {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                result += escape;
+            }
+            else
+            {
+                result += static_cast<char>(c);
+            }
+        }
+    }
+    return result + "\"";
+}
+
+std::string delivery_events_json(const std::vector<DeliveryEvent> &batch)
+{
+    std::ostringstream out;
+    out << "{\"events\":[";
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        const DeliveryEvent &event = batch[i];
+        if (i > 0)
+            out << ",";
+        out << "{\"reminder_id\":" << event.reminder_id
+            << ",\"title\":" << json_string(event.title)
+            << ",\"description\":" << json_string(event.description)
+            << ",\"time\":" << json_string(event.time)
+            << ",\"priority\":" << event.priority
+            << ",\"notice\":" << event.notice
+            << ",\"kind\":" << json_string(deadline_kind_name(event.kind))
+            << ",\"deadline\":" << json_string(format_event_time(event.deadline))
+            << ",\"lateness_ms\":" << event_lateness_ms(event) << "}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+LogFileSink::LogFileSink(const std::string &path) : m_path(path)
+{
+}
+
+const char *LogFileSink::name() const
+{
+    return "log";
+}
+
+SinkPolicy LogFileSink::policy() const
+{
+    SinkPolicy policy;
+    policy.capacity = 4096;
+    policy.max_batch = 256;
+    policy.max_delay = std::chrono::milliseconds(500);
+    return policy;
+}
+
+bool LogFileSink::deliver(const std::vector<DeliveryEvent> &batch)
+{
+    std::ostringstream lines;
+    for (const auto &event : batch)
+    {
+        lines << format_event_time(event.delivered) << "\t" << event.reminder_id << "\t"
+              << deadline_kind_name(event.kind) << "\t" << event.notice << "\t"
+              << event_lateness_ms(event) << "\t" << single_line(event.title) << "\n";
+    }
+
+    std::ofstream file(m_path, std::ios::app);
+    if (!file)
+    {
+        std::cerr << "Failed to open notification log " << m_path << std::endl;
+        return false;
+    }
+
+    file << lines.str();
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+JournalSink::JournalSink() : m_fd(socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0))
+{
+}
+
+JournalSink::~JournalSink()
+{
+    if (m_fd != -1)
+    {
+        ::close(m_fd);
+    }
+}
+
+const char *JournalSink::name() const
+{
+    return "journal";
+}
+
+SinkPolicy JournalSink::policy() const
+{
+    SinkPolicy policy;
+    policy.capacity = 1024;
+    policy.max_batch = 64;
+    policy.max_delay = std::chrono::milliseconds(100);
+    return policy;
+}
+
+// Native journal protocol: KEY=value lines, or KEY, a little-endian 64-bit
+// length and the raw value for values that contain a newline
+static void append_journal_field(std::string &entry, const std::string &key, const std::string &value)
+{
+    if (value.find('\n') == std::string::npos)
+    {
+        entry += key + "=" + value + "\n";
+        return;
+    }
+
+    entry += key + "\n";
+    uint64_t length = value.size();
+    for (int i = 0; i < 8; i++)
+    {
+        entry += static_cast<char>((length >> (8 * i)) & 0xff);
+    }
+    entry += value + "\n";
+}
+
+static int journal_priority(int priority)
+{
+    // syslog levels: warning, notice, info
+    if (priority == PRIORITY_HIGH)
+        return 4;
+    return priority == PRIORITY_LOW ? 6 : 5;
+}
+
+bool JournalSink::deliver(const std::vector<DeliveryEvent> &batch)
+{
+    if (m_fd == -1)
+        return false;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, JOURNAL_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    // One datagram per entry; the journal has no batch form
+    bool ok = true;
+    for (const auto &event : batch)
+    {
+        std::string entry;
+        append_journal_field(entry, "MESSAGE", "Reminder: " + event.title);
+        append_journal_field(entry, "PRIORITY", std::to_string(journal_priority(event.priority)));
+        append_journal_field(entry, "SYSLOG_IDENTIFIER", "reminder");
+        append_journal_field(entry, "REMINDER_ID", std::to_string(event.reminder_id));
+        append_journal_field(entry, "REMINDER_TITLE", event.title);
+        if (!event.description.empty())
+        {
+            append_journal_field(entry, "REMINDER_DESCRIPTION", event.description);
+        }
+        append_journal_field(entry, "REMINDER_TIME", event.time);
+        append_journal_field(entry, "REMINDER_KIND", deadline_kind_name(event.kind));
+        append_journal_field(entry, "REMINDER_NOTICE", std::to_string(event.notice));
+        append_journal_field(entry, "REMINDER_LATENESS_MS", std::to_string(event_lateness_ms(event)));
+
+        if (sendto(m_fd, entry.data(), entry.size(), MSG_NOSIGNAL,
+                   reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1)
+        {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+WebhookSink::WebhookSink(const std::string &url) : m_path("/"),
+                                                   m_valid(false)
+{
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0)
+        return;
+
+    std::string rest = url.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    if (slash != std::string::npos)
+    {
+        m_path = rest.substr(slash);
+    }
+
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos)
+    {
+        m_host = authority.substr(0, colon);
+        m_port = authority.substr(colon + 1);
+    }
+    else
+    {
+        m_host = authority;
+        m_port = "80";
+    }
+
+    // Bracketed IPv6 literal
+    if (m_host.size() > 2 && m_host.front() == '[' && m_host.back() == ']')
+    {
+        m_host = m_host.substr(1, m_host.size() - 2);
+    }
+
+    m_valid = !m_host.empty() && !m_port.empty();
+}
+
+bool WebhookSink::valid() const
+{
+    return m_valid;
+}
+
+const char *WebhookSink::name() const
+{
+    return "webhook";
+}
+
+SinkPolicy WebhookSink::policy() const
+{
+    // A small queue: when the endpoint is down, old events are not worth much
+    SinkPolicy policy;
+    policy.capacity = 256;
+    policy.max_batch = 32;
+    policy.max_delay = std::chrono::milliseconds(1000);
+    policy.overflow = SinkPolicy::DropOldest;
+    return policy;
+}
+
+bool WebhookSink::deliver(const std::vector<DeliveryEvent> &batch)
+{
+    if (!m_valid)
+        return false;
+
+    std::string body = delivery_events_json(batch);
+
+    for (int attempt = 0; attempt < WEBHOOK_ATTEMPTS && !cancelled(); attempt++)
+    {
+        if (attempt > 0)
+        {
+            // 1 s, 2 s, ... between attempts, cut short on shutdown
+            for (int waited = 0; waited < (1 << (attempt - 1)) * 10 && !cancelled(); waited++)
+            {
+                usleep(100 * 1000);
+            }
+        }
+
+        if (post(body))
+            return true;
+    }
+
+    return false;
+}
+
+bool WebhookSink::post(const std::string &body)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *addresses = nullptr;
+    int error = getaddrinfo(m_host.c_str(), m_port.c_str(), &hints, &addresses);
+    if (error != 0)
+    {
+        std::cerr << "Webhook: cannot resolve " << m_host << ": " << gai_strerror(error) << std::endl;
+        return false;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *address = addresses; address; address = address->ai_next)
+    {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd == -1)
+            continue;
+
+        // On Linux the send timeout also bounds connect()
+        struct timeval timeout = {WEBHOOK_TIMEOUT_SECONDS, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+            break;
+
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+
+    if (fd == -1)
+    {
+        std::cerr << "Webhook: cannot connect to " << m_host << ":" << m_port << std::endl;
+        return false;
+    }
+
+    std::string request = "POST " + m_path + " HTTP/1.1\r\n" +
+                          "Host: " + m_host + "\r\n" +
+                          "User-Agent: reminder\r\n" +
+                          "Content-Type: application/json\r\n" +
+                          "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                          "Connection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < request.size())
+    {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            ::close(fd);
+            std::cerr << "Webhook: failed to send to " << m_host << std::endl;
+            return false;
+        }
+        sent += n;
+    }
+
+    // Only the status line matters
+    std::string response;
+    char buffer[512];
+    while (response.find("\r\n") == std::string::npos && response.size() < 4096)
+    {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            break;
+        response.append(buffer, n);
+    }
+    ::close(fd);
+
+    int status = 0;
+    if (sscanf(response.c_str(), "HTTP/%*d.%*d %d", &status) != 1 || status < 200 || status >= 300)
+    {
+        std::cerr << "Webhook: " << m_host << " answered "
+                  << (status ? std::to_string(status) : std::string("nothing")) << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "notification_sink.h"
+#include <string>
+#include <vector>
+
+// Appends one tab-separated line per fired reminder to a file. The file is
+// reopened for every batch so it can be rotated underneath the app.
+class LogFileSink : public NotificationSink
+{
+public:
+    explicit LogFileSink(const std::string &path);
+
+    const char *name() const override;
+    SinkPolicy policy() const override;
+    bool deliver(const std::vector<DeliveryEvent> &batch) override;
+
+private:
+    std::string m_path;
+};
+
+// Writes structured entries to the systemd journal over its native socket,
+// so reminders can be queried with journalctl REMINDER_ID=...
+class JournalSink : public NotificationSink
+{
+public:
+    JournalSink();
+    virtual ~JournalSink();
+
+    const char *name() const override;
+    SinkPolicy policy() const override;
+    bool deliver(const std::vector<DeliveryEvent> &batch) override;
+
+private:
+    int m_fd;
+};
+
+// POSTs each batch as a JSON object to an http:// URL. Failed posts are
+// retried with backoff a few times and then dropped; while it retries, new
+// events wait in the sink's own queue.
+class WebhookSink : public NotificationSink
+{
+public:
+    explicit WebhookSink(const std::string &url);
+
+    // False if the URL is not of the form http://host[:port][/path]
+    bool valid() const;
+
+    const char *name() const override;
+    SinkPolicy policy() const override;
+    bool deliver(const std::vector<DeliveryEvent> &batch) override;
+
+private:
+    std::string m_host;
+    std::string m_port;
+    std::string m_path;
+    bool m_valid;
+
+    bool post(const std::string &body);
+};
+
+// Timestamps and JSON for sink payloads
+std::string format_event_time(Clock::time_point when);
+long long event_lateness_ms(const DeliveryEvent &event);
+std::string delivery_events_json(const std::vector<DeliveryEvent> &batch);
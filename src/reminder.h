@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Priority levels, stored as integers in the database
+enum ReminderPriority
+{
+    PRIORITY_LOW = 0,
+    PRIORITY_NORMAL = 1,
+    PRIORITY_HIGH = 2
+};
+
+struct Reminder
+{
+    int id;
+    std::string title;
+    std::string description;
+    std::string time; // Format: "HH:MM" or "HH:MM:SS"
+    bool completed;
+    bool notified; // Whether notification has been sent for this reminder today
+    int priority = PRIORITY_NORMAL;
+    std::vector<std::string> tags; // Also used as lists
+    int escalate_minutes = 0;      // Re-notify this often until acknowledged, 0 = once
+};
@@ -1,15 +1,122 @@
 #include "reminder_app.h"
 #include "reminder_popup_window.h"
+#include "time_utils.h"
+#include "notification_bridge.h"
+#include "notification_sinks.h"
+#include "delivery_history.h"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <ctime>
+#include <algorithm>
+#include <unordered_set>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <libayatana-appindicator/app-indicator.h>
 
-ReminderApp::ReminderApp(bool start_minimized) : m_main_box(Gtk::ORIENTATION_VERTICAL, 10),
-                                                 m_input_box(Gtk::ORIENTATION_HORIZONTAL, 5),
-                                                 m_thread_running(true),
-                                                 m_start_minimized(start_minimized)
+// Connection-level helpers, shared by the main loop and the open thread
+static int read_data_version(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int version = 0;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA data_version;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            version = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return version;
+}
+
+static sqlite3_int64 read_sync_version(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    sqlite3_int64 version = 0;
+
+    if (sqlite3_prepare_v2(db, "SELECT version FROM sync_state WHERE id = 1;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            version = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return version;
+}
+
+static int read_setting_int(sqlite3 *db, const std::string &key, int default_value)
+{
+    sqlite3_stmt *stmt;
+    int value = default_value;
+
+    if (sqlite3_prepare_v2(db, "SELECT value FROM settings WHERE key = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        {
+            value = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return value;
+}
+
+static std::string read_setting_text(sqlite3 *db, const std::string &key, const std::string &default_value)
+{
+    sqlite3_stmt *stmt;
+    std::string value = default_value;
+
+    if (sqlite3_prepare_v2(db, "SELECT value FROM settings WHERE key = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        {
+            value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return value;
+}
+
+ReminderApp::ReminderApp(bool start_minimized, Clock &clock) : m_main_box(Gtk::ORIENTATION_VERTICAL, 10),
+                                                               m_input_box(Gtk::ORIENTATION_HORIZONTAL, 5),
+                                                               m_edit_dialog("Edit Reminder", m_window, false),
+                                                               m_editing_id(-1),
+                                                               m_bulk_box(Gtk::ORIENTATION_HORIZONTAL, 5),
+                                                               m_bulk_shift_spin(Gtk::Adjustment::create(15, -720, 720, 5, 60)),
+                                                               m_journal(UNDO_DEPTH),
+                                                               m_db(nullptr),
+                                                               m_storage(true, clock),
+                                                               m_data_version(0),
+                                                               m_sync_version(0),
+                                                               m_history_cursor_completed_at(std::numeric_limits<sqlite3_int64>::max()),
+                                                               m_history_cursor_id(std::numeric_limits<int>::max()),
+                                                               m_history_rows(0),
+                                                               m_start_minimized(start_minimized),
+                                                               m_indicator(nullptr),
+                                                               m_tray_empty_item(nullptr),
+                                                               m_tray_update_pending(false),
+                                                               m_clock(clock),
+                                                               m_scheduler(clock),
+                                                               m_started_at(std::chrono::steady_clock::now()),
+                                                               m_maintained(false),
+                                                               m_maintenance_changes(-1),
+                                                               m_maintenance_data_version(-1),
+                                                               m_snapshot_version(-1),
+                                                               m_snapshot_dirty(false),
+                                                               m_main_loop(m_stall_detector.add_loop("main", std::chrono::milliseconds(MAIN_LOOP_BUDGET_MS),
+                                                                                                     std::chrono::milliseconds(HEARTBEAT_MS))),
+                                                               m_scheduler_loop(m_stall_detector.add_loop("scheduler", std::chrono::milliseconds(SCHEDULER_BUDGET_MS)))
 {
     // Initialize libnotify
     notify_init("ReminderApp");
@@ -27,21 +134,33 @@ ReminderApp::ReminderApp(bool start_minimized) : m_main_box(Gtk::ORIENTATION_VER
 
     // Set up the UI components
     setup_ui();
+    setup_edit_dialogs();
 
     // Connect signal handlers
     connect_signals();
 
-    // Initialize database
-    initialize_database();
-
-    // Load existing reminders
-    load_reminders();
+    // Arm the scheduler from the snapshot of the last run, before SQLite
+    // is touched, and start it
+    arm_from_snapshot();
+    start_scheduler();
 
     // Create system tray icon
     create_tray_icon();
 
-    // Start notification thread
-    start_notification_thread();
+    // Periodic online backups of the database
+    Glib::signal_timeout().connect_seconds(sigc::mem_fun(*this, &ReminderApp::on_backup_timer), BACKUP_CHECK_SECONDS);
+
+    // Vacuum, statistics and checkpoints while nobody is using the app
+    Glib::signal_timeout().connect_seconds(sigc::mem_fun(*this, &ReminderApp::on_maintenance_timer), MAINTENANCE_CHECK_SECONDS);
+
+    // Accept commands from scripts and the load generator
+    start_control_channel();
+
+    // Watch both loops and tell systemd we are up
+    start_watchdog();
+
+    // Open, check and load the database off the main loop
+    open_database();
 
     // The window should already be hidden at this point,
     // m_start_minimized is kept for potential future use
@@ -49,12 +168,44 @@ ReminderApp::ReminderApp(bool start_minimized) : m_main_box(Gtk::ORIENTATION_VER
 
 ReminderApp::~ReminderApp()
 {
-    // Stop notification thread
-    m_thread_running = false;
-    if (m_notification_thread.joinable())
+    // Shutdown may take a while; stalls no longer matter
+    sd_notify_state("STOPPING=1");
+    m_stall_detector.stop();
+
+    // A database still opening is waited for, and closed if never handed over
+    if (m_open_thread.joinable())
+    {
+        m_open_thread.join();
+    }
+    if (m_opened.db)
+    {
+        m_storage.close();
+        sqlite3_close(m_opened.db);
+        m_opened.db = nullptr;
+    }
+
+    // Stop the scheduler thread
+    m_scheduler.stop();
+
+    // Leave a current snapshot for the next start
+    m_snapshot_timer.disconnect();
+    write_snapshot();
+
+    // Hand what is queued to the sinks and stop their threads
+    m_sinks.stop();
+
+    // A backup in progress is abandoned; its partial file is removed
+    m_backup.stop();
+
+    // Stop accepting commands
+    m_control.close();
+
+    // Drop notifications that are still on screen
+    for (auto &entry : m_notifications)
     {
-        m_notification_thread.join();
+        g_object_unref(G_OBJECT(entry.second));
     }
+    m_notifications.clear();
 
     // Make sure the popup window is closed
     if (m_popup_window)
@@ -69,6 +220,9 @@ ReminderApp::~ReminderApp()
         m_status_icon.reset();
     }
 
+    // Stop watching the database files
+    m_db_monitors.clear();
+
     // Close database
     if (m_db)
     {
@@ -118,13 +272,18 @@ void ReminderApp::setup_ui()
     m_title_entry.set_activates_default(true);
     title_box->pack_start(m_title_entry, Gtk::PACK_EXPAND_WIDGET);
 
+    // Validation problems are shown here rather than in a dialog
+    m_add_error_label.set_halign(Gtk::ALIGN_START);
+    m_add_error_label.get_style_context()->add_class("error");
+    m_add_error_label.set_no_show_all(true);
+
     // Setup time selector with label
     auto time_label_box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5));
     auto time_label = Gtk::manage(new Gtk::Label("Time:"));
     time_label->set_width_chars(8);
     time_label_box->pack_start(*time_label, Gtk::PACK_SHRINK);
 
-    // Create time box (HH:MM)
+    // Create time box (HH:MM:SS)
     m_time_box.set_orientation(Gtk::ORIENTATION_HORIZONTAL);
     m_time_box.set_spacing(5);
 
@@ -149,13 +308,24 @@ void ReminderApp::setup_ui()
         m_minute_combo.append(ss.str());
     }
 
+    // Populate second combo (00-59); most reminders leave it at 00
+    m_seconds_separator.set_text(":");
+    m_second_combo.set_tooltip_text("Second");
+    for (int i = 0; i < 60; i++)
+    {
+        std::stringstream ss;
+        ss << std::setw(2) << std::setfill('0') << i;
+        m_second_combo.append(ss.str());
+    }
+    m_second_combo.set_active(0);
+
     // Add AM/PM selector
     m_ampm_combo.set_tooltip_text("AM/PM");
     m_ampm_combo.append("AM");
     m_ampm_combo.append("PM");
 
     // Set default time to current system time
-    std::string current_time = get_current_time();
+    std::string current_time = current_time_string(m_clock);
     int hour24 = std::stoi(current_time.substr(0, 2));
     std::string minute_str = current_time.substr(3, 2);
 
@@ -189,16 +359,19 @@ void ReminderApp::setup_ui()
     // Set specific width for better UX
     m_hour_combo.property_width_request() = 60;
     m_minute_combo.property_width_request() = 60;
+    m_second_combo.property_width_request() = 60;
     m_ampm_combo.property_width_request() = 60;
 
     // Add widgets to time box with smaller spacing
     m_time_box.pack_start(m_hour_combo, Gtk::PACK_SHRINK);
     m_time_box.pack_start(m_time_separator, Gtk::PACK_SHRINK);
     m_time_box.pack_start(m_minute_combo, Gtk::PACK_SHRINK);
+    m_time_box.pack_start(m_seconds_separator, Gtk::PACK_SHRINK);
+    m_time_box.pack_start(m_second_combo, Gtk::PACK_SHRINK);
     m_time_box.pack_start(m_ampm_combo, Gtk::PACK_SHRINK);
 
     // Set fixed width for the time box to prevent it from extending too far
-    m_time_box.property_width_request() = 200;
+    m_time_box.property_width_request() = 270;
     m_time_box.set_halign(Gtk::ALIGN_START);
 
     time_label_box->pack_start(m_time_box, Gtk::PACK_SHRINK);
@@ -213,6 +386,33 @@ void ReminderApp::setup_ui()
     desc_scroll->set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
     desc_scroll->set_shadow_type(Gtk::SHADOW_IN);
 
+    // Priority selector
+    auto priority_box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5));
+    auto priority_label = Gtk::manage(new Gtk::Label("Priority:"));
+    priority_label->set_width_chars(8);
+    priority_box->pack_start(*priority_label, Gtk::PACK_SHRINK);
+
+    m_priority_combo.append("Low");
+    m_priority_combo.append("Normal");
+    m_priority_combo.append("High");
+    m_priority_combo.set_active(PRIORITY_NORMAL);
+    priority_box->pack_start(m_priority_combo, Gtk::PACK_SHRINK);
+
+    // Escalation policy, next to the priority it usually goes with
+    ReminderEditor::fill_escalation_combo(m_escalation_combo, 0);
+    m_escalation_combo.set_tooltip_text("Notify again until the reminder is done or snoozed");
+    priority_box->pack_start(m_escalation_combo, Gtk::PACK_SHRINK);
+
+    // Tags entry
+    auto tags_box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5));
+    auto tags_label = Gtk::manage(new Gtk::Label("Tags:"));
+    tags_label->set_width_chars(8);
+    tags_box->pack_start(*tags_label, Gtk::PACK_SHRINK);
+
+    m_tags_entry.set_placeholder_text("Comma separated, e.g. work, home");
+    m_tags_entry.set_activates_default(true);
+    tags_box->pack_start(m_tags_entry, Gtk::PACK_EXPAND_WIDGET);
+
     // Setup add button
     m_add_button.set_label("Add Reminder");
     m_add_button.set_size_request(120, -1);
@@ -222,7 +422,10 @@ void ReminderApp::setup_ui()
 
     // Add all elements to the input frame box
     input_frame_box->pack_start(*title_box, Gtk::PACK_SHRINK);
+    input_frame_box->pack_start(m_add_error_label, Gtk::PACK_SHRINK);
     input_frame_box->pack_start(*time_label_box, Gtk::PACK_SHRINK);
+    input_frame_box->pack_start(*priority_box, Gtk::PACK_SHRINK);
+    input_frame_box->pack_start(*tags_box, Gtk::PACK_SHRINK);
     input_frame_box->pack_start(*desc_label, Gtk::PACK_SHRINK);
     input_frame_box->pack_start(*desc_scroll, Gtk::PACK_EXPAND_WIDGET);
     input_frame_box->pack_start(m_add_button, Gtk::PACK_SHRINK);
@@ -242,8 +445,45 @@ void ReminderApp::setup_ui()
     reminders_label->set_halign(Gtk::ALIGN_START);
     m_main_box.pack_start(*reminders_label, Gtk::PACK_SHRINK);
 
-    // Setup list with scrolling
-    m_list_box.set_selection_mode(Gtk::SELECTION_SINGLE);
+    // Filter bar
+    m_filter_box.set_orientation(Gtk::ORIENTATION_HORIZONTAL);
+    m_filter_box.set_spacing(5);
+
+    m_filter_combo.append("All reminders");
+    m_filter_combo.append("Active");
+    m_filter_combo.append("Due today");
+    m_filter_combo.append("Due today, high priority");
+    m_filter_combo.set_active(0);
+
+    m_tag_filter_combo.append("All tags");
+    m_tag_filter_combo.set_active(0);
+
+    m_filter_box.pack_start(m_filter_combo, Gtk::PACK_SHRINK);
+    m_filter_box.pack_start(m_tag_filter_combo, Gtk::PACK_SHRINK);
+    m_undo_button.set_label("Undo");
+    m_redo_button.set_label("Redo");
+    m_filter_box.pack_end(m_redo_button, Gtk::PACK_SHRINK);
+    m_filter_box.pack_end(m_undo_button, Gtk::PACK_SHRINK);
+    m_main_box.pack_start(m_filter_box, Gtk::PACK_SHRINK);
+
+    // Offers to take back a delete; shown only after one
+    m_undo_bar.set_message_type(Gtk::MESSAGE_INFO);
+    m_undo_bar.add_button("Undo", Gtk::RESPONSE_REJECT);
+    m_undo_bar.set_show_close_button(true);
+    m_undo_label.set_halign(Gtk::ALIGN_START);
+    m_undo_label.show();
+    m_undo_bar.get_content_area()->add(m_undo_label);
+    m_undo_bar.set_no_show_all(true);
+    m_main_box.pack_start(m_undo_bar, Gtk::PACK_SHRINK);
+
+    // Setup list with scrolling. Ctrl and Shift extend the selection for
+    // the bulk actions below the list.
+    m_list_box.set_selection_mode(Gtk::SELECTION_MULTIPLE);
+    m_list_box.set_sort_func([](Gtk::ListBoxRow *a, Gtk::ListBoxRow *b)
+                             {
+        int id_a = GPOINTER_TO_INT(a->get_data("reminder_id"));
+        int id_b = GPOINTER_TO_INT(b->get_data("reminder_id"));
+        return (id_a > id_b) - (id_a < id_b); });
     m_scrolled_window.add(m_list_box);
     m_scrolled_window.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
     m_scrolled_window.set_min_content_height(200);
@@ -252,6 +492,42 @@ void ReminderApp::setup_ui()
     // Add list to main box
     m_main_box.pack_start(m_scrolled_window, Gtk::PACK_EXPAND_WIDGET);
 
+    // Bulk actions, enabled while rows are selected
+    m_bulk_complete_button.set_label("Complete");
+    m_bulk_uncomplete_button.set_label("Uncomplete");
+    m_bulk_shift_spin.set_tooltip_text("Minutes to move the selected reminders by");
+    m_bulk_shift_button.set_label("Shift");
+    m_bulk_time_entry.set_placeholder_text("HH:MM");
+    m_bulk_time_entry.set_width_chars(6);
+    m_bulk_time_button.set_label("Set time");
+    m_bulk_delete_button.set_label("Delete");
+    m_bulk_box.pack_start(m_selection_label, Gtk::PACK_SHRINK);
+    m_bulk_box.pack_start(m_bulk_complete_button, Gtk::PACK_SHRINK);
+    m_bulk_box.pack_start(m_bulk_uncomplete_button, Gtk::PACK_SHRINK);
+    m_bulk_box.pack_start(m_bulk_shift_spin, Gtk::PACK_SHRINK);
+    m_bulk_box.pack_start(m_bulk_shift_button, Gtk::PACK_SHRINK);
+    m_bulk_box.pack_start(m_bulk_time_entry, Gtk::PACK_SHRINK);
+    m_bulk_box.pack_start(m_bulk_time_button, Gtk::PACK_SHRINK);
+    m_bulk_box.pack_end(m_bulk_delete_button, Gtk::PACK_SHRINK);
+    m_main_box.pack_start(m_bulk_box, Gtk::PACK_SHRINK);
+    on_selection_changed();
+    update_undo_controls();
+
+    // Archived reminders, paged in on demand
+    auto history_box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL, 5));
+    m_history_list.set_selection_mode(Gtk::SELECTION_NONE);
+    m_history_scroll.add(m_history_list);
+    m_history_scroll.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    m_history_scroll.set_min_content_height(120);
+    m_history_scroll.set_shadow_type(Gtk::SHADOW_IN);
+    m_history_more_button.set_label("Load more");
+    m_history_more_button.set_halign(Gtk::ALIGN_CENTER);
+    history_box->pack_start(m_history_scroll, Gtk::PACK_EXPAND_WIDGET);
+    history_box->pack_start(m_history_more_button, Gtk::PACK_SHRINK);
+    m_history_expander.set_label("History");
+    m_history_expander.add(*history_box);
+    m_main_box.pack_start(m_history_expander, Gtk::PACK_SHRINK);
+
     // Show all widgets
     m_window.show_all_children();
 }
@@ -261,6 +537,48 @@ void ReminderApp::connect_signals()
     m_add_button.signal_clicked().connect(
         sigc::mem_fun(*this, &ReminderApp::on_add_button_clicked));
 
+    // Typing a title clears a validation error shown for it
+    m_title_entry.signal_changed().connect(sigc::mem_fun(*this, &ReminderApp::clear_add_error));
+
+    // History is loaded lazily, a page at a time
+    m_history_expander.property_expanded().signal_changed().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_history_expanded));
+    m_history_more_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ReminderApp::load_history_page));
+
+    // Filter changes only add and remove rows
+    m_filter_combo.signal_changed().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_filter_changed));
+    m_tag_filter_combo.signal_changed().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_filter_changed));
+
+    // Bulk actions on the selected rows
+    m_list_box.signal_selected_rows_changed().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_selection_changed));
+    m_bulk_complete_button.signal_clicked().connect(
+        sigc::bind(sigc::mem_fun(*this, &ReminderApp::on_bulk_set_completed), true));
+    m_bulk_uncomplete_button.signal_clicked().connect(
+        sigc::bind(sigc::mem_fun(*this, &ReminderApp::on_bulk_set_completed), false));
+    m_bulk_shift_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_bulk_shift));
+    m_bulk_time_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_bulk_reschedule));
+    m_bulk_time_entry.signal_activate().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_bulk_reschedule));
+    m_bulk_delete_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_bulk_delete));
+
+    // Undo and redo; the key handler runs before the focused widget's
+    m_undo_button.signal_clicked().connect(sigc::mem_fun(*this, &ReminderApp::undo));
+    m_redo_button.signal_clicked().connect(sigc::mem_fun(*this, &ReminderApp::redo));
+    m_undo_bar.signal_response().connect([this](int response)
+                                         {
+        hide_undo_bar();
+        if (response == Gtk::RESPONSE_REJECT)
+            undo(); });
+    m_window.signal_key_press_event().connect(
+        sigc::mem_fun(*this, &ReminderApp::on_window_key_press), false);
+
     // Connect window hide signal to minimize to tray instead of closing
     m_window.signal_delete_event().connect(
         sigc::mem_fun(*this, &ReminderApp::on_window_delete_event));
@@ -268,330 +586,887 @@ void ReminderApp::connect_signals()
     // Connect popup window reminder toggle signal
     if (m_popup_window)
     {
+        m_popup_window->set_scheduler(&m_scheduler);
+        m_popup_window->set_store(&m_store);
         m_popup_window->signal_reminder_toggled().connect(
             sigc::mem_fun(*this, &ReminderApp::on_popup_reminder_toggled));
+        watch_frames(m_popup_window->get_window());
     }
+    watch_frames(m_window);
+    watch_frames(m_edit_dialog);
 }
 
-void ReminderApp::initialize_database()
+// Runs on the open thread: everything here works on its own connection
+sqlite3 *ReminderApp::prepare_database()
 {
-    // Open database
-    std::string db_path = std::string(getenv("HOME")) + "/.local/share/reminders.db";
-    int rc = sqlite3_open(db_path.c_str(), &m_db);
+    sqlite3 *db = nullptr;
+    int rc = sqlite3_open(m_db_path.c_str(), &db);
 
     if (rc)
     {
-        std::cerr << "Can't open database: " << sqlite3_errmsg(m_db) << std::endl;
-        sqlite3_close(m_db);
-        m_db = nullptr;
-        return;
+        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
     }
 
-    // Create table if it doesn't exist
-    const char *create_table_sql =
-        "CREATE TABLE IF NOT EXISTS reminders("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "title TEXT NOT NULL,"
-        "description TEXT,"
-        "time TEXT NOT NULL,"
-        "completed INTEGER DEFAULT 0,"
-        "notified INTEGER DEFAULT 0);";
+    // New databases give freed pages back in small steps during idle
+    // maintenance. This only takes effect before WAL mode writes the header.
+    sqlite3_exec(db, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
 
+    // WAL lets other processes read and write while we hold the database open
     char *err_msg = nullptr;
-    rc = sqlite3_exec(m_db, create_table_sql, nullptr, nullptr, &err_msg);
+    rc = sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, &err_msg);
 
     if (rc != SQLITE_OK)
     {
-        std::cerr << "SQL error: " << err_msg << std::endl;
+        std::cerr << "SQL error when enabling WAL: " << err_msg << std::endl;
         sqlite3_free(err_msg);
+        err_msg = nullptr;
     }
 
-    // Check if the notified column exists - add it for existing databases
-    sqlite3_stmt *stmt;
-    rc = sqlite3_prepare_v2(m_db, "PRAGMA table_info(reminders);", -1, &stmt, nullptr);
+    // The delivery history sink and reminderd write through their own connections
+    sqlite3_busy_timeout(db, 2000);
+
+    // Reminders and tags; the rest of the schema is the app's own
+    m_storage.attach(db);
+
+    // Change tracking: every write to the reminders table stamps the row with
+    // a new version from sync_state, and deletes leave a tombstone behind, so
+    // writes made by other processes can be picked up incrementally
+    const char *sync_schema_sql =
+        "CREATE TABLE IF NOT EXISTS sync_state("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "version INTEGER NOT NULL);"
+        "INSERT OR IGNORE INTO sync_state (id, version) VALUES (1, 0);"
+        "CREATE TABLE IF NOT EXISTS reminder_tombstones("
+        "id INTEGER PRIMARY KEY,"
+        "row_version INTEGER NOT NULL);"
+        "CREATE INDEX IF NOT EXISTS idx_reminders_row_version ON reminders(row_version);"
+        "CREATE INDEX IF NOT EXISTS idx_tombstones_row_version ON reminder_tombstones(row_version);"
+        "CREATE TRIGGER IF NOT EXISTS reminders_version_insert AFTER INSERT ON reminders "
+        "BEGIN "
+        "UPDATE sync_state SET version = version + 1 WHERE id = 1;"
+        "UPDATE reminders SET row_version = (SELECT version FROM sync_state WHERE id = 1) WHERE id = NEW.id;"
+        "DELETE FROM reminder_tombstones WHERE id = NEW.id;"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS reminders_version_update AFTER UPDATE ON reminders "
+        "WHEN NEW.row_version IS OLD.row_version "
+        "BEGIN "
+        "UPDATE sync_state SET version = version + 1 WHERE id = 1;"
+        "UPDATE reminders SET row_version = (SELECT version FROM sync_state WHERE id = 1) WHERE id = NEW.id;"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS reminders_version_delete AFTER DELETE ON reminders "
+        "BEGIN "
+        "UPDATE sync_state SET version = version + 1 WHERE id = 1;"
+        "INSERT OR REPLACE INTO reminder_tombstones (id, row_version) "
+        "VALUES (OLD.id, (SELECT version FROM sync_state WHERE id = 1));"
+        "END;";
+
+    rc = sqlite3_exec(db, sync_schema_sql, nullptr, nullptr, &err_msg);
 
-    if (rc == SQLITE_OK)
+    if (rc != SQLITE_OK)
     {
-        bool has_notified_column = false;
+        std::cerr << "SQL error when creating change tracking schema: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+    }
 
-        while (sqlite3_step(stmt) == SQLITE_ROW)
-        {
-            std::string column_name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-            if (column_name == "notified")
-            {
-                has_notified_column = true;
-                break;
-            }
-        }
+    // Completed reminders move to the archive after a while, so the hot table
+    // only holds what the app has to show and schedule
+    const char *archive_schema_sql =
+        "CREATE TABLE IF NOT EXISTS settings("
+        "key TEXT PRIMARY KEY,"
+        "value TEXT);"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('archive_after_days', '1');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('archive_retention_days', '365');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('history_retention_days', '90');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('backup_interval_hours', '24');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('backup_keep', '7');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('backup_dir', '');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('notify_log_file', '');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('notify_journal', '0');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('notify_webhook_url', '');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('maintenance_interval_hours', '24');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('maintenance_on_battery', '0');"
+        "INSERT OR IGNORE INTO settings (key, value) VALUES ('ics_subscriptions', '');"
+        "CREATE TABLE IF NOT EXISTS reminders_archive("
+        "id INTEGER PRIMARY KEY,"
+        "title TEXT NOT NULL,"
+        "description TEXT,"
+        "time TEXT NOT NULL,"
+        "priority INTEGER DEFAULT 1,"
+        "tags TEXT,"
+        "completed_at INTEGER NOT NULL,"
+        "archived_at INTEGER NOT NULL);"
+        "CREATE INDEX IF NOT EXISTS idx_archive_completed_at ON reminders_archive(completed_at, id);"
+        "CREATE INDEX IF NOT EXISTS idx_reminders_completed_at ON reminders(completed, completed_at);"
+        // SqliteStorage stamps completed_at from the app's clock; this only
+        // covers writers that change completed without it, on the wall clock
+        "DROP TRIGGER IF EXISTS reminders_completed_at;"
+        "CREATE TRIGGER IF NOT EXISTS reminders_completed_default AFTER UPDATE OF completed ON reminders "
+        "WHEN NEW.completed IS NOT OLD.completed AND NEW.completed_at IS OLD.completed_at "
+        "BEGIN "
+        "UPDATE reminders SET completed_at = CASE WHEN NEW.completed THEN strftime('%s', 'now') END "
+        "WHERE id = NEW.id;"
+        "END;";
+
+    rc = sqlite3_exec(db, archive_schema_sql, nullptr, nullptr, &err_msg);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "SQL error when creating archive schema: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+    }
 
+    // Rows completed before completed_at existed count from now
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "UPDATE reminders SET completed_at = ? WHERE completed = 1 AND completed_at IS NULL;",
+                           -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_int64(stmt, 1, std::chrono::duration_cast<std::chrono::seconds>(m_clock.now().time_since_epoch()).count());
+        sqlite3_step(stmt);
         sqlite3_finalize(stmt);
+    }
 
-        // Add the column if it doesn't exist
-        if (!has_notified_column)
-        {
-            std::cout << "Adding 'notified' column to existing database..." << std::endl;
-            const char *alter_table_sql = "ALTER TABLE reminders ADD COLUMN notified INTEGER DEFAULT 0;";
-            rc = sqlite3_exec(m_db, alter_table_sql, nullptr, nullptr, &err_msg);
+    // Record of every notification shown, for lateness and completion queries
+    create_delivery_history_schema(db);
 
-            if (rc != SQLITE_OK)
-            {
-                std::cerr << "SQL error when adding notified column: " << err_msg << std::endl;
-                sqlite3_free(err_msg);
-            }
+    return db;
+}
+
+void ReminderApp::watch_database_files(const std::string &db_path)
+{
+    m_data_version = query_data_version();
+
+    // GIO uses inotify underneath; the events only tell us that something
+    // touched the files, PRAGMA data_version tells us whether it was another
+    // connection committing a change
+    for (const auto &path : {db_path, db_path + "-wal"})
+    {
+        try
+        {
+            auto monitor = Gio::File::create_for_path(path)->monitor_file();
+            monitor->signal_changed().connect(
+                sigc::mem_fun(*this, &ReminderApp::on_database_file_changed));
+            m_db_monitors.push_back(monitor);
+        }
+        catch (const Glib::Error &e)
+        {
+            std::cerr << "Failed to watch " << path << ": " << e.what() << std::endl;
         }
     }
+}
 
-    // Initialize current date
-    m_current_date = get_current_date();
+void ReminderApp::on_database_file_changed(const Glib::RefPtr<Gio::File> &,
+                                           const Glib::RefPtr<Gio::File> &,
+                                           Gio::FileMonitorEvent event_type)
+{
+    if (event_type == Gio::FILE_MONITOR_EVENT_CHANGED ||
+        event_type == Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT ||
+        event_type == Gio::FILE_MONITOR_EVENT_CREATED)
+    {
+        check_external_changes();
+    }
+}
 
-    // Reset notification status for a new day
-    reset_notification_status();
+// The subscriptions were attached and read by the open thread
+void ReminderApp::start_subscriptions()
+{
+    // A directory monitor reports the .ics files added to it too
+    for (const auto &path : m_subscription_paths)
+    {
+        try
+        {
+            auto file = Gio::File::create_for_path(path);
+            auto monitor = file->query_file_type() == Gio::FILE_TYPE_DIRECTORY ? file->monitor_directory()
+                                                                                : file->monitor_file();
+            monitor->signal_changed().connect(
+                sigc::mem_fun(*this, &ReminderApp::on_subscription_changed));
+            m_subscription_monitors.push_back(monitor);
+        }
+        catch (const Glib::Error &e)
+        {
+            std::cerr << "Failed to watch " << path << ": " << e.what() << std::endl;
+        }
+    }
 }
 
-void ReminderApp::load_reminders()
+void ReminderApp::sync_subscriptions()
 {
     if (!m_db)
         return;
 
-    // Clear existing reminders
-    m_reminders.clear();
+    StallScope scope(m_stall_detector, m_main_loop, "sync_subscriptions");
+    FeedChanges changes;
+    sync_subscription_files([this](int id)
+                            { return find_reminder(id); },
+                            changes);
+    apply_feed_changes(changes);
+}
 
-    // Prepare SQL statement to get reminders for today
-    const char *sql = "SELECT id, title, description, time, completed, notified FROM reminders;";
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+void ReminderApp::sync_subscription_files(const std::function<const Reminder *(int)> &current, FeedChanges &changes)
+{
+    // Unchanged files are skipped on their size and modification time
+    std::vector<std::string> files = IcsSubscriptions::expand(m_subscription_paths);
+    for (const auto &file : files)
+    {
+        m_subscriptions.sync_file(file, m_clock, current, changes);
+    }
 
-    if (rc != SQLITE_OK)
+    // Files deleted or unsubscribed while the app wasn't watching
+    for (const auto &known : m_subscriptions.known_files())
     {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
-        return;
+        if (std::find(files.begin(), files.end(), known) == files.end())
+            m_subscriptions.drop_file(known, current, changes);
     }
+}
 
-    // Execute query and retrieve results
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+void ReminderApp::on_subscription_changed(const Glib::RefPtr<Gio::File> &file,
+                                          const Glib::RefPtr<Gio::File> &other_file,
+                                          Gio::FileMonitorEvent)
+{
+    // Renames report both names; other files in a watched directory are
+    // none of our business
+    for (const auto &changed : {file, other_file})
     {
-        Reminder reminder;
-        reminder.id = sqlite3_column_int(stmt, 0);
-        reminder.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        if (!changed)
+            continue;
 
-        const unsigned char *description = sqlite3_column_text(stmt, 2);
-        if (description)
+        std::string path = changed->get_path();
+        if (IcsSubscriptions::is_feed_file(path) ||
+            std::find(m_subscription_paths.begin(), m_subscription_paths.end(), path) != m_subscription_paths.end())
         {
-            reminder.description = reinterpret_cast<const char *>(description);
+            m_changed_feeds.insert(path);
         }
-
-        reminder.time = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
-        reminder.completed = sqlite3_column_int(stmt, 4) != 0;
-        reminder.notified = sqlite3_column_int(stmt, 5) != 0;
-
-        m_reminders.push_back(reminder);
     }
 
-    sqlite3_finalize(stmt);
+    if (m_changed_feeds.empty())
+        return;
 
-    // Refresh the list view
-    refresh_list();
+    m_feed_timer.disconnect();
+    m_feed_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &ReminderApp::on_feed_timer), FEED_SETTLE_MS);
 }
 
-void ReminderApp::on_add_button_clicked()
+bool ReminderApp::on_feed_timer()
 {
-    Reminder reminder;
-    reminder.title = m_title_entry.get_text();
-
-    // Get time from combo boxes
-    Glib::ustring hourStr = m_hour_combo.get_active_text();
-    Glib::ustring minute = m_minute_combo.get_active_text();
-    Glib::ustring ampm = m_ampm_combo.get_active_text();
+    StallScope scope(m_stall_detector, m_main_loop, "on_feed_timer");
+    auto current = [this](int id)
+    { return find_reminder(id); };
 
-    // Convert 12-hour format to 24-hour format for storage
-    int hour = std::stoi(hourStr);
-    if (ampm == "PM" && hour != 12)
+    // Only the files that changed are read; one that is gone is dropped
+    FeedChanges changes;
+    for (const auto &path : m_changed_feeds)
     {
-        hour += 12;
+        m_subscriptions.sync_file(path, m_clock, current, changes);
     }
-    else if (ampm == "AM" && hour == 12)
+    m_changed_feeds.clear();
+
+    apply_feed_changes(changes);
+    return false;
+}
+
+void ReminderApp::apply_feed_changes(const FeedChanges &changes)
+{
+    if (!changes.changed.empty() || !changes.removed.empty())
     {
-        hour = 0;
+        skip_own_changes();
     }
 
-    // Format the time string in 24-hour format (HH:MM)
-    std::stringstream timeStream;
-    timeStream << std::setw(2) << std::setfill('0') << hour << ":" << minute;
-    reminder.time = timeStream.str();
-    auto buffer = m_description_textview.get_buffer();
-    reminder.description = buffer->get_text();
-    reminder.completed = false;
-    reminder.notified = false;
+    // Not journaled: undo is for the user's own edits
+    for (const auto &reminder : changes.changed)
+    {
+        apply_reminder_change(reminder);
+    }
+    for (int id : changes.removed)
+    {
+        apply_reminder_removal(id);
+    }
 
-    // Validate input
-    if (reminder.title.empty())
+    if (!changes.changed.empty() || !changes.removed.empty())
     {
-        auto dialog = Gtk::MessageDialog(m_window, "Error", false, Gtk::MESSAGE_ERROR);
-        dialog.set_secondary_text("Title cannot be empty!");
-        dialog.run();
-        return;
+        std::cout << "Calendar subscriptions: " << changes.changed.size() << " reminders added or updated, "
+                  << changes.removed.size() << " removed." << std::endl;
     }
+}
 
-    // We don't need to validate time format since it's from combo boxes
+int ReminderApp::query_data_version()
+{
+    return m_db ? read_data_version(m_db) : 0;
+}
 
-    // Add reminder to database
-    add_reminder(reminder);
+void ReminderApp::check_external_changes()
+{
+    // data_version only moves when another connection commits, so our own
+    // writes never cause a resync
+    int data_version = query_data_version();
+    if (data_version == m_data_version)
+        return;
 
-    // Clear input fields
-    m_title_entry.set_text("");
-    buffer->set_text("");
-    // Leave time at current selection
+    m_data_version = data_version;
+    sync_external_changes();
 }
 
-void ReminderApp::add_reminder(const Reminder &reminder)
+void ReminderApp::sync_external_changes()
 {
     if (!m_db)
         return;
 
-    const char *sql = "INSERT INTO reminders (title, description, time, completed, notified) "
-                      "VALUES (?, ?, ?, ?, ?);";
+    StallScope scope(m_stall_detector, m_main_loop, "sync_external_changes");
+
+    // Read both tables from one snapshot
+    sqlite3_exec(m_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+    sqlite3_int64 max_version = m_sync_version;
 
+    const char *changed_sql = "SELECT id, title, description, time, completed, notified, priority, escalate_minutes, row_version "
+                              "FROM reminders WHERE row_version > ?;";
     sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = sqlite3_prepare_v2(m_db, changed_sql, -1, &stmt, nullptr);
 
-    if (rc != SQLITE_OK)
+    if (rc == SQLITE_OK)
     {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
-        return;
-    }
-
-    sqlite3_bind_text(stmt, 1, reminder.title.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, reminder.description.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, reminder.time.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 4, reminder.completed ? 1 : 0);
-    sqlite3_bind_int(stmt, 5, reminder.notified ? 1 : 0);
+        sqlite3_bind_int64(stmt, 1, m_sync_version);
 
-    rc = sqlite3_step(stmt);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            Reminder reminder = SqliteStorage::read_row(stmt);
+            m_storage.load_tags(reminder);
+            apply_reminder_change(reminder);
+            max_version = std::max(max_version, sqlite3_column_int64(stmt, 8));
+        }
 
-    if (rc != SQLITE_DONE)
+        sqlite3_finalize(stmt);
+    }
+    else
     {
-        std::cerr << "Failed to execute statement: " << sqlite3_errmsg(m_db) << std::endl;
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
     }
 
-    sqlite3_finalize(stmt);
-
-    // Reload reminders
-    load_reminders();
-}
-
-void ReminderApp::update_reminder(const Reminder &reminder)
-{
-    if (!m_db)
-        return;
+    const char *deleted_sql = "SELECT id, row_version FROM reminder_tombstones WHERE row_version > ?;";
+    rc = sqlite3_prepare_v2(m_db, deleted_sql, -1, &stmt, nullptr);
 
-    const char *sql = "UPDATE reminders SET title = ?, description = ?, "
-                      "time = ?, completed = ?, notified = ? WHERE id = ?;";
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_int64(stmt, 1, m_sync_version);
 
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            apply_reminder_removal(sqlite3_column_int(stmt, 0));
+            max_version = std::max(max_version, sqlite3_column_int64(stmt, 1));
+        }
 
-    if (rc != SQLITE_OK)
+        sqlite3_finalize(stmt);
+    }
+    else
     {
         std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
-        return;
     }
 
-    sqlite3_bind_text(stmt, 1, reminder.title.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, reminder.description.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, reminder.time.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 4, reminder.completed ? 1 : 0);
-    sqlite3_bind_int(stmt, 5, reminder.notified ? 1 : 0);
-    sqlite3_bind_int(stmt, 6, reminder.id);
+    sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
 
-    rc = sqlite3_step(stmt);
+    m_sync_version = max_version;
+}
 
-    if (rc != SQLITE_DONE)
+// Our own commits leave data_version alone, so the row versions they
+// stamped would otherwise be read back by the next external sync. Moving
+// past them is only safe while no other connection has committed since the
+// last sync; if one has, the next sync reads both.
+void ReminderApp::skip_own_changes()
+{
+    if (query_data_version() == m_data_version)
     {
-        std::cerr << "Failed to execute statement: " << sqlite3_errmsg(m_db) << std::endl;
+        m_sync_version = query_sync_version();
     }
+}
 
-    sqlite3_finalize(stmt);
-
-    // Reload reminders
-    load_reminders();
+sqlite3_int64 ReminderApp::query_sync_version()
+{
+    return read_sync_version(m_db);
 }
 
-void ReminderApp::delete_reminder(int id)
+void ReminderApp::load_reminders()
 {
     if (!m_db)
         return;
 
-    const char *sql = "DELETE FROM reminders WHERE id = ?;";
-
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
-
-    if (rc != SQLITE_OK)
+    ReminderStore store;
+    sqlite3_int64 sync_version;
+    if (read_reminders(m_db, store, sync_version))
     {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
-        return;
+        install_reminders(std::move(store), sync_version);
     }
+}
 
-    sqlite3_bind_int(stmt, 1, id);
+// Safe on the open thread: touches nothing but the connection and the store
+bool ReminderApp::read_reminders(sqlite3 *db, ReminderStore &store, sqlite3_int64 &sync_version)
+{
+    // Read the rows and the matching change version from one snapshot
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
 
-    rc = sqlite3_step(stmt);
+    std::vector<Reminder> loaded;
+    bool ok = m_storage.load_all(loaded);
+    sync_version = read_sync_version(db);
 
-    if (rc != SQLITE_DONE)
-    {
-        std::cerr << "Failed to execute statement: " << sqlite3_errmsg(m_db) << std::endl;
-    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
 
-    sqlite3_finalize(stmt);
+    if (!ok)
+        return false;
 
-    // Reload reminders
-    load_reminders();
+    store.clear();
+    for (const auto &reminder : loaded)
+    {
+        store.upsert(reminder);
+    }
+    return true;
 }
 
-void ReminderApp::refresh_list()
+void ReminderApp::install_reminders(ReminderStore store, sqlite3_int64 sync_version)
 {
-    // Remove all children
-    auto children = m_list_box.get_children();
-    for (auto child : children)
+    // Forget the daily deadlines of the reminders being replaced; pending
+    // snoozes survive and are dropped when they fire for a missing reminder
+    for (const auto &entry : m_store.all())
     {
-        m_list_box.remove(*child);
-        delete child;
+        m_scheduler.cancel(entry.first, DeadlineKind::Primary);
     }
 
-    // Add reminders to list
-    for (const auto &reminder : m_reminders)
+    m_store = std::move(store);
+    m_sync_version = sync_version;
+
+    // The database has the final say over what the snapshot armed
+    m_scheduler.drop_preloaded();
+    for (const auto &entry : m_store.all())
     {
-        m_list_box.add(*create_reminder_widget(reminder));
+        arm_reminder(entry.second);
     }
+    schedule_snapshot();
 
-    m_list_box.show_all();
-
-    // Also update the popup window if it exists
+    // Rebuild both views from the fresh data
+    clear_rows();
     if (m_popup_window)
     {
-        m_popup_window->set_reminders(m_reminders);
+        m_popup_window->set_store(&m_store);
     }
+    update_tag_filter_options();
+    refresh_list();
+    schedule_tray_update();
 }
 
-Gtk::Widget *ReminderApp::create_reminder_widget(const Reminder &reminder)
+void ReminderApp::on_add_button_clicked()
 {
-    // Create a box to hold the reminder
-    auto box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5));
-    box->set_border_width(5);
+    Reminder reminder;
+    reminder.title = m_title_entry.get_text();
 
-    // Create checkbox for completion status
-    auto check = Gtk::manage(new Gtk::CheckButton());
+    // Get time from combo boxes
+    Glib::ustring hourStr = m_hour_combo.get_active_text();
+    Glib::ustring minute = m_minute_combo.get_active_text();
+    Glib::ustring second = m_second_combo.get_active_text();
+    Glib::ustring ampm = m_ampm_combo.get_active_text();
+
+    // Convert 12-hour format to 24-hour format for storage
+    int hour = std::stoi(hourStr);
+    if (ampm == "PM" && hour != 12)
+    {
+        hour += 12;
+    }
+    else if (ampm == "AM" && hour == 12)
+    {
+        hour = 0;
+    }
+
+    // Format the time string in 24-hour format (HH:MM, or HH:MM:SS)
+    reminder.time = format_reminder_time(hour, std::stoi(minute), std::stoi(second));
+    auto buffer = m_description_textview.get_buffer();
+    reminder.description = buffer->get_text();
+    reminder.completed = false;
+    reminder.notified = false;
+    reminder.priority = m_priority_combo.get_active_row_number();
+    reminder.escalate_minutes = ReminderEditor::escalation_minutes_of(m_escalation_combo);
+    reminder.tags = ReminderEditor::parse_tags(m_tags_entry.get_text());
+
+    // Validate input
+    if (reminder.title.find_first_not_of(" \t") == std::string::npos)
+    {
+        show_add_error("Title cannot be empty.");
+        m_title_entry.grab_focus();
+        return;
+    }
+
+    // We don't need to validate time format since it's from combo boxes
+
+    // Add reminder to database
+    if (add_reminder(reminder) == -1)
+    {
+        show_add_error("The reminder could not be saved.");
+        return;
+    }
+    clear_add_error();
+
+    // Clear input fields
+    m_title_entry.set_text("");
+    buffer->set_text("");
+    m_tags_entry.set_text("");
+    // Leave time at current selection
+}
+
+int ReminderApp::add_reminder(const Reminder &reminder)
+{
+    if (!m_db)
+        return -1;
+
+    Reminder added = reminder;
+    added.id = m_storage.insert(reminder);
+    if (added.id == -1)
+        return -1;
+    skip_own_changes();
+
+    // Show the new row without reloading the table
+    apply_reminder_change(added);
+
+    JournalEntry entry;
+    entry.deltas.push_back(ReminderDelta{added.id, false, true, Reminder{}, added});
+    record_change(std::move(entry));
+    return added.id;
+}
+
+void ReminderApp::update_reminder(const Reminder &reminder)
+{
+    update_reminders({reminder});
+}
+
+void ReminderApp::delete_reminder(int id)
+{
+    delete_reminders({id});
+}
+
+bool ReminderApp::update_reminders(const std::vector<Reminder> &reminders)
+{
+    if (!m_db || !m_storage.begin())
+        return false;
+
+    JournalEntry entry;
+    std::vector<const Reminder *> written;
+    std::vector<int> stale;
+    for (const auto &reminder : reminders)
+    {
+        const Reminder *current = find_reminder(reminder.id);
+        if (!m_storage.update(reminder, !current || current->tags != reminder.tags))
+        {
+            // Deleted by another program since it was shown: drop it
+            // rather than bring the edit back to life
+            if (!m_storage.contains(reminder.id))
+            {
+                stale.push_back(reminder.id);
+                continue;
+            }
+            m_storage.rollback();
+            return false;
+        }
+        written.push_back(&reminder);
+
+        // Nothing to undo when only the notified flag moved, or nothing did
+        ReminderDelta delta{reminder.id, true, true, current ? *current : Reminder{}, reminder};
+        if (current && !UndoJournal::in_expected_state(delta, false, &reminder))
+        {
+            entry.deltas.push_back(std::move(delta));
+        }
+    }
+
+    if (!m_storage.commit())
+        return false;
+    skip_own_changes();
+
+    // Rows are patched in place, and GTK redraws once after this handler
+    for (const Reminder *reminder : written)
+    {
+        apply_reminder_change(*reminder);
+    }
+    for (int id : stale)
+    {
+        apply_reminder_removal(id);
+    }
+    record_change(std::move(entry));
+    return true;
+}
+
+bool ReminderApp::delete_reminders(const std::vector<int> &ids)
+{
+    if (!m_db || !m_storage.begin())
+        return false;
+
+    JournalEntry entry;
+    for (int id : ids)
+    {
+        if (!m_storage.remove(id))
+        {
+            m_storage.rollback();
+            return false;
+        }
+        if (const Reminder *current = find_reminder(id))
+        {
+            entry.deltas.push_back(ReminderDelta{id, true, false, *current, Reminder{}});
+        }
+    }
+
+    if (!m_storage.commit())
+        return false;
+    skip_own_changes();
+
+    for (int id : ids)
+    {
+        apply_reminder_removal(id);
+    }
+
+    if (!entry.deltas.empty())
+    {
+        show_undo_bar(entry.deltas.size() == 1 ? "Deleted \"" + entry.deltas[0].before.title + "\""
+                                               : "Deleted " + std::to_string(entry.deltas.size()) + " reminders");
+    }
+    record_change(std::move(entry));
+    return true;
+}
+
+void ReminderApp::set_reminder_flag(ReminderFlag flag, int id, bool value)
+{
+    if (!m_db)
+        return;
+
+    if (m_storage.set_flag(id, flag, value))
+    {
+        skip_own_changes();
+    }
+}
+
+const Reminder *ReminderApp::find_reminder(int id)
+{
+    return m_store.find(id);
+}
+
+void ReminderApp::refresh_list()
+{
+    auto started = std::chrono::steady_clock::now();
+
+    // Work out the view from the store's indexes
+    std::vector<int> ids = m_store.query(m_filter);
+    std::unordered_set<int> visible(ids.begin(), ids.end());
+
+    // Drop rows that left the view; rows that stay are not rebuilt
+    std::vector<int> stale;
+    for (const auto &entry : m_rows)
+    {
+        if (visible.count(entry.first) == 0)
+        {
+            stale.push_back(entry.first);
+        }
+    }
+    for (int id : stale)
+    {
+        remove_row(id);
+    }
+
+    // Add rows that entered the view
+    for (int id : ids)
+    {
+        if (m_rows.count(id) == 0)
+        {
+            append_row(*m_store.find(id));
+        }
+    }
+
+    m_list_box.show_all();
+    m_refresh_time.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+
+    // Also update the popup window if it exists
+    if (m_popup_window)
+    {
+        m_popup_window->refresh();
+    }
+}
+
+void ReminderApp::clear_rows()
+{
+    auto children = m_list_box.get_children();
+    for (auto child : children)
+    {
+        m_list_box.remove(*child);
+        delete child;
+    }
+    m_rows.clear();
+}
+
+void ReminderApp::append_row(const Reminder &reminder)
+{
+    // The list's sort function keeps rows in ID order
+    auto row = Gtk::manage(new Gtk::ListBoxRow());
+    row->set_data("reminder_id", GINT_TO_POINTER(reminder.id));
+    row->add(*create_reminder_widget(reminder));
+    m_list_box.add(*row);
+    m_rows[reminder.id] = row;
+}
+
+void ReminderApp::remove_row(int id)
+{
+    auto row_it = m_rows.find(id);
+    if (row_it == m_rows.end())
+        return;
+
+    m_list_box.remove(*row_it->second);
+    delete row_it->second;
+    m_rows.erase(row_it);
+}
+
+void ReminderApp::apply_reminder_change(const Reminder &reminder)
+{
+    const Reminder *previous = m_store.find(reminder.id);
+    bool tags_changed = !previous || previous->tags != reminder.tags;
+
+    m_store.upsert(reminder);
+    arm_reminder(reminder);
+    schedule_snapshot();
+
+    if (tags_changed)
+    {
+        update_tag_filter_options();
+    }
+
+    auto row_it = m_rows.find(reminder.id);
+    if (!m_store.matches(m_filter, reminder))
+    {
+        remove_row(reminder.id);
+    }
+    else if (row_it != m_rows.end())
+    {
+        // Swap the contents of the existing row rather than rebuilding the list
+        Gtk::ListBoxRow *row = row_it->second;
+        Gtk::Widget *old_widget = row->get_child();
+        if (old_widget)
+        {
+            row->remove();
+            delete old_widget;
+        }
+        row->add(*create_reminder_widget(reminder));
+        row->show_all();
+    }
+    else
+    {
+        append_row(reminder);
+        m_rows[reminder.id]->show_all();
+    }
+
+    if (m_popup_window)
+    {
+        m_popup_window->update_reminder(reminder);
+    }
+    schedule_tray_update();
+}
+
+void ReminderApp::apply_reminder_removal(int id)
+{
+    m_store.remove(id);
+    m_scheduler.cancel_all(id);
+    m_escalation_notices.erase(id);
+    remove_row(id);
+    schedule_snapshot();
+
+    // Nothing left to edit
+    if (m_editing_id == id)
+    {
+        m_editing_id = -1;
+        m_edit_dialog.hide();
+    }
+
+    if (m_popup_window)
+    {
+        m_popup_window->remove_reminder(id);
+    }
+    schedule_tray_update();
+}
+
+void ReminderApp::on_filter_changed()
+{
+    // Preset filters, in the order they were added to the combo box
+    ReminderFilter filter;
+    switch (m_filter_combo.get_active_row_number())
+    {
+    case 1: // Active
+        filter.hide_completed = true;
+        break;
+    case 2: // Due today
+        filter.pending_today = true;
+        break;
+    case 3: // Due today, high priority
+        filter.pending_today = true;
+        filter.min_priority = PRIORITY_HIGH;
+        break;
+    default: // All
+        break;
+    }
+
+    if (m_tag_filter_combo.get_active_row_number() > 0)
+    {
+        filter.tag = m_tag_filter_combo.get_active_text();
+    }
+
+    m_filter = filter;
+    refresh_list();
+}
+
+void ReminderApp::update_tag_filter_options()
+{
+    std::vector<std::string> tags = m_store.tags();
+    if (tags == m_known_tags)
+        return;
+
+    m_known_tags = tags;
+
+    // Keep the current selection if its tag is still in use
+    std::string selected = m_filter.tag;
+
+    m_tag_filter_combo.remove_all();
+    m_tag_filter_combo.append("All tags");
+    for (const auto &tag : m_known_tags)
+    {
+        m_tag_filter_combo.append(tag);
+    }
+
+    if (!selected.empty() && std::find(tags.begin(), tags.end(), selected) != tags.end())
+    {
+        m_tag_filter_combo.set_active_text(selected);
+    }
+    else
+    {
+        m_tag_filter_combo.set_active(0);
+    }
+}
+
+Gtk::Widget *ReminderApp::create_reminder_widget(const Reminder &reminder)
+{
+    // Create a box to hold the reminder
+    auto box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5));
+    box->set_border_width(5);
+
+    // Create checkbox for completion status
+    auto check = Gtk::manage(new Gtk::CheckButton());
     check->set_active(reminder.completed);
     check->signal_toggled().connect([this, reminder, check]()
                                     {
         Reminder updated = reminder;
         updated.completed = check->get_active();
-        update_reminder(updated); });
 
-    // Create title label
-    auto title = Gtk::manage(new Gtk::Label(reminder.title));
+        // The update replaces this row, so run it after the signal returns
+        Glib::signal_idle().connect_once([this, updated]()
+                                         { update_reminder(updated); }); });
+
+    // Create title label, marked when the reminder is high priority
+    auto title = Gtk::manage(new Gtk::Label(reminder.priority == PRIORITY_HIGH ? "❗ " + reminder.title : reminder.title));
     title->set_halign(Gtk::ALIGN_START);
     title->set_hexpand(true);
 
+    // Tags, if any
+    auto tags = Gtk::manage(new Gtk::Label());
+    if (!reminder.tags.empty())
+    {
+        tags->set_markup("<small>" + Glib::Markup::escape_text(ReminderEditor::join_tags(reminder.tags)) + "</small>");
+    }
+
     // Create time label with 12-hour format
     std::string displayTime = convert_to_12hour_format(reminder.time);
     auto time = Gtk::manage(new Gtk::Label(displayTime));
@@ -609,6 +1484,7 @@ Gtk::Widget *ReminderApp::create_reminder_widget(const Reminder &reminder)
     // Add widgets to box
     box->pack_start(*check, Gtk::PACK_SHRINK);
     box->pack_start(*title, Gtk::PACK_EXPAND_WIDGET);
+    box->pack_start(*tags, Gtk::PACK_SHRINK);
     box->pack_start(*time, Gtk::PACK_SHRINK);
     box->pack_start(*edit_btn, Gtk::PACK_SHRINK);
     box->pack_start(*delete_btn, Gtk::PACK_SHRINK);
@@ -619,327 +1495,1095 @@ Gtk::Widget *ReminderApp::create_reminder_widget(const Reminder &reminder)
     return box;
 }
 
+void ReminderApp::setup_edit_dialogs()
+{
+    // Built once; opening it only refills the form. It is not modal and
+    // reports through its response signal, so the main loop keeps running.
+    m_edit_dialog.add_button("Cancel", Gtk::RESPONSE_CANCEL);
+    m_edit_dialog.add_button("Save", Gtk::RESPONSE_OK);
+    m_edit_dialog.set_default_response(Gtk::RESPONSE_OK);
+    m_edit_dialog.set_default_size(400, 300);
+
+    auto content_area = m_edit_dialog.get_content_area();
+    content_area->set_border_width(10);
+    content_area->set_spacing(10);
+    content_area->pack_start(m_editor, true, true, 0);
+    m_edit_dialog.show_all_children();
+
+    m_edit_dialog.signal_response().connect(sigc::mem_fun(*this, &ReminderApp::on_edit_response));
+
+}
+
 void ReminderApp::on_edit_button_clicked(int id)
 {
     // Find the reminder
-    auto it = std::find_if(m_reminders.begin(), m_reminders.end(),
-                           [id](const Reminder &r)
-                           { return r.id == id; });
+    const Reminder *it = find_reminder(id);
 
-    if (it == m_reminders.end())
+    if (!it)
         return;
 
-    // Create dialog for editing
-    Gtk::Dialog dialog("Edit Reminder", m_window, true);
-    dialog.add_button("Cancel", Gtk::RESPONSE_CANCEL);
-    dialog.add_button("Save", Gtk::RESPONSE_OK);
-    dialog.set_default_size(400, 300);
-
-    // Add content area
-    auto content_area = dialog.get_content_area();
-    content_area->set_border_width(10);
-    content_area->set_spacing(10);
-
-    // Parse the time string (HH:MM in 24-hour format)
-    int hour24 = std::stoi(it->time.substr(0, 2));
-    std::string minute_str = it->time.substr(3, 2);
+    auto started = std::chrono::steady_clock::now();
+    m_editing_id = id;
+    m_editor.set_reminder(*it);
+    m_edit_dialog.present();
+    m_editor.title_entry().grab_focus();
 
-    // Convert to 12-hour format for display
-    int hour12 = hour24;
-    std::string ampm = "AM";
+    // Until the dialog has been laid out and the main loop is free again
+    Glib::signal_idle().connect_once([this, started]()
+                                     { m_dialog_time.record(
+                                           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count()); });
+}
 
-    if (hour24 >= 12)
+void ReminderApp::on_edit_response(int response)
+{
+    if (response == Gtk::RESPONSE_OK)
     {
-        ampm = "PM";
-        if (hour24 > 12)
+        // The reminder may have changed or gone while the dialog was open
+        const Reminder *it = find_reminder(m_editing_id);
+        if (it)
         {
-            hour12 = hour24 - 12;
+            Reminder updated = *it;
+            if (!m_editor.get_reminder(updated))
+                return; // Keep the dialog open with the problem shown
+
+            // Reset notification status if time has changed
+            if (updated.time != it->time)
+            {
+                updated.notified = false;
+            }
+
+            update_reminder(updated);
         }
     }
-    else if (hour24 == 0)
-    {
-        hour12 = 12;
-    }
-
-    // Format the hour as a string with leading zero if needed
-    std::stringstream hour_ss;
-    hour_ss << std::setw(2) << std::setfill('0') << hour12;
-    std::string hour_str = hour_ss.str();
 
-    // Create input fields with a grid layout for better organization
-    Gtk::Grid input_grid;
-    input_grid.set_row_spacing(10);
-    input_grid.set_column_spacing(10);
+    m_editing_id = -1;
+    m_edit_dialog.hide();
+}
 
-    // Title row
-    Gtk::Label title_label("Title:");
-    Gtk::Entry title_entry;
-    title_entry.set_text(it->title);
-    title_entry.set_hexpand(true);
+void ReminderApp::on_delete_button_clicked(int id)
+{
+    // No confirmation; the undo bar can bring it back
+    delete_reminder(id);
+}
 
-    input_grid.attach(title_label, 0, 0, 1, 1);
-    input_grid.attach(title_entry, 1, 0, 2, 1);
+std::vector<int> ReminderApp::selected_ids()
+{
+    std::vector<int> ids;
+    for (auto row : m_list_box.get_selected_rows())
+    {
+        int id = GPOINTER_TO_INT(row->get_data("reminder_id"));
+        if (find_reminder(id))
+        {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
 
-    // Time row
-    Gtk::Label time_label("Time:");
+void ReminderApp::on_selection_changed()
+{
+    size_t count = m_list_box.get_selected_rows().size();
+    m_selection_label.set_text(count == 0 ? "No reminders selected" : std::to_string(count) + " selected");
+    m_bulk_complete_button.set_sensitive(count > 0);
+    m_bulk_uncomplete_button.set_sensitive(count > 0);
+    m_bulk_shift_spin.set_sensitive(count > 0);
+    m_bulk_shift_button.set_sensitive(count > 0);
+    m_bulk_time_entry.set_sensitive(count > 0);
+    m_bulk_time_button.set_sensitive(count > 0);
+    m_bulk_delete_button.set_sensitive(count > 0);
+}
 
-    // Hour combo (12-hour format: 1-12)
-    Gtk::ComboBoxText hour_combo;
-    for (int i = 1; i <= 12; i++)
+void ReminderApp::on_bulk_set_completed(bool completed)
+{
+    std::vector<Reminder> changed;
+    for (int id : selected_ids())
     {
-        std::stringstream ss;
-        ss << std::setw(2) << std::setfill('0') << i;
-        hour_combo.append(ss.str());
+        Reminder reminder = *find_reminder(id);
+        if (reminder.completed != completed)
+        {
+            reminder.completed = completed;
+            changed.push_back(reminder);
+        }
     }
-    hour_combo.set_active_text(hour_str);
 
-    // Minute combo
-    Gtk::ComboBoxText minute_combo;
-    for (int i = 0; i < 60; i++)
+    if (!changed.empty())
     {
-        std::stringstream ss;
-        ss << std::setw(2) << std::setfill('0') << i;
-        minute_combo.append(ss.str());
+        update_reminders(changed);
+    }
+}
+
+void ReminderApp::on_bulk_shift()
+{
+    int minutes = m_bulk_shift_spin.get_value_as_int();
+    if (minutes == 0)
+        return;
+
+    std::vector<Reminder> changed;
+    for (int id : selected_ids())
+    {
+        Reminder reminder = *find_reminder(id);
+        reminder.time = shift_reminder_time(reminder.time, minutes);
+        reminder.notified = false; // Due again at the new time
+        changed.push_back(reminder);
+    }
+
+    if (!changed.empty())
+    {
+        update_reminders(changed);
+    }
+}
+
+void ReminderApp::on_bulk_reschedule()
+{
+    std::string time = m_bulk_time_entry.get_text();
+    if (!is_valid_reminder_time(time))
+    {
+        m_bulk_time_entry.grab_focus();
+        return;
+    }
+
+    std::vector<Reminder> changed;
+    for (int id : selected_ids())
+    {
+        Reminder reminder = *find_reminder(id);
+        if (reminder.time != time)
+        {
+            reminder.time = time;
+            reminder.notified = false;
+            changed.push_back(reminder);
+        }
+    }
+
+    if (!changed.empty() && update_reminders(changed))
+    {
+        m_bulk_time_entry.set_text("");
     }
-    minute_combo.set_active_text(minute_str);
+}
 
-    // AM/PM combo
-    Gtk::ComboBoxText ampm_combo;
-    ampm_combo.append("AM");
-    ampm_combo.append("PM");
-    ampm_combo.set_active_text(ampm);
+void ReminderApp::on_bulk_delete()
+{
+    std::vector<int> ids = selected_ids();
+    if (!ids.empty())
+    {
+        delete_reminders(ids);
+    }
+}
+
+void ReminderApp::record_change(JournalEntry entry)
+{
+    m_journal.record(std::move(entry));
+    update_undo_controls();
+}
+
+bool ReminderApp::journal_entry_applies(const JournalEntry &entry, bool undoing)
+{
+    for (const auto &delta : entry.deltas)
+    {
+        if (!UndoJournal::in_expected_state(delta, undoing, find_reminder(delta.id)))
+            return false;
+    }
+    return true;
+}
 
-    // Time separator
-    Gtk::Label time_separator;
-    time_separator.set_text(":");
+bool ReminderApp::apply_journal_entry(const JournalEntry &entry, bool undoing)
+{
+    if (!m_db || !m_storage.begin())
+        return false;
 
-    Gtk::Box time_box(Gtk::ORIENTATION_HORIZONTAL, 5);
+    std::vector<Reminder> changed;
+    std::vector<int> removed;
+    bool ok = true;
+    for (const auto &delta : entry.deltas)
+    {
+        const Reminder *current = find_reminder(delta.id);
+        if (!(undoing ? delta.had_before : delta.has_after))
+        {
+            ok = !current || m_storage.remove(delta.id);
+            removed.push_back(delta.id);
+        }
+        else
+        {
+            Reminder target = undoing ? delta.before : delta.after;
+            if (current && current->time == target.time)
+            {
+                // Keep whether it already fired today
+                target.notified = current->notified;
+            }
+            ok = current ? m_storage.update(target, current->tags != target.tags) : m_storage.restore(target);
+            changed.push_back(target);
+        }
 
-    // Set fixed width for combo boxes
-    hour_combo.property_width_request() = 60;
-    minute_combo.property_width_request() = 60;
-    ampm_combo.property_width_request() = 60;
+        if (!ok)
+            break;
+    }
 
-    time_box.pack_start(hour_combo, Gtk::PACK_SHRINK);
-    time_box.pack_start(time_separator, Gtk::PACK_SHRINK);
-    time_box.pack_start(minute_combo, Gtk::PACK_SHRINK);
-    time_box.pack_start(ampm_combo, Gtk::PACK_SHRINK);
+    if (!ok)
+    {
+        m_storage.rollback();
+        return false;
+    }
+    if (!m_storage.commit())
+        return false;
+    skip_own_changes();
 
-    // Set fixed width for entire time box
-    time_box.property_width_request() = 200;
+    for (const auto &reminder : changed)
+    {
+        apply_reminder_change(reminder);
+    }
+    for (int id : removed)
+    {
+        apply_reminder_removal(id);
+    }
+    return true;
+}
 
-    input_grid.attach(time_label, 0, 1, 1, 1);
-    input_grid.attach(time_box, 1, 1, 2, 1);
+void ReminderApp::undo()
+{
+    const JournalEntry *entry = m_journal.next_undo();
+    if (!entry)
+        return;
 
-    // Description row
-    Gtk::Label desc_label("Description:");
-    Gtk::TextView desc_textview;
-    desc_textview.get_buffer()->set_text(it->description);
-    desc_textview.set_hexpand(true);
-    desc_textview.set_vexpand(true);
+    hide_undo_bar();
 
-    // Scrolled window for description
-    Gtk::ScrolledWindow desc_scroll;
-    desc_scroll.add(desc_textview);
-    desc_scroll.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
-    desc_scroll.set_shadow_type(Gtk::SHADOW_IN);
-    desc_scroll.set_size_request(-1, 100);
+    // Changes made elsewhere since, e.g. by reminderd or the archive, win
+    if (!journal_entry_applies(*entry, true))
+    {
+        std::cerr << "Can't undo " << entry->describe() << ": changed since" << std::endl;
+        m_journal.discard_undo();
+    }
+    else if (apply_journal_entry(*entry, true))
+    {
+        m_journal.undone();
+    }
+    update_undo_controls();
+}
 
-    input_grid.attach(desc_label, 0, 2, 3, 1);
-    input_grid.attach(desc_scroll, 0, 3, 3, 1);
+void ReminderApp::redo()
+{
+    const JournalEntry *entry = m_journal.next_redo();
+    if (!entry)
+        return;
 
-    // Status row
-    Gtk::CheckButton completed_check("Completed");
-    completed_check.set_active(it->completed);
-    input_grid.attach(completed_check, 0, 4, 3, 1);
+    if (!journal_entry_applies(*entry, false))
+    {
+        std::cerr << "Can't redo " << entry->describe() << ": changed since" << std::endl;
+        m_journal.discard_redo();
+    }
+    else if (apply_journal_entry(*entry, false))
+    {
+        m_journal.redone();
+    }
+    update_undo_controls();
+}
 
-    // Add grid to content area
-    content_area->pack_start(input_grid, true, true, 0);
+void ReminderApp::update_undo_controls()
+{
+    const JournalEntry *undo_entry = m_journal.next_undo();
+    const JournalEntry *redo_entry = m_journal.next_redo();
+    m_undo_button.set_sensitive(undo_entry != nullptr);
+    m_redo_button.set_sensitive(redo_entry != nullptr);
+    m_undo_button.set_tooltip_text(undo_entry ? "Undo " + undo_entry->describe() + " (Ctrl+Z)" : "Nothing to undo");
+    m_redo_button.set_tooltip_text(redo_entry ? "Redo " + redo_entry->describe() + " (Ctrl+Shift+Z)" : "Nothing to redo");
+}
 
-    dialog.show_all_children();
+void ReminderApp::show_undo_bar(const std::string &message)
+{
+    m_undo_label.set_text(message);
+    m_undo_bar.show();
+
+    m_undo_bar_timer.disconnect();
+    m_undo_bar_timer = Glib::signal_timeout().connect_seconds([this]()
+                                                              {
+        m_undo_bar.hide();
+        return false; }, UNDO_BAR_SECONDS);
+}
 
-    int result = dialog.run();
+void ReminderApp::hide_undo_bar()
+{
+    m_undo_bar_timer.disconnect();
+    m_undo_bar.hide();
+}
+
+bool ReminderApp::on_window_key_press(GdkEventKey *event)
+{
+    guint key = gdk_keyval_to_lower(event->keyval);
+
+    if (event->state & GDK_CONTROL_MASK)
+    {
+        if (key == GDK_KEY_z)
+        {
+            if (event->state & GDK_SHIFT_MASK)
+                redo();
+            else
+                undo();
+            return true;
+        }
+        if (key == GDK_KEY_y)
+        {
+            redo();
+            return true;
+        }
+        return false;
+    }
+
+    // Delete removes the selected rows while the list has the focus
+    Gtk::Widget *focus = m_window.get_focus();
+    if (key == GDK_KEY_Delete && focus && (focus == &m_list_box || focus->is_ancestor(m_list_box)))
+    {
+        on_bulk_delete();
+        return true;
+    }
+    return false;
+}
+
+void ReminderApp::show_add_error(const std::string &message)
+{
+    m_add_error_label.set_text(message);
+    m_add_error_label.show();
+    m_title_entry.get_style_context()->add_class("error");
+}
+
+void ReminderApp::clear_add_error()
+{
+    m_add_error_label.hide();
+    m_title_entry.get_style_context()->remove_class("error");
+}
+
+void ReminderApp::start_scheduler()
+{
+    m_fire_dispatcher.connect(sigc::mem_fun(*this, &ReminderApp::on_deadlines_fired));
+    m_scheduler.arm_day_rollover();
+
+    // Runs on the scheduler thread; everything else happens on the main loop
+    m_scheduler.start([this](const std::vector<Deadline> &due)
+                      {
+        StallScope scope(m_stall_detector, m_scheduler_loop, "handing deadlines to the main loop");
+        {
+            std::lock_guard<std::mutex> lock(m_fired_mutex);
+            m_fired.insert(m_fired.end(), due.begin(), due.end());
+        }
+        m_fire_dispatcher.emit(); });
+}
+
+void ReminderApp::arm_from_snapshot()
+{
+    m_snapshot_path = snapshot_path_for(std::string(getenv("HOME")) + "/.local/share/reminders.db");
+
+    // None on the first start, or after a restore
+    if (access(m_snapshot_path.c_str(), F_OK) != 0)
+        return;
+
+    auto started = std::chrono::steady_clock::now();
+    ReminderSnapshot snapshot;
+    std::string error;
+    if (!snapshot.open(m_snapshot_path, error))
+    {
+        std::cerr << "Ignoring snapshot " << m_snapshot_path << ": " << error << std::endl;
+        return;
+    }
+
+    m_scheduler.preload(snapshot.primary_deadlines(m_clock));
+    m_snapshot_version = snapshot.sync_version();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Armed " << snapshot.size() << " reminders from the snapshot in " << ms << " ms" << std::endl;
+}
+
+void ReminderApp::open_database()
+{
+    m_db_path = std::string(getenv("HOME")) + "/.local/share/reminders.db";
+    m_opened.started = std::chrono::steady_clock::now();
+    m_opened_dispatcher.connect(sigc::mem_fun(*this, &ReminderApp::on_database_opened));
+    m_open_thread = std::thread(&ReminderApp::load_database, this);
+}
+
+// Runs on the open thread. The main loop leaves m_storage, m_subscriptions
+// and m_subscription_paths alone until on_database_opened, as m_db is null.
+void ReminderApp::load_database()
+{
+    sqlite3 *db = prepare_database();
+    if (db)
+    {
+        // The daily clean-up, as reset_notification_status does it
+        archive_completed(db);
+        purge_delivery_history(db);
+        if (m_storage.reset_notified())
+        {
+            std::cout << "Notification status reset for a new day." << std::endl;
+        }
+
+        // Commits by other processes after this are picked up once the
+        // main loop watches the files
+        m_opened.data_version = read_data_version(db);
+        if (read_reminders(db, m_opened.store, m_opened.sync_version))
+        {
+            purge_tombstones(db, m_opened.sync_version);
+        }
+
+        // Calendar files whose events of the day become reminders, synced
+        // against the store before anyone sees it
+        m_subscriptions.attach(db, &m_storage);
+        m_subscription_paths = IcsSubscriptions::split_paths(read_setting_text(db, "ics_subscriptions", ""));
+        ReminderStore &store = m_opened.store;
+        FeedChanges changes;
+        sync_subscription_files([&store](int id)
+                                { return store.find(id); },
+                                changes);
+        for (const auto &reminder : changes.changed)
+        {
+            store.upsert(reminder);
+        }
+        for (int id : changes.removed)
+        {
+            store.remove(id);
+        }
+        if (!changes.changed.empty() || !changes.removed.empty())
+        {
+            std::cout << "Calendar subscriptions: " << changes.changed.size() << " reminders added or updated, "
+                      << changes.removed.size() << " removed." << std::endl;
+
+            // The store has the feed's writes; skip past them unless
+            // another process committed in the meantime
+            if (read_data_version(db) == m_opened.data_version)
+            {
+                m_opened.sync_version = read_sync_version(db);
+            }
+        }
+    }
+
+    m_opened.db = db;
+    m_opened_dispatcher.emit();
+}
+
+void ReminderApp::on_database_opened()
+{
+    StallScope scope(m_stall_detector, m_main_loop, "on_database_opened");
+    m_open_thread.join();
+
+    m_db = m_opened.db;
+    m_opened.db = nullptr;
+    if (m_db)
+    {
+        // Watch the database and its WAL for writes made by other processes,
+        // and catch up on any made since the thread read the reminders
+        watch_database_files(m_db_path);
+        m_data_version = m_opened.data_version;
+        start_subscriptions();
+        m_current_date = current_date_string(m_clock);
+
+        // Loads the reminders and re-arms them, replacing what the snapshot armed
+        install_reminders(std::move(m_opened.store), m_opened.sync_version);
+        check_external_changes();
+        if (m_history_expander.get_expanded())
+        {
+            on_history_expanded();
+        }
+    }
+
+    // Outputs for fired reminders besides the desktop notification
+    start_sinks();
+
+    if (m_db)
+    {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_opened.started).count();
+        std::cout << "Loaded " << m_store.size() << " reminders from the database in " << ms << " ms" << std::endl;
+
+        // Nothing to rewrite if the snapshot was already current
+        if (m_snapshot_version == query_sync_version())
+        {
+            m_snapshot_timer.disconnect();
+            m_snapshot_dirty = false;
+        }
+        else if (m_snapshot_version != -1)
+        {
+            std::cout << "Snapshot was behind the database; refreshing it" << std::endl;
+        }
+    }
+
+    // Hand over deadlines that fired while the database was opening
+    m_fire_dispatcher.emit();
+}
+
+void ReminderApp::schedule_snapshot()
+{
+    m_snapshot_dirty = true;
+    if (!m_snapshot_timer.connected())
+    {
+        m_snapshot_timer = Glib::signal_timeout().connect_seconds(
+            sigc::mem_fun(*this, &ReminderApp::on_snapshot_timer), SNAPSHOT_DELAY_SECONDS);
+    }
+}
+
+bool ReminderApp::on_snapshot_timer()
+{
+    write_snapshot();
+    return false;
+}
+
+void ReminderApp::write_snapshot()
+{
+    if (!m_snapshot_dirty || !m_db)
+        return;
+
+    StallScope scope(m_stall_detector, m_main_loop, "write_snapshot");
+    if (write_reminder_snapshot(m_snapshot_path, m_store.all(), query_sync_version(), m_clock))
+    {
+        m_snapshot_dirty = false;
+    }
+}
+
+void ReminderApp::arm_reminder(const Reminder &reminder)
+{
+    // The scheduling rules live in the scheduler so the simulator shares them
+    m_scheduler.arm(reminder);
+}
+
+void ReminderApp::on_deadlines_fired()
+{
+    // Deadlines armed from the snapshot can fire before the database is
+    // open; they wait for the reminders they belong to
+    if (!m_db)
+        return;
+
+    StallScope scope(m_stall_detector, m_main_loop, "on_deadlines_fired");
+    std::vector<Deadline> fired;
+    {
+        std::lock_guard<std::mutex> lock(m_fired_mutex);
+        fired.swap(m_fired);
+    }
+
+    // On a shared host reminderd delivers instead, and its writes reach this
+    // instance through the external change detection
+    bool service_delivers = delivery_service_active();
+
+    for (const auto &deadline : fired)
+    {
+        if (deadline.kind == DeadlineKind::DayRollover)
+        {
+            std::string current_date = current_date_string(m_clock);
+            std::cout << "Date changed from " << m_current_date << " to " << current_date << ", resetting notification status." << std::endl;
+            m_current_date = current_date;
+            m_escalation_notices.clear();
+            reset_notification_status();
+            m_scheduler.arm_day_rollover();
+            continue;
+        }
+
+        const Reminder *reminder = find_reminder(deadline.reminder_id);
+        if (!reminder || reminder->completed || service_delivers)
+            continue;
+
+        // A primary held while the database opened may have been re-armed
+        // from it and delivered already
+        if (deadline.kind == DeadlineKind::Primary && reminder->notified)
+            continue;
+
+        // Each repeat notice is more urgent than the last
+        int notice = 0;
+        if (deadline.kind == DeadlineKind::Escalation)
+        {
+            notice = ++m_escalation_notices[reminder->id];
+        }
+        else if (deadline.kind == DeadlineKind::Primary)
+        {
+            m_escalation_notices.erase(reminder->id);
+        }
+
+        show_notification(*reminder, notice);
+
+        double lateness_ms = std::chrono::duration<double, std::milli>(m_clock.now() - deadline.when).count();
+        m_notification_lateness.record(lateness_ms);
+        std::cout << "Notified '" << reminder->title << "' " << static_cast<long>(lateness_ms)
+                  << " ms after its deadline" << std::endl;
+
+        // The sinks batch on their own threads, so a slow one never holds
+        // up the next notification
+        m_sinks.publish({reminder->id, reminder->title, reminder->description, reminder->time,
+                         reminder->priority, notice, deadline.kind, deadline.when, m_clock.now()});
+
+        // A fired snooze no longer decides where the reminder sorts
+        if (deadline.kind == DeadlineKind::Snooze && m_popup_window)
+        {
+            m_popup_window->update_reminder(*reminder);
+        }
+
+        // Escalation resumes after a snooze and repeats until acknowledged.
+        // The first one is armed when the primary marks the reminder notified.
+        if (deadline.kind == DeadlineKind::Snooze || deadline.kind == DeadlineKind::Escalation)
+        {
+            m_scheduler.escalate(*reminder);
+        }
+
+        if (deadline.kind == DeadlineKind::Primary)
+        {
+            // Mark the reminder as notified to prevent duplicate notifications
+            set_reminder_flag(ReminderFlag::Notified, reminder->id, true);
+            Reminder updated = *reminder;
+            updated.notified = true;
+            apply_reminder_change(updated);
+        }
+    }
+
+    // Snoozes and escalations that fired move on in the tray too
+    schedule_tray_update();
+}
+
+void ReminderApp::show_notification(const Reminder &reminder, int notice)
+{
+    StallScope scope(m_stall_detector, m_main_loop, "show_notification");
+    if (!notify_is_initted())
+    {
+        notify_init("ReminderApp");
+    }
+
+    // Replace a notification for the same reminder that is still showing
+    auto existing = m_notifications.find(reminder.id);
+    if (existing != m_notifications.end())
+    {
+        notify_notification_close(existing->second, nullptr);
+        g_object_unref(G_OBJECT(existing->second));
+        m_notifications.erase(existing);
+    }
+
+    // Repeat notices say so in the summary and are more urgent
+    NotifyNotification *notification = notify_notification_new(
+        notification_summary(reminder, notice).c_str(),
+        notification_body(reminder).c_str(),
+        notification_icon(notice));
+
+    notify_notification_set_timeout(notification, NOTIFY_EXPIRES_DEFAULT);
+
+    notify_notification_set_urgency(notification,
+                                    static_cast<NotifyUrgency>(notification_urgency(reminder.priority, notice)));
+
+    // Actions are delivered on the main loop by libnotify
+    g_object_set_data(G_OBJECT(notification), "reminder_id", GINT_TO_POINTER(reminder.id));
+    NotifyActionCallback on_action = +[](NotifyNotification *notification, char *action, gpointer user_data)
+    {
+        int reminder_id = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(notification), "reminder_id"));
+        static_cast<ReminderApp *>(user_data)->on_notification_action(reminder_id, action);
+    };
+    notify_notification_add_action(notification, "snooze-5", "Snooze 5 min", on_action, this, nullptr);
+    notify_notification_add_action(notification, "snooze-15", "Snooze 15 min", on_action, this, nullptr);
+    notify_notification_add_action(notification, "snooze-60", "Snooze 1 hour", on_action, this, nullptr);
+    notify_notification_add_action(notification, "done", "Done", on_action, this, nullptr);
+
+    g_signal_connect(notification, "closed", G_CALLBACK(+[](NotifyNotification *notification, gpointer user_data)
+                                                        {
+                                                            static_cast<ReminderApp *>(user_data)->on_notification_closed(notification);
+                                                        }),
+                     this);
+
+    GError *error = nullptr;
+    if (!notify_notification_show(notification, &error))
+    {
+        std::cerr << "Failed to show notification: " << (error ? error->message : "unknown error") << std::endl;
+        if (error)
+        {
+            g_error_free(error);
+        }
+        g_object_unref(G_OBJECT(notification));
+        return;
+    }
+
+    std::cout << "Notification sent: " << reminder.title << std::endl;
+    m_notifications[reminder.id] = notification;
+}
+
+void ReminderApp::on_notification_action(int reminder_id, const std::string &action)
+{
+    const Reminder *reminder = find_reminder(reminder_id);
+    if (!reminder)
+        return;
+
+    // Either action acknowledges the reminder and stops its escalation
+    m_escalation_notices.erase(reminder_id);
+
+    if (action == "done")
+    {
+        // Goes through the journal like the popup's toggle, so it can be
+        // undone, and only shows as done once it is saved
+        Reminder updated = *reminder;
+        updated.completed = true;
+        update_reminder(updated);
+    }
+    else if (action.compare(0, 7, "snooze-") == 0)
+    {
+        int minutes = std::stoi(action.substr(7));
+        m_scheduler.cancel(reminder_id, DeadlineKind::Escalation);
+        m_scheduler.schedule(reminder_id, DeadlineKind::Snooze,
+                             m_clock.now() + std::chrono::minutes(minutes));
+        std::cout << "Snoozed '" << reminder->title << "' for " << minutes << " minutes" << std::endl;
+
+        // Move the reminder to its new place in the upcoming list
+        if (m_popup_window)
+        {
+            m_popup_window->update_reminder(*reminder);
+        }
+        schedule_tray_update();
+    }
+}
+
+void ReminderApp::on_notification_closed(NotifyNotification *notification)
+{
+    for (auto it = m_notifications.begin(); it != m_notifications.end(); ++it)
+    {
+        if (it->second == notification)
+        {
+            g_object_unref(G_OBJECT(notification));
+            m_notifications.erase(it);
+            break;
+        }
+    }
+}
+
+void ReminderApp::start_control_channel()
+{
+    if (!m_control.listen(control_socket_path()))
+        return;
+
+    Glib::signal_io().connect(sigc::mem_fun(*this, &ReminderApp::on_control_connection),
+                              m_control.fd(), Glib::IO_IN);
+}
+
+bool ReminderApp::on_control_connection(Glib::IOCondition)
+{
+    int client;
+    while ((client = m_control.accept_client()) != -1)
+    {
+        Glib::signal_io().connect(sigc::bind(sigc::mem_fun(*this, &ReminderApp::on_control_client_io), client),
+                                  client, Glib::IO_IN | Glib::IO_HUP | Glib::IO_ERR);
+    }
+
+    return true;
+}
+
+bool ReminderApp::on_control_client_io(Glib::IOCondition, int client)
+{
+    // Returning false removes the watch once the client is gone
+    return m_control.read_client(client, [this](int from, const std::vector<std::string> &fields)
+                                 { on_control_command(from, fields); });
+}
+
+void ReminderApp::on_control_command(int client, const std::vector<std::string> &fields)
+{
+    StallScope scope(m_stall_detector, m_main_loop, "on_control_command");
+    auto received = std::chrono::steady_clock::now();
+    const std::string &command = fields[0];
+
+    if (command == "stats" && fields.size() == 1)
+    {
+        m_control.reply(client, control_stats());
+        return;
+    }
+
+    if (command == "reset" && fields.size() == 1)
+    {
+        reset_control_stats();
+        m_control.reply(client, "ok");
+        return;
+    }
+
+    if (command == "ui" && fields.size() >= 2)
+    {
+        run_ui_command(client, fields, received);
+        return;
+    }
+
+    if (command == "add" && fields.size() == 3)
+    {
+        if (!is_valid_reminder_time(fields[1]) || fields[2].empty())
+        {
+            m_control.reply(client, join_fields({"error", "expected a valid time and a title"}));
+            return;
+        }
+
+        Reminder reminder;
+        reminder.id = 0;
+        reminder.time = fields[1];
+        reminder.title = fields[2];
+        reminder.completed = false;
+        reminder.notified = false;
+
+        int id = add_reminder(reminder);
+        if (id < 0)
+        {
+            m_control.reply(client, join_fields({"error", "failed to save reminder"}));
+            return;
+        }
+
+        reply_after_update(client, id, received);
+        return;
+    }
 
-    if (result == Gtk::RESPONSE_OK)
+    // The remaining commands act on an existing reminder
+    bool known = (command == "edit" && fields.size() == 4) ||
+                 ((command == "toggle" || command == "delete") && fields.size() == 2);
+    if (!known)
     {
-        Reminder updated = *it;
-        updated.title = title_entry.get_text();
-        updated.description = desc_textview.get_buffer()->get_text();
+        m_control.reply(client, join_fields({"error", "unknown command"}));
+        return;
+    }
 
-        // Convert time from 12-hour format to 24-hour format for storage
-        int hour = std::stoi(hour_combo.get_active_text());
-        std::string minute = minute_combo.get_active_text();
-        std::string ampm = ampm_combo.get_active_text();
+    int id = std::atoi(fields[1].c_str());
+    const Reminder *reminder = find_reminder(id);
+    if (!reminder)
+    {
+        m_control.reply(client, join_fields({"error", "no reminder " + fields[1]}));
+        return;
+    }
 
-        // Convert to 24-hour format
-        if (ampm == "PM" && hour != 12)
-        {
-            hour += 12;
-        }
-        else if (ampm == "AM" && hour == 12)
+    if (command == "edit")
+    {
+        if (!is_valid_reminder_time(fields[2]) || fields[3].empty())
         {
-            hour = 0;
+            m_control.reply(client, join_fields({"error", "expected a valid time and a title"}));
+            return;
         }
 
-        // Format the time string (24-hour format)
-        std::stringstream timeStream;
-        timeStream << std::setw(2) << std::setfill('0') << hour << ":" << minute;
-        updated.time = timeStream.str();
+        Reminder updated = *reminder;
+        updated.time = fields[2];
+        updated.title = fields[3];
 
-        updated.completed = completed_check.get_active();
-
-        // Reset notification status if time has changed
-        if (updated.time != it->time)
+        // A new time fires again today, as from the edit dialog
+        if (updated.time != reminder->time)
         {
             updated.notified = false;
         }
-
         update_reminder(updated);
     }
-}
-
-void ReminderApp::on_delete_button_clicked(int id)
-{
-    // Ask for confirmation
-    Gtk::MessageDialog dialog(m_window, "Delete Reminder", false, Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_YES_NO);
-    dialog.set_secondary_text("Are you sure you want to delete this reminder?");
-
-    int result = dialog.run();
-
-    if (result == Gtk::RESPONSE_YES)
+    else if (command == "toggle")
+    {
+        Reminder updated = *reminder;
+        updated.completed = !updated.completed;
+        update_reminder(updated);
+    }
+    else
     {
         delete_reminder(id);
     }
+
+    reply_after_update(client, id, received);
 }
 
-void ReminderApp::start_notification_thread()
+void ReminderApp::reply_after_update(int client, int id, std::chrono::steady_clock::time_point received)
 {
-    m_notification_thread = std::thread(&ReminderApp::notification_loop, this);
+    // Default idle priority runs after GTK's relayout and redraw, so this
+    // measures until the change is on screen and the main loop is free
+    Glib::signal_idle().connect_once([this, client, id, received]()
+                                     {
+        m_ui_latency.record(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - received).count());
+        m_control.reply(client, join_fields({"ok", std::to_string(id)})); });
 }
 
-void ReminderApp::notification_loop()
+void ReminderApp::run_ui_command(int client, const std::vector<std::string> &fields,
+                                 std::chrono::steady_clock::time_point received)
 {
-    while (m_thread_running)
+    const std::string &action = fields[1];
+
+    if (action == "show" && fields.size() == 2)
+        show_window();
+    else if (action == "hide" && fields.size() == 2)
+        hide_window();
+    else if (action == "popup" && fields.size() == 2)
+        show_popup_window();
+    else if (action == "popup-hide" && fields.size() == 2)
+        hide_popup_window();
+    else if (action == "scroll" && fields.size() == 3)
     {
-        // Get current time and date
-        std::string current_time = get_current_time();
-        std::string current_date = get_current_date();
-
-        // Check if date has changed
-        if (current_date != m_current_date)
-        {
-            std::cout << "Date changed from " << m_current_date << " to " << current_date << ", resetting notification status." << std::endl;
-            m_current_date = current_date;
-            reset_notification_status();
-        }
-
-        // Check for reminders that should be triggered
-        for (const auto &reminder : m_reminders)
+        // Fraction of the way down the list
+        double fraction = std::max(0.0, std::min(1.0, std::atof(fields[2].c_str())));
+        auto adjustment = m_scrolled_window.get_vadjustment();
+        double range = adjustment->get_upper() - adjustment->get_page_size() - adjustment->get_lower();
+        adjustment->set_value(adjustment->get_lower() + fraction * std::max(0.0, range));
+    }
+    else if (action == "edit" && fields.size() == 3)
+    {
+        int id = std::atoi(fields[2].c_str());
+        if (!find_reminder(id))
         {
-            if (!reminder.completed && !reminder.notified && should_notify(reminder.time))
-            {
-                show_notification(reminder.title, reminder.description);
-
-                // Mark the reminder as notified to prevent duplicate notifications
-                Reminder updated = reminder;
-                updated.notified = true;
-                update_reminder(updated);
-            }
+            m_control.reply(client, join_fields({"error", "no reminder " + fields[2]}));
+            return;
         }
-
-        // Sleep for just 15 seconds to make checking more frequent
-        std::this_thread::sleep_for(std::chrono::seconds(15));
+        on_edit_button_clicked(id);
     }
-}
-
-void ReminderApp::show_notification(const std::string &title, const std::string &body)
-{
-    if (!notify_is_initted())
+    else if (action == "close-dialog" && fields.size() == 2)
     {
-        notify_init("ReminderApp");
+        m_editing_id = -1;
+        m_edit_dialog.hide();
     }
-
-    NotifyNotification *notification = notify_notification_new(
-        title.c_str(),
-        body.c_str(),
-        "dialog-information");
-
-    notify_notification_set_timeout(notification, NOTIFY_EXPIRES_DEFAULT);
-
-    GError *error = nullptr;
-    if (!notify_notification_show(notification, &error))
+    else if (action == "refresh" && fields.size() == 2)
     {
-        std::cerr << "Failed to show notification: " << (error ? error->message : "unknown error") << std::endl;
-        if (error)
-        {
-            g_error_free(error);
-        }
+        // Every row rebuilt, the worst case
+        clear_rows();
+        refresh_list();
     }
+    else if (action == "refresh-popup" && fields.size() == 2 && m_popup_window)
+        m_popup_window->set_store(&m_store);
+    else if (action == "filter" && fields.size() == 3)
+        m_filter_combo.set_active(std::atoi(fields[2].c_str()));
     else
     {
-        std::cout << "Notification sent: " << title << std::endl;
+        m_control.reply(client, join_fields({"error", "unknown ui action"}));
+        return;
     }
 
-    g_object_unref(G_OBJECT(notification));
+    // As for edits, reply once everything it caused has been drawn
+    Glib::signal_idle().connect_once([this, client, received]()
+                                     {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - received).count();
+        m_ui_latency.record(ms);
+        m_control.reply(client, join_fields({"ok", metric_field("ms", ms)})); });
 }
 
-std::string ReminderApp::get_current_time()
+void ReminderApp::watch_frames(Gtk::Window &window)
 {
-    auto now = std::chrono::system_clock::now();
-    auto now_time = std::chrono::system_clock::to_time_t(now);
-    std::tm *now_tm = std::localtime(&now_time);
+    // The frame clock exists once the window is realized
+    auto connect = [this, &window]()
+    {
+        GdkFrameClock *clock = gdk_window_get_frame_clock(window.get_window()->gobj());
+        if (!clock || m_frame_started.count(clock))
+            return;
 
-    std::stringstream ss;
-    ss << std::setw(2) << std::setfill('0') << now_tm->tm_hour << ":"
-       << std::setw(2) << std::setfill('0') << now_tm->tm_min;
+        m_frame_started[clock] = std::chrono::steady_clock::time_point();
+        g_signal_connect(clock, "before-paint", G_CALLBACK(+[](GdkFrameClock *clock, gpointer user_data)
+                                                           { static_cast<ReminderApp *>(user_data)->on_frame_phase(clock, true); }),
+                         this);
+        g_signal_connect(clock, "after-paint", G_CALLBACK(+[](GdkFrameClock *clock, gpointer user_data)
+                                                          { static_cast<ReminderApp *>(user_data)->on_frame_phase(clock, false); }),
+                         this);
+    };
 
-    return ss.str();
+    if (window.get_realized())
+        connect();
+    else
+        window.signal_realize().connect(connect);
 }
 
-bool ReminderApp::should_notify(const std::string &reminder_time)
+void ReminderApp::on_frame_phase(GdkFrameClock *clock, bool started)
 {
-    std::string current_time = get_current_time();
+    auto now = std::chrono::steady_clock::now();
+    auto it = m_frame_started.find(clock);
+    if (it == m_frame_started.end())
+        return;
+
+    if (started)
+    {
+        it->second = now;
+    }
+    else if (it->second != std::chrono::steady_clock::time_point())
+    {
+        m_frame_time.record(std::chrono::duration<double, std::milli>(now - it->second).count());
+        it->second = std::chrono::steady_clock::time_point();
+    }
+}
 
-    // Get current minutes since midnight
-    int current_hour = std::stoi(current_time.substr(0, 2));
-    int current_minute = std::stoi(current_time.substr(3, 2));
-    int current_total_minutes = current_hour * 60 + current_minute;
+std::string ReminderApp::control_stats()
+{
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_started_at).count();
+
+    std::vector<std::string> fields = {"ok",
+                                       metric_field("uptime_s", std::floor(uptime)),
+                                       metric_field("reminders", m_store.size()),
+                                       metric_field("rows", m_rows.size()),
+                                       metric_field("queued", m_scheduler.size()),
+                                       metric_field("rss_kb", resident_memory_kb()),
+                                       metric_field("ui_count", m_ui_latency.count()),
+                                       metric_field("ui_avg_ms", m_ui_latency.mean()),
+                                       metric_field("ui_p99_ms", m_ui_latency.percentile(99)),
+                                       metric_field("ui_max_ms", m_ui_latency.max()),
+                                       metric_field("fired", m_notification_lateness.count()),
+                                       metric_field("late_avg_ms", m_notification_lateness.mean()),
+                                       metric_field("late_p99_ms", m_notification_lateness.percentile(99)),
+                                       metric_field("late_max_ms", m_notification_lateness.max()),
+                                       metric_field("stalls", m_stall_detector.stalls())};
+
+    // Rendering costs, for the UI benchmark
+    auto add_histogram = [&fields](const std::string &prefix, const LatencyHistogram &histogram)
+    {
+        fields.push_back(metric_field(prefix + "_count", histogram.count()));
+        fields.push_back(metric_field(prefix + "_avg_ms", histogram.mean()));
+        fields.push_back(metric_field(prefix + "_p50_ms", histogram.percentile(50)));
+        fields.push_back(metric_field(prefix + "_p99_ms", histogram.percentile(99)));
+        fields.push_back(metric_field(prefix + "_max_ms", histogram.max()));
+    };
+    add_histogram("refresh", m_refresh_time);
+    if (m_popup_window)
+    {
+        add_histogram("popup_refresh", m_popup_window->refresh_time());
+    }
+    add_histogram("dialog", m_dialog_time);
+    add_histogram("frame", m_frame_time);
 
-    // Get reminder minutes since midnight
-    int reminder_hour = std::stoi(reminder_time.substr(0, 2));
-    int reminder_minute = std::stoi(reminder_time.substr(3, 2));
-    int reminder_total_minutes = reminder_hour * 60 + reminder_minute;
+    for (const auto &queue : m_sinks.queues())
+    {
+        std::string prefix = std::string("sink_") + queue->name();
+        fields.push_back(metric_field(prefix + "_sent", queue->delivered()));
+        fields.push_back(metric_field(prefix + "_dropped", queue->dropped()));
+        fields.push_back(metric_field(prefix + "_failed", queue->failed()));
+    }
 
-    // If the current time is within the last 15 seconds of checking, we should notify
-    // This helps avoid missing notifications due to the 15-second check interval
-    return (current_total_minutes == reminder_total_minutes);
+    return join_fields(fields);
 }
 
-std::string ReminderApp::convert_to_12hour_format(const std::string &time24h)
+void ReminderApp::reset_control_stats()
 {
-    // Parse hour and minute from 24-hour format (HH:MM)
-    int hour = std::stoi(time24h.substr(0, 2));
-    std::string minute = time24h.substr(3, 2);
+    m_ui_latency.reset();
+    m_refresh_time.reset();
+    m_dialog_time.reset();
+    m_frame_time.reset();
+    if (m_popup_window)
+    {
+        m_popup_window->refresh_time().reset();
+    }
+}
 
-    // Convert to 12-hour format
-    std::string period = (hour >= 12) ? "PM" : "AM";
+void ReminderApp::start_watchdog()
+{
+    // The main loop proves it is alive with a heartbeat. The scheduler
+    // thread may sleep for hours, so only its fire callback is timed.
+    Glib::signal_timeout().connect([this]()
+                                   {
+        m_stall_detector.beat(m_main_loop);
+        return true; },
+                                   HEARTBEAT_MS);
+    m_stall_detector.start();
+
+    sd_notify_state("READY=1");
+}
 
-    // Convert hour from 24-hour to 12-hour format
-    if (hour > 12)
+void ReminderApp::start_sinks()
+{
+    if (m_db)
     {
-        hour -= 12;
+        m_sinks.add_sink(std::unique_ptr<NotificationSink>(new DeliveryHistorySink(m_db_path)));
     }
-    else if (hour == 0)
+
+    std::string log_file = get_setting_text("notify_log_file", "");
+    if (!log_file.empty())
     {
-        hour = 12;
+        m_sinks.add_sink(std::unique_ptr<NotificationSink>(new LogFileSink(log_file)));
     }
 
-    // Format the time string
-    std::stringstream ss;
-    ss << std::setw(2) << std::setfill('0') << hour << ":"
-       << minute << " " << period;
+    if (get_setting_int("notify_journal", 0))
+    {
+        m_sinks.add_sink(std::unique_ptr<NotificationSink>(new JournalSink()));
+    }
 
-    return ss.str();
+    std::string webhook_url = get_setting_text("notify_webhook_url", "");
+    if (!webhook_url.empty())
+    {
+        std::unique_ptr<WebhookSink> webhook(new WebhookSink(webhook_url));
+        if (webhook->valid())
+        {
+            m_sinks.add_sink(std::move(webhook));
+        }
+        else
+        {
+            std::cerr << "Ignoring notify_webhook_url, only http:// URLs are supported: " << webhook_url << std::endl;
+        }
+    }
 }
 
 void ReminderApp::show_window()
@@ -961,8 +2605,7 @@ void ReminderApp::show_window_and_focus_title()
 
 void ReminderApp::show_popup_window()
 {
-    // Update the reminders in the popup window
-    m_popup_window->set_reminders(m_reminders);
+    // The popup keeps its rows up to date, so it can be shown as is
     m_popup_window->show();
 }
 
@@ -999,6 +2642,28 @@ void ReminderApp::create_tray_icon()
         // Create the menu for the indicator
         GtkWidget *menu = gtk_menu_new();
 
+        // Next up: fixed slots that update_tray() relabels, shows and hides.
+        // Activating one opens the reminder in the edit dialog.
+        m_tray_empty_item = gtk_menu_item_new_with_label("Nothing coming up");
+        gtk_widget_set_sensitive(m_tray_empty_item, FALSE);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), m_tray_empty_item);
+        for (size_t i = 0; i < TRAY_NEXT_UP; i++)
+        {
+            GtkWidget *item = gtk_menu_item_new_with_label("");
+            g_signal_connect(item, "activate", G_CALLBACK(+[](GtkMenuItem *item, gpointer user_data)
+                                                          {
+                                                              auto app = static_cast<ReminderApp *>(user_data);
+                                                              app->show_window();
+                                                              app->on_edit_button_clicked(GPOINTER_TO_INT(g_object_get_data(G_OBJECT(item), "reminder_id")));
+                                                          }),
+                             this);
+            gtk_widget_set_no_show_all(item, TRUE);
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+            m_tray_items.push_back(item);
+            m_tray_item_labels.push_back(std::string());
+        }
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_separator_menu_item_new());
+
         // Create "Show" menu item
         GtkWidget *show_item = gtk_menu_item_new_with_label("Show Reminders");
         g_signal_connect(show_item, "activate", G_CALLBACK(+[](GtkMenuItem *, gpointer user_data)
@@ -1039,6 +2704,8 @@ void ReminderApp::create_tray_icon()
 
         // Set the menu for the indicator
         app_indicator_set_menu(indicator, GTK_MENU(menu));
+        m_indicator = indicator;
+        schedule_tray_update();
     }
     catch (const std::exception &e)
     {
@@ -1053,6 +2720,87 @@ void ReminderApp::create_tray_icon()
     }
 }
 
+void ReminderApp::schedule_tray_update()
+{
+    // Many changes in one main loop iteration, e.g. a bulk action or a
+    // full load, end in a single update
+    if (!m_indicator || m_tray_update_pending)
+        return;
+
+    m_tray_update_pending = true;
+    Glib::signal_idle().connect_once(sigc::mem_fun(*this, &ReminderApp::update_tray));
+}
+
+void ReminderApp::update_tray()
+{
+    m_tray_update_pending = false;
+    if (!m_indicator)
+        return;
+
+    std::string label = m_store.fired_count() > 0 ? std::to_string(m_store.fired_count()) : "";
+    if (label != m_tray_label)
+    {
+        app_indicator_set_label(m_indicator, label.c_str(), "999");
+        m_tray_label = label;
+    }
+
+    // The next reminders in fire order, each once. A reminder has at most
+    // three deadlines, so three times the slots is always enough.
+    std::vector<std::pair<int, std::string>> next;
+    std::unordered_set<int> seen;
+    std::tm today_tm = m_clock.local_time(m_clock.now());
+    for (const auto &deadline : m_scheduler.upcoming(TRAY_NEXT_UP * 3))
+    {
+        if (next.size() == TRAY_NEXT_UP)
+            break;
+        if (deadline.kind == DeadlineKind::Escalation || !seen.insert(deadline.reminder_id).second)
+            continue;
+
+        const Reminder *reminder = find_reminder(deadline.reminder_id);
+        if (!reminder)
+            continue;
+
+        // The reminder's own time, as in the list views; a snooze shows
+        // when it fires, seconds included
+        std::tm when_tm = m_clock.local_time(deadline.when);
+        std::string time = deadline.kind == DeadlineKind::Snooze
+                               ? format_reminder_time(when_tm.tm_hour, when_tm.tm_min, when_tm.tm_sec)
+                               : reminder->time;
+        std::string text = convert_to_12hour_format(time) + "  " + reminder->title;
+        if (deadline.kind == DeadlineKind::Snooze)
+            text += " (snoozed)";
+        else if (when_tm.tm_yday != today_tm.tm_yday)
+            text += " (tomorrow)";
+        next.emplace_back(reminder->id, text);
+    }
+
+    // Relabel, show or hide only the slots that differ
+    for (size_t i = 0; i < m_tray_items.size(); i++)
+    {
+        GtkWidget *item = m_tray_items[i];
+        if (i < next.size())
+        {
+            g_object_set_data(G_OBJECT(item), "reminder_id", GINT_TO_POINTER(next[i].first));
+            if (m_tray_item_labels[i] != next[i].second)
+            {
+                gtk_menu_item_set_label(GTK_MENU_ITEM(item), next[i].second.c_str());
+                m_tray_item_labels[i] = next[i].second;
+            }
+            if (!gtk_widget_get_visible(item))
+                gtk_widget_show(item);
+        }
+        else if (gtk_widget_get_visible(item))
+        {
+            gtk_widget_hide(item);
+        }
+    }
+
+    if (gtk_widget_get_visible(m_tray_empty_item) != next.empty())
+    {
+        gtk_widget_set_visible(m_tray_empty_item, next.empty());
+    }
+}
+
 void ReminderApp::on_tray_icon_activate()
 {
     if (m_window.is_visible())
@@ -1075,55 +2823,363 @@ bool ReminderApp::on_window_delete_event(GdkEventAny *event)
     return true;
 }
 
-std::string ReminderApp::get_current_date()
-{
-    auto now = std::chrono::system_clock::now();
-    auto now_time = std::chrono::system_clock::to_time_t(now);
-    std::tm *now_tm = std::localtime(&now_time);
-
-    std::stringstream ss;
-    ss << (now_tm->tm_year + 1900) << "-"
-       << std::setw(2) << std::setfill('0') << (now_tm->tm_mon + 1) << "-"
-       << std::setw(2) << std::setfill('0') << now_tm->tm_mday;
-
-    return ss.str();
-}
-
 void ReminderApp::reset_notification_status()
 {
     if (!m_db)
         return;
 
-    const char *sql = "UPDATE reminders SET notified = 0;";
-    char *err_msg = nullptr;
-    int rc = sqlite3_exec(m_db, sql, nullptr, nullptr, &err_msg);
+    StallScope scope(m_stall_detector, m_main_loop, "reset_notification_status");
 
-    if (rc != SQLITE_OK)
+    // Part of the daily reset: move old completed reminders out of the way.
+    // The history shown no longer matches the archive if that moved
+    // anything, so it starts over from the newest.
+    if (archive_completed(m_db) > 0)
     {
-        std::cerr << "SQL error when resetting notification status: " << err_msg << std::endl;
-        sqlite3_free(err_msg);
+        reset_history();
+        if (m_history_expander.get_expanded())
+        {
+            load_history_page();
+        }
     }
-    else
+    purge_delivery_history(m_db);
+
+    if (m_storage.reset_notified())
     {
         std::cout << "Notification status reset for a new day." << std::endl;
     }
 
     // Reload reminders to update local data
     load_reminders();
+
+    // The reload covered every delete so far
+    purge_tombstones(m_db, m_sync_version);
+
+    // Subscribed events of the new day replace yesterday's
+    sync_subscriptions();
 }
 
 void ReminderApp::on_popup_reminder_toggled(int reminder_id, bool is_completed)
 {
     // Find the reminder with the given ID
-    auto it = std::find_if(m_reminders.begin(), m_reminders.end(),
-                           [reminder_id](const Reminder &r)
-                           { return r.id == reminder_id; });
+    const Reminder *it = find_reminder(reminder_id);
 
-    if (it == m_reminders.end())
+    if (!it)
         return;
 
-    // Update the reminder's completed status
+    // Update the reminder's completed status once the popup's toggle
+    // handler has returned, since the update replaces the toggled row
     Reminder updated = *it;
     updated.completed = is_completed;
-    update_reminder(updated);
+    Glib::signal_idle().connect_once([this, updated]()
+                                     { update_reminder(updated); });
+}
+
+int ReminderApp::get_setting_int(const std::string &key, int default_value)
+{
+    return m_db ? read_setting_int(m_db, key, default_value) : default_value;
+}
+
+std::string ReminderApp::get_setting_text(const std::string &key, const std::string &default_value)
+{
+    return m_db ? read_setting_text(m_db, key, default_value) : default_value;
+}
+
+// Returns how many rows the pass moved or purged. Runs on the main loop for
+// the daily reset and on the open thread at startup, so only db is used.
+int ReminderApp::archive_completed(sqlite3 *db)
+{
+    // Cutoffs are in seconds since the epoch, like completed_at
+    sqlite3_int64 now = std::chrono::duration_cast<std::chrono::seconds>(
+                            m_clock.now().time_since_epoch())
+                            .count();
+    int archive_after_days = read_setting_int(db, "archive_after_days", 1);
+    int retention_days = read_setting_int(db, "archive_retention_days", 365);
+
+    // Count full days from local midnight, so "1" means "completed before today"
+    auto midnight = next_midnight(m_clock) - std::chrono::hours(24);
+    sqlite3_int64 archive_cutoff = std::chrono::duration_cast<std::chrono::seconds>(
+                                       midnight.time_since_epoch())
+                                       .count() -
+                                   static_cast<sqlite3_int64>(std::max(archive_after_days - 1, 0)) * 86400;
+
+    const char *archive_sql =
+        "INSERT OR REPLACE INTO reminders_archive "
+        "(id, title, description, time, priority, tags, completed_at, archived_at) "
+        "SELECT r.id, r.title, r.description, r.time, r.priority, "
+        "(SELECT group_concat(name, ', ') FROM (SELECT t.name FROM reminder_tags rt "
+        "JOIN tags t ON t.id = rt.tag_id WHERE rt.reminder_id = r.id ORDER BY t.name)), "
+        "r.completed_at, ?2 "
+        "FROM reminders r WHERE r.completed = 1 AND r.completed_at < ?1;";
+    const char *delete_sql = "DELETE FROM reminders WHERE completed = 1 AND completed_at < ?1;";
+    const char *purge_sql = "DELETE FROM reminders_archive WHERE completed_at < ?1;";
+
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+
+    bool ok = true;
+    int archived = 0;
+    for (const char *sql : {archive_sql, delete_sql})
+    {
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+            ok = false;
+            break;
+        }
+
+        sqlite3_bind_int64(stmt, 1, archive_cutoff);
+        if (sqlite3_bind_parameter_count(stmt) > 1)
+        {
+            sqlite3_bind_int64(stmt, 2, now);
+        }
+
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            std::cerr << "Failed to archive reminders: " << sqlite3_errmsg(db) << std::endl;
+            ok = false;
+        }
+        archived = sqlite3_changes(db);
+        sqlite3_finalize(stmt);
+
+        if (!ok)
+            break;
+    }
+
+    // Retention for the archive itself; 0 keeps history forever
+    int purged = 0;
+    if (ok && retention_days > 0)
+    {
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, purge_sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_int64(stmt, 1, now - static_cast<sqlite3_int64>(retention_days) * 86400);
+            if (sqlite3_step(stmt) == SQLITE_DONE)
+            {
+                purged = sqlite3_changes(db);
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+
+    if (ok && archived > 0)
+    {
+        std::cout << "Archived " << archived << " completed reminders." << std::endl;
+    }
+
+    return ok ? archived + purged : 0;
+}
+
+void ReminderApp::purge_delivery_history(sqlite3 *db)
+{
+    // 0 keeps the delivery history forever
+    int retention_days = read_setting_int(db, "history_retention_days", 90);
+    if (retention_days <= 0)
+        return;
+
+    std::time_t cutoff = std::chrono::system_clock::to_time_t(
+        m_clock.now() - std::chrono::hours(24) * retention_days);
+    char day[16];
+    std::strftime(day, sizeof(day), "%Y-%m-%d", std::localtime(&cutoff));
+
+    int purged = purge_deliveries(db, day);
+    if (purged > 0)
+    {
+        std::cout << "Purged " << purged << " deliveries older than " << retention_days << " days." << std::endl;
+    }
+}
+
+void ReminderApp::purge_tombstones(sqlite3 *db, sqlite3_int64 applied_version)
+{
+    // Tombstones are only read by this app, to pick up deletes made by
+    // other processes. Those up to applied_version have been applied, and
+    // a restart loads everything, so nothing needs them any more.
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "DELETE FROM reminder_tombstones WHERE row_version <= ?;", -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+        return;
+    }
+
+    sqlite3_bind_int64(stmt, 1, applied_version);
+    int purged = sqlite3_step(stmt) == SQLITE_DONE ? sqlite3_changes(db) : 0;
+    sqlite3_finalize(stmt);
+
+    if (purged > 0)
+    {
+        std::cout << "Purged " << purged << " deletion tombstones." << std::endl;
+    }
+}
+
+bool ReminderApp::on_backup_timer()
+{
+    if (!m_db || m_backup.running())
+        return true;
+
+    BackupOptions options = load_backup_options(m_db_path);
+    if (options.interval_hours <= 0)
+        return true;
+
+    // Due when the newest snapshot is older than the interval
+    std::vector<std::string> snapshots = list_backups(options.dir);
+    struct stat info;
+    if (!snapshots.empty() && stat(snapshots.back().c_str(), &info) == 0 &&
+        std::time(nullptr) - info.st_mtime < static_cast<std::time_t>(options.interval_hours) * 3600)
+    {
+        return true;
+    }
+
+    // The copy runs in small slices on its own thread and connection
+    m_backup.start(options);
+    return true;
+}
+
+bool ReminderApp::maintenance_idle()
+{
+    if (!m_db || m_backup.running() || !sqlite3_get_autocommit(m_db))
+        return false;
+
+    // Someone looking at a window may act at any moment
+    if (m_window.is_visible() || m_edit_dialog.is_visible() ||
+        (m_popup_window && m_popup_window->get_window().is_visible()))
+        return false;
+
+    return get_setting_int("maintenance_on_battery", 0) || on_ac_power();
+}
+
+bool ReminderApp::on_maintenance_timer()
+{
+    if (!m_db || m_maintenance.running())
+        return true;
+
+    int interval_hours = get_setting_int("maintenance_interval_hours", 24);
+    if (interval_hours <= 0)
+        return true;
+
+    // Quiet since the last check: nothing written here or by others
+    sqlite3_int64 changes = sqlite3_total_changes64(m_db);
+    int data_version = query_data_version();
+    bool quiet = changes == m_maintenance_changes && data_version == m_maintenance_data_version;
+    m_maintenance_changes = changes;
+    m_maintenance_data_version = data_version;
+
+    if (!quiet || !maintenance_idle())
+        return true;
+
+    auto now = std::chrono::steady_clock::now();
+    if (m_maintained && now - m_last_maintenance < std::chrono::hours(interval_hours))
+        return true;
+
+    m_maintenance.start(m_db);
+    Glib::signal_timeout().connect(sigc::mem_fun(*this, &ReminderApp::on_maintenance_slice), MAINTENANCE_SLICE_GAP_MS);
+    return true;
+}
+
+bool ReminderApp::on_maintenance_slice()
+{
+    // Give up as soon as the app is in use; the next quiet check starts over
+    if (!maintenance_idle())
+    {
+        m_maintenance.cancel();
+        return false;
+    }
+
+    if (m_maintenance.step())
+        return true;
+
+    m_maintained = true;
+    m_last_maintenance = std::chrono::steady_clock::now();
+    m_maintenance_changes = sqlite3_total_changes64(m_db);
+    std::cout << "Database maintenance: freed " << m_maintenance.freed_pages() << " pages in "
+              << m_maintenance.slices() << " slices, longest " << m_maintenance.longest_slice_ms() << " ms." << std::endl;
+    return false;
+}
+
+void ReminderApp::on_history_expanded()
+{
+    // History is only read when someone looks at it, and read afresh each
+    // time, since reminders may have been archived while it was closed
+    if (m_history_expander.get_expanded())
+    {
+        reset_history();
+        load_history_page();
+    }
+}
+
+void ReminderApp::reset_history()
+{
+    for (auto child : m_history_list.get_children())
+    {
+        m_history_list.remove(*child);
+    }
+    m_history_cursor_completed_at = std::numeric_limits<sqlite3_int64>::max();
+    m_history_cursor_id = std::numeric_limits<int>::max();
+    m_history_rows = 0;
+    m_history_more_button.set_label("Load more");
+    m_history_more_button.set_sensitive(true);
+}
+
+void ReminderApp::load_history_page()
+{
+    if (!m_db)
+        return;
+
+    // Keyset pagination: continue after the last row shown, newest first
+    const char *sql = "SELECT id, title, time, tags, completed_at FROM reminders_archive "
+                      "WHERE (completed_at, id) < (?, ?) "
+                      "ORDER BY completed_at DESC, id DESC LIMIT ?;";
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
+        return;
+    }
+
+    sqlite3_bind_int64(stmt, 1, m_history_cursor_completed_at);
+    sqlite3_bind_int(stmt, 2, m_history_cursor_id);
+    sqlite3_bind_int(stmt, 3, HISTORY_PAGE_SIZE);
+
+    int loaded = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::string title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        std::string time = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+        const unsigned char *tags = sqlite3_column_text(stmt, 3);
+        std::time_t completed_at = static_cast<std::time_t>(sqlite3_column_int64(stmt, 4));
+
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%d", std::localtime(&completed_at));
+
+        std::string markup = "<s>" + Glib::Markup::escape_text(title) + "</s>  <small>" +
+                             convert_to_12hour_format(time) + " · completed " + date;
+        if (tags)
+        {
+            markup += " · " + Glib::Markup::escape_text(reinterpret_cast<const char *>(tags));
+        }
+        markup += "</small>";
+
+        auto label = Gtk::manage(new Gtk::Label());
+        label->set_markup(markup);
+        label->set_halign(Gtk::ALIGN_START);
+        label->set_ellipsize(Pango::ELLIPSIZE_END);
+        m_history_list.add(*label);
+
+        m_history_cursor_completed_at = sqlite3_column_int64(stmt, 4);
+        m_history_cursor_id = sqlite3_column_int(stmt, 0);
+        loaded++;
+    }
+
+    sqlite3_finalize(stmt);
+
+    m_history_rows += loaded;
+    m_history_list.show_all();
+
+    // A short page means we reached the oldest entry
+    m_history_more_button.set_sensitive(loaded == HISTORY_PAGE_SIZE);
+    if (m_history_rows == 0)
+    {
+        m_history_more_button.set_label("No archived reminders");
+    }
 }
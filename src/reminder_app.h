@@ -4,29 +4,38 @@
 #include <gtkmm.h>
 #include <sqlite3.h>
 #include <libnotify/notify.h>
+#include <functional>
+#include <mutex>
 #include <thread>
-#include <atomic>
 #include <vector>
 #include <string>
 #include <chrono>
+#include <set>
+#include <unordered_map>
+#include "reminder.h"
+#include "reminder_store.h"
+#include "reminder_editor.h"
+#include "sqlite_storage.h"
+#include "scheduler.h"
+#include "clock.h"
+#include "control_channel.h"
+#include "metrics.h"
+#include "notification_sink.h"
+#include "database_backup.h"
+#include "database_maintenance.h"
+#include "watchdog.h"
+#include "reminder_snapshot.h"
+#include "undo_journal.h"
+#include "ics_subscriptions.h"
 
 // Forward declarations
 class ReminderPopupWindow;
-
-struct Reminder
-{
-    int id;
-    std::string title;
-    std::string description;
-    std::string time; // Format: "HH:MM"
-    bool completed;
-    bool notified; // Whether notification has been sent for this reminder today
-};
+typedef struct _AppIndicator AppIndicator;
 
 class ReminderApp
 {
 public:
-    ReminderApp(bool start_minimized = false);
+    ReminderApp(bool start_minimized = false, Clock &clock = system_clock());
     virtual ~ReminderApp();
     Gtk::Window &get_window();
 
@@ -42,6 +51,8 @@ public:
     // For system tray functionality
     void create_tray_icon();
     void on_tray_icon_activate();
+    void schedule_tray_update();
+    void update_tray();
     bool on_window_delete_event(GdkEventAny *event);
 
 private:
@@ -61,53 +72,312 @@ private:
     Gtk::Menu m_popup_menu;
     bool m_start_minimized;
 
+    // Tray menu slots for the next TRAY_NEXT_UP reminders, and the number
+    // of fired, unfinished ones in the indicator label. Both are patched
+    // after changes and scheduler events, touching only what differs.
+    static const size_t TRAY_NEXT_UP = 5;
+    AppIndicator *m_indicator;
+    std::vector<GtkWidget *> m_tray_items;
+    std::vector<std::string> m_tray_item_labels;
+    GtkWidget *m_tray_empty_item; // Shown when nothing is coming up
+    std::string m_tray_label;
+    bool m_tray_update_pending;
+
     // Input fields
     Gtk::Entry m_title_entry;
     Gtk::TextView m_description_textview;
     Gtk::ComboBoxText m_hour_combo;
     Gtk::ComboBoxText m_minute_combo;
+    Gtk::ComboBoxText m_second_combo;
     Gtk::ComboBoxText m_ampm_combo;
     Gtk::Label m_time_separator;
+    Gtk::Label m_seconds_separator;
     Gtk::Box m_time_box;
+    Gtk::ComboBoxText m_priority_combo;
+    Gtk::ComboBoxText m_escalation_combo;
+    Gtk::Entry m_tags_entry;
     Gtk::Button m_add_button;
+    Gtk::Label m_add_error_label;
     Gtk::Frame m_input_frame;
 
+    // Edit dialog, built once and reused
+    Gtk::Dialog m_edit_dialog;
+    ReminderEditor m_editor;
+    int m_editing_id; // Reminder shown in the edit dialog, -1 when closed
+
+    // Actions on the rows selected in the list
+    Gtk::Box m_bulk_box;
+    Gtk::Label m_selection_label;
+    Gtk::Button m_bulk_complete_button;
+    Gtk::Button m_bulk_uncomplete_button;
+    Gtk::SpinButton m_bulk_shift_spin; // Minutes, may be negative
+    Gtk::Button m_bulk_shift_button;
+    Gtk::Entry m_bulk_time_entry;
+    Gtk::Button m_bulk_time_button;
+    Gtk::Button m_bulk_delete_button;
+
+    // Undo and redo of the last UNDO_DEPTH actions. Deletes are not
+    // confirmed; the undo bar offers to take them back instead.
+    static const size_t UNDO_DEPTH = 100;
+    static const int UNDO_BAR_SECONDS = 10;
+    UndoJournal m_journal;
+    Gtk::Button m_undo_button;
+    Gtk::Button m_redo_button;
+    Gtk::InfoBar m_undo_bar;
+    Gtk::Label m_undo_label;
+    sigc::connection m_undo_bar_timer;
+
+    // View filter for the reminders list
+    Gtk::Box m_filter_box;
+    Gtk::ComboBoxText m_filter_combo;
+    Gtk::ComboBoxText m_tag_filter_combo;
+    ReminderFilter m_filter;
+    std::vector<std::string> m_known_tags; // Tags offered in the tag filter
+
     // Database
     sqlite3 *m_db;
+    std::string m_db_path;
+    SqliteStorage m_storage; // Reminder reads and writes, on m_db
+
+    // External change detection
+    std::vector<Glib::RefPtr<Gio::FileMonitor>> m_db_monitors;
+    int m_data_version;           // Last seen PRAGMA data_version
+    sqlite3_int64 m_sync_version; // Highest row_version already applied
 
-    // Threading for notification checks
-    std::thread m_notification_thread;
-    std::atomic<bool> m_thread_running;
+    // Reminders kept in step with the .ics files and directories in the
+    // ics_subscriptions setting. A changed file is re-read FEED_SETTLE_MS
+    // after its last change event, so a save in several writes is read once.
+    static const int FEED_SETTLE_MS = 500;
+    IcsSubscriptions m_subscriptions;
+    std::vector<std::string> m_subscription_paths;
+    std::vector<Glib::RefPtr<Gio::FileMonitor>> m_subscription_monitors;
+    std::set<std::string> m_changed_feeds;
+    sigc::connection m_feed_timer;
+
+    // Archived reminders, shown a page at a time
+    static const int HISTORY_PAGE_SIZE = 50;
+    Gtk::Expander m_history_expander;
+    Gtk::ScrolledWindow m_history_scroll;
+    Gtk::ListBox m_history_list;
+    Gtk::Button m_history_more_button;
+    sqlite3_int64 m_history_cursor_completed_at; // Position after the last row shown
+    int m_history_cursor_id;
+    int m_history_rows;
+
+    // List rows keyed by reminder ID, so single rows can be patched in place
+    std::unordered_map<int, Gtk::ListBoxRow *> m_rows;
+
+    // Deadline scheduling. The scheduler thread hands fired deadlines to the
+    // main loop through the dispatcher. All time comes from m_clock.
+    Clock &m_clock;
+    Scheduler m_scheduler;
+    Glib::Dispatcher m_fire_dispatcher;
+    std::mutex m_fired_mutex;
+    std::vector<Deadline> m_fired;
     std::string m_current_date; // Track the current date for notification reset
 
-    // Vector to store reminders
-    std::vector<Reminder> m_reminders;
+    // Notifications still on screen, kept alive so their actions can be invoked
+    std::unordered_map<int, NotifyNotification *> m_notifications;
+
+    // Repeat notices shown since each escalating reminder last fired
+    std::unordered_map<int, int> m_escalation_notices;
+
+    // In-memory reminders with indexes for the filtered views
+    ReminderStore m_store;
+
+    // Local control channel, and the numbers its stats command reports
+    ControlServer m_control;
+    LatencyHistogram m_ui_latency;            // Command received until the main loop is idle again
+    LatencyHistogram m_notification_lateness; // Deadline until the notification is shown
+    LatencyHistogram m_refresh_time;          // Time spent in refresh_list
+    LatencyHistogram m_dialog_time;           // Edit dialog opened until the main loop is idle
+    LatencyHistogram m_frame_time;            // Frame clock before-paint to after-paint, any window
+    std::unordered_map<GdkFrameClock *, std::chrono::steady_clock::time_point> m_frame_started;
+    std::chrono::steady_clock::time_point m_started_at;
+
+    // Delivery history, log file, journal and webhook outputs, each with its own queue
+    NotificationDispatcher m_sinks;
+
+    // Online backups, checked every BACKUP_CHECK_SECONDS
+    static const int BACKUP_CHECK_SECONDS = 15 * 60;
+    BackupWorker m_backup;
+
+    // Idle maintenance, checked every MAINTENANCE_CHECK_SECONDS. A pass
+    // starts at most every maintenance_interval_hours, after a check
+    // interval without writes, and runs one slice every
+    // MAINTENANCE_SLICE_GAP_MS so other writers get their turn.
+    static const int MAINTENANCE_CHECK_SECONDS = 5 * 60;
+    static const int MAINTENANCE_SLICE_GAP_MS = 50;
+    DatabaseMaintenance m_maintenance;
+    bool m_maintained; // A pass has finished since startup
+    std::chrono::steady_clock::time_point m_last_maintenance;
+    sqlite3_int64 m_maintenance_changes; // Write counters seen at the last check
+    int m_maintenance_data_version;
+
+    // Startup snapshot of the active reminders, rewritten SNAPSHOT_DELAY_SECONDS
+    // after the last change so bursts of edits cost one write
+    static const int SNAPSHOT_DELAY_SECONDS = 2;
+    std::string m_snapshot_path;
+    sqlite3_int64 m_snapshot_version; // Of the snapshot armed at startup, -1 if none
+    bool m_snapshot_dirty;
+    sigc::connection m_snapshot_timer;
+
+    // The database is opened, upgraded, archived and read into a store on
+    // m_open_thread while the snapshot's deadlines keep the app going. The
+    // thread leaves its results in m_opened and the main loop takes them
+    // over in one go when m_opened_dispatcher fires; until then m_db stays
+    // null, so nothing on the main loop touches the connection.
+    struct OpenedDatabase
+    {
+        sqlite3 *db = nullptr;
+        ReminderStore store;
+        sqlite3_int64 sync_version = 0;
+        int data_version = 0;
+        std::chrono::steady_clock::time_point started;
+    };
+    std::thread m_open_thread;
+    Glib::Dispatcher m_opened_dispatcher;
+    OpenedDatabase m_opened;
+
+    // Stall detection for the main loop and the scheduler thread, which
+    // also drives the systemd watchdog
+    static const int HEARTBEAT_MS = 1000;
+    static const int MAIN_LOOP_BUDGET_MS = 500;
+    static const int SCHEDULER_BUDGET_MS = 200;
+    StallDetector m_stall_detector;
+    int m_main_loop;
+    int m_scheduler_loop;
 
     // Signal handlers
     void on_add_button_clicked();
     void on_reminder_clicked(int id);
     void on_edit_button_clicked(int id);
     void on_delete_button_clicked(int id);
+    void on_edit_response(int response);
+    void show_add_error(const std::string &message);
+    void clear_add_error();
     void on_popup_reminder_toggled(int reminder_id, bool is_completed);
 
+    // Bulk actions on the selected rows
+    std::vector<int> selected_ids();
+    void on_selection_changed();
+    void on_bulk_set_completed(bool completed);
+    void on_bulk_shift();
+    void on_bulk_reschedule();
+    void on_bulk_delete();
+
+    // Undo and redo
+    void record_change(JournalEntry entry);
+    bool journal_entry_applies(const JournalEntry &entry, bool undoing);
+    bool apply_journal_entry(const JournalEntry &entry, bool undoing);
+    void undo();
+    void redo();
+    void update_undo_controls();
+    void show_undo_bar(const std::string &message);
+    void hide_undo_bar();
+    bool on_window_key_press(GdkEventKey *event);
+
     // Helper methods
     void setup_ui();
+    void setup_edit_dialogs();
     void connect_signals();
-    void initialize_database();
+    sqlite3 *prepare_database();
     void load_reminders();
-    void add_reminder(const Reminder &reminder);
+    bool read_reminders(sqlite3 *db, ReminderStore &store, sqlite3_int64 &sync_version);
+    void install_reminders(ReminderStore store, sqlite3_int64 sync_version);
+    int add_reminder(const Reminder &reminder);
     void update_reminder(const Reminder &reminder);
     void delete_reminder(int id);
+
+    // Write several reminders in one transaction, then patch the views;
+    // nothing changes if any write fails
+    bool update_reminders(const std::vector<Reminder> &reminders);
+    bool delete_reminders(const std::vector<int> &ids);
+    void set_reminder_flag(ReminderFlag flag, int id, bool value);
+    const Reminder *find_reminder(int id);
     void refresh_list();
+    void clear_rows();
+    void append_row(const Reminder &reminder);
+    void remove_row(int id);
+    void on_filter_changed();
+    void update_tag_filter_options();
+
+    // Incremental updates of the in-memory list and both views
+    void apply_reminder_change(const Reminder &reminder);
+    void apply_reminder_removal(int id);
+
+    // External change detection
+    void watch_database_files(const std::string &db_path);
+    void on_database_file_changed(const Glib::RefPtr<Gio::File> &file,
+                                  const Glib::RefPtr<Gio::File> &other_file,
+                                  Gio::FileMonitorEvent event_type);
+    int query_data_version();
+    sqlite3_int64 query_sync_version();
+    void skip_own_changes();
+    void check_external_changes();
+    void sync_external_changes();
+
+    // Calendar subscriptions
+    void start_subscriptions();
+    void sync_subscriptions();
+    void sync_subscription_files(const std::function<const Reminder *(int)> &current, FeedChanges &changes);
+    void on_subscription_changed(const Glib::RefPtr<Gio::File> &file,
+                                 const Glib::RefPtr<Gio::File> &other_file,
+                                 Gio::FileMonitorEvent event_type);
+    bool on_feed_timer();
+    void apply_feed_changes(const FeedChanges &changes);
     Gtk::Widget *create_reminder_widget(const Reminder &reminder); // Notification related
-    void start_notification_thread();
-    void notification_loop();
-    void show_notification(const std::string &title, const std::string &body);
-    std::string get_current_time();
-    std::string get_current_date();
-    bool should_notify(const std::string &reminder_time);
+    void start_scheduler();
+    void arm_reminder(const Reminder &reminder);
+    void on_deadlines_fired();
+    void show_notification(const Reminder &reminder, int notice = 0);
+    void on_notification_action(int reminder_id, const std::string &action);
+    void on_notification_closed(NotifyNotification *notification);
     void reset_notification_status();
 
-    // Time format conversion
-    std::string convert_to_12hour_format(const std::string &time24h);
+    // Control channel
+    void start_control_channel();
+    bool on_control_connection(Glib::IOCondition condition);
+    bool on_control_client_io(Glib::IOCondition condition, int client);
+    void on_control_command(int client, const std::vector<std::string> &fields);
+    void reply_after_update(int client, int id, std::chrono::steady_clock::time_point received);
+    void run_ui_command(int client, const std::vector<std::string> &fields, std::chrono::steady_clock::time_point received);
+    std::string control_stats();
+    void reset_control_stats();
+
+    // Frame timing of a window, recorded in m_frame_time
+    void watch_frames(Gtk::Window &window);
+    void on_frame_phase(GdkFrameClock *clock, bool started);
+
+    // Notification sinks configured in the settings table
+    void start_sinks();
+
+    // Stall detection and systemd notification
+    void start_watchdog();
+
+    // Fast start: arm from the snapshot, then load the database on a
+    // worker thread and hand it to the main loop
+    void arm_from_snapshot();
+    void open_database();
+    void load_database();
+    void on_database_opened();
+    void schedule_snapshot();
+    bool on_snapshot_timer();
+    void write_snapshot();
+
+    // Settings stored in the database
+    int get_setting_int(const std::string &key, int default_value);
+    std::string get_setting_text(const std::string &key, const std::string &default_value);
+
+    // Archive and history
+    int archive_completed(sqlite3 *db);
+    void purge_delivery_history(sqlite3 *db);
+    void purge_tombstones(sqlite3 *db, sqlite3_int64 applied_version);
+    bool on_backup_timer();
+    bool maintenance_idle();
+    bool on_maintenance_timer();
+    bool on_maintenance_slice();
+    void on_history_expanded();
+    void reset_history();
+    void load_history_page();
 };
@@ -0,0 +1,248 @@
+#include "reminder_editor.h"
+#include "time_utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+static std::string two_digits(int value)
+{
+    std::stringstream ss;
+    ss << std::setw(2) << std::setfill('0') << value;
+    return ss.str();
+}
+
+ReminderEditor::ReminderEditor() : m_title_label("Title:"),
+                                   m_time_label("Time:"),
+                                   m_time_box(Gtk::ORIENTATION_HORIZONTAL, 5),
+                                   m_description_label("Description:"),
+                                   m_priority_label("Priority:"),
+                                   m_tags_label("Tags:"),
+                                   m_completed_check("Completed")
+{
+    set_row_spacing(10);
+    set_column_spacing(10);
+
+    // Title row
+    m_title_entry.set_hexpand(true);
+    m_title_entry.set_activates_default(true);
+    m_title_entry.signal_changed().connect(sigc::mem_fun(*this, &ReminderEditor::clear_error));
+    attach(m_title_label, 0, 0, 1, 1);
+    attach(m_title_entry, 1, 0, 2, 1);
+
+    // Time row, in 12-hour format
+    for (int i = 1; i <= 12; i++)
+    {
+        m_hour_combo.append(two_digits(i));
+    }
+    for (int i = 0; i < 60; i++)
+    {
+        m_minute_combo.append(two_digits(i));
+        m_second_combo.append(two_digits(i));
+    }
+    m_ampm_combo.append("AM");
+    m_ampm_combo.append("PM");
+
+    m_time_separator.set_text(":");
+    m_seconds_separator.set_text(":");
+
+    // Set fixed width for combo boxes
+    m_hour_combo.property_width_request() = 60;
+    m_minute_combo.property_width_request() = 60;
+    m_second_combo.property_width_request() = 60;
+    m_ampm_combo.property_width_request() = 60;
+
+    m_time_box.pack_start(m_hour_combo, Gtk::PACK_SHRINK);
+    m_time_box.pack_start(m_time_separator, Gtk::PACK_SHRINK);
+    m_time_box.pack_start(m_minute_combo, Gtk::PACK_SHRINK);
+    m_time_box.pack_start(m_seconds_separator, Gtk::PACK_SHRINK);
+    m_time_box.pack_start(m_second_combo, Gtk::PACK_SHRINK);
+    m_time_box.pack_start(m_ampm_combo, Gtk::PACK_SHRINK);
+    m_time_box.property_width_request() = 270;
+
+    attach(m_time_label, 0, 1, 1, 1);
+    attach(m_time_box, 1, 1, 2, 1);
+
+    // Description row
+    m_description_textview.set_hexpand(true);
+    m_description_textview.set_vexpand(true);
+    m_description_scroll.add(m_description_textview);
+    m_description_scroll.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+    m_description_scroll.set_shadow_type(Gtk::SHADOW_IN);
+    m_description_scroll.set_size_request(-1, 100);
+    attach(m_description_label, 0, 2, 3, 1);
+    attach(m_description_scroll, 0, 3, 3, 1);
+
+    // Priority row
+    m_priority_combo.append("Low");
+    m_priority_combo.append("Normal");
+    m_priority_combo.append("High");
+    fill_escalation_combo(m_escalation_combo, 0);
+    m_escalation_combo.set_tooltip_text("Notify again until the reminder is done or snoozed");
+    attach(m_priority_label, 0, 4, 1, 1);
+    attach(m_priority_combo, 1, 4, 1, 1);
+    attach(m_escalation_combo, 2, 4, 1, 1);
+
+    // Tags row
+    m_tags_entry.set_placeholder_text("Comma separated, e.g. work, home");
+    m_tags_entry.set_activates_default(true);
+    attach(m_tags_label, 0, 5, 1, 1);
+    attach(m_tags_entry, 1, 5, 2, 1);
+
+    // Status row
+    attach(m_completed_check, 0, 6, 3, 1);
+
+    // Validation problems, hidden until there is one
+    m_error_label.set_halign(Gtk::ALIGN_START);
+    m_error_label.get_style_context()->add_class("error");
+    m_error_label.set_no_show_all(true);
+    attach(m_error_label, 0, 7, 3, 1);
+}
+
+ReminderEditor::~ReminderEditor()
+{
+}
+
+void ReminderEditor::set_reminder(const Reminder &reminder)
+{
+    m_title_entry.set_text(reminder.title);
+    m_description_textview.get_buffer()->set_text(reminder.description);
+
+    int hour24 = 0, minute = 0, second = 0;
+    parse_reminder_time(reminder.time, hour24, minute, second);
+
+    // 12-hour display: 00:xx is 12 AM, 12:xx is 12 PM
+    int hour12 = hour24 % 12 == 0 ? 12 : hour24 % 12;
+    m_hour_combo.set_active(hour12 - 1);
+    m_minute_combo.set_active(minute);
+    m_second_combo.set_active(second);
+    m_ampm_combo.set_active(hour24 >= 12 ? 1 : 0);
+
+    m_priority_combo.set_active(reminder.priority);
+    select_escalation(m_escalation_combo, reminder.escalate_minutes);
+    m_tags_entry.set_text(join_tags(reminder.tags));
+    m_completed_check.set_active(reminder.completed);
+
+    clear_error();
+}
+
+bool ReminderEditor::get_reminder(Reminder &reminder)
+{
+    std::string title = m_title_entry.get_text();
+    if (title.find_first_not_of(" \t") == std::string::npos)
+    {
+        show_error("Title cannot be empty.");
+        m_title_entry.get_style_context()->add_class("error");
+        m_title_entry.grab_focus();
+        return false;
+    }
+
+    // Convert time from 12-hour format to 24-hour format for storage
+    int hour = m_hour_combo.get_active_row_number() + 1;
+    if (m_ampm_combo.get_active_row_number() == 1 && hour != 12)
+    {
+        hour += 12;
+    }
+    else if (m_ampm_combo.get_active_row_number() == 0 && hour == 12)
+    {
+        hour = 0;
+    }
+
+    reminder.title = title;
+    reminder.description = m_description_textview.get_buffer()->get_text();
+    reminder.time = format_reminder_time(hour, m_minute_combo.get_active_row_number(),
+                                         m_second_combo.get_active_row_number());
+    reminder.completed = m_completed_check.get_active();
+    reminder.priority = m_priority_combo.get_active_row_number();
+    reminder.escalate_minutes = escalation_minutes_of(m_escalation_combo);
+    reminder.tags = parse_tags(m_tags_entry.get_text());
+    return true;
+}
+
+void ReminderEditor::show_error(const std::string &message)
+{
+    m_error_label.set_text(message);
+    m_error_label.show();
+}
+
+void ReminderEditor::clear_error()
+{
+    m_error_label.hide();
+    m_title_entry.get_style_context()->remove_class("error");
+}
+
+Gtk::Entry &ReminderEditor::title_entry()
+{
+    return m_title_entry;
+}
+
+std::vector<std::string> ReminderEditor::parse_tags(const std::string &text)
+{
+    std::vector<std::string> tags;
+    std::stringstream ss(text);
+    std::string tag;
+
+    while (std::getline(ss, tag, ','))
+    {
+        // Trim surrounding whitespace
+        size_t first = tag.find_first_not_of(" \t");
+        size_t last = tag.find_last_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+
+        tag = tag.substr(first, last - first + 1);
+        if (std::find(tags.begin(), tags.end(), tag) == tags.end())
+        {
+            tags.push_back(tag);
+        }
+    }
+
+    // Same order as tags loaded from the database
+    std::sort(tags.begin(), tags.end());
+    return tags;
+}
+
+std::string ReminderEditor::join_tags(const std::vector<std::string> &tags)
+{
+    std::string text;
+    for (const auto &tag : tags)
+    {
+        if (!text.empty())
+        {
+            text += ", ";
+        }
+        text += tag;
+    }
+    return text;
+}
+
+void ReminderEditor::fill_escalation_combo(Gtk::ComboBoxText &combo, int minutes)
+{
+    static const int choices[] = {0, 5, 10, 15, 30, 60};
+
+    combo.append("0", "Notify once");
+    for (int choice : choices)
+    {
+        if (choice > 0)
+            combo.append(std::to_string(choice), "Repeat every " + std::to_string(choice) + " min");
+    }
+
+    select_escalation(combo, minutes);
+}
+
+void ReminderEditor::select_escalation(Gtk::ComboBoxText &combo, int minutes)
+{
+    // Keep an interval set by another program selectable; it is added the
+    // first time it is seen and stays for later reminders
+    std::string id = std::to_string(std::max(minutes, 0));
+    if (!combo.set_active_id(id))
+    {
+        combo.append(id, "Repeat every " + id + " min");
+        combo.set_active_id(id);
+    }
+}
+
+int ReminderEditor::escalation_minutes_of(Gtk::ComboBoxText &combo)
+{
+    return std::atoi(combo.get_active_id().c_str());
+}
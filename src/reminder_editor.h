@@ -0,0 +1,60 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <string>
+#include <vector>
+#include "reminder.h"
+
+// Form for every editable field of a reminder. It is built once and
+// refilled for each reminder edited, and validates inline: a problem is
+// shown under the form instead of in a separate dialog.
+class ReminderEditor : public Gtk::Grid
+{
+public:
+    ReminderEditor();
+    virtual ~ReminderEditor();
+
+    // Fill the form from a reminder and clear any error shown
+    void set_reminder(const Reminder &reminder);
+
+    // Copy the form into reminder. Returns false, leaving reminder as it
+    // was and showing why, if the form is not valid.
+    bool get_reminder(Reminder &reminder);
+
+    // Show a problem found elsewhere, e.g. when saving fails
+    void show_error(const std::string &message);
+    void clear_error();
+
+    Gtk::Entry &title_entry();
+
+    // Tags are edited as a comma separated list
+    static std::vector<std::string> parse_tags(const std::string &text);
+    static std::string join_tags(const std::vector<std::string> &tags);
+
+    // Escalation intervals offered in the UI
+    static void fill_escalation_combo(Gtk::ComboBoxText &combo, int minutes);
+    static void select_escalation(Gtk::ComboBoxText &combo, int minutes);
+    static int escalation_minutes_of(Gtk::ComboBoxText &combo);
+
+private:
+    Gtk::Label m_title_label;
+    Gtk::Entry m_title_entry;
+    Gtk::Label m_time_label;
+    Gtk::Box m_time_box;
+    Gtk::ComboBoxText m_hour_combo;
+    Gtk::ComboBoxText m_minute_combo;
+    Gtk::ComboBoxText m_second_combo;
+    Gtk::ComboBoxText m_ampm_combo;
+    Gtk::Label m_time_separator;
+    Gtk::Label m_seconds_separator;
+    Gtk::Label m_description_label;
+    Gtk::ScrolledWindow m_description_scroll;
+    Gtk::TextView m_description_textview;
+    Gtk::Label m_priority_label;
+    Gtk::ComboBoxText m_priority_combo;
+    Gtk::ComboBoxText m_escalation_combo;
+    Gtk::Label m_tags_label;
+    Gtk::Entry m_tags_entry;
+    Gtk::CheckButton m_completed_check;
+    Gtk::Label m_error_label;
+};
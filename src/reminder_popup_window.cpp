@@ -1,11 +1,19 @@
 #include "reminder_popup_window.h"
-#include "reminder_app.h" // For the Reminder struct
 #include <iostream>
 #include <iomanip>
 #include <sstream>
-
-ReminderPopupWindow::ReminderPopupWindow() : m_main_box(Gtk::ORIENTATION_VERTICAL, 10)
+#include <unordered_set>
+#include <limits>
+#include <chrono>
+
+ReminderPopupWindow::ReminderPopupWindow() : m_main_box(Gtk::ORIENTATION_VERTICAL, 10),
+                                             m_store(nullptr),
+                                             m_scheduler(nullptr),
+                                             m_headers_pending(false)
 {
+    // Completed reminders are hidden unless asked for
+    m_filter.hide_completed = true;
+
     // Set up the UI components
     setup_ui();
 
@@ -15,7 +23,10 @@ ReminderPopupWindow::ReminderPopupWindow() : m_main_box(Gtk::ORIENTATION_VERTICA
 
 ReminderPopupWindow::~ReminderPopupWindow()
 {
-    // Nothing specific to clean up
+    if (m_css_provider)
+    {
+        Gtk::StyleContext::remove_provider_for_screen(Gdk::Screen::get_default(), m_css_provider);
+    }
 }
 
 void ReminderPopupWindow::setup_ui()
@@ -43,6 +54,14 @@ void ReminderPopupWindow::setup_ui()
     separator->set_margin_bottom(10);
     m_main_box.pack_start(*separator, Gtk::PACK_SHRINK);
 
+    // View selector
+    m_filter_combo.append("Active");
+    m_filter_combo.append("Due today");
+    m_filter_combo.append("Due today, high priority");
+    m_filter_combo.append("All reminders");
+    m_filter_combo.set_active(0);
+    m_main_box.pack_start(m_filter_combo, Gtk::PACK_SHRINK);
+
     // Set up the scrolled window
     m_scrolled_window.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
     m_scrolled_window.set_min_content_height(300);
@@ -53,8 +72,20 @@ void ReminderPopupWindow::setup_ui()
     m_list_box.set_selection_mode(Gtk::SELECTION_NONE);
     m_list_box.set_margin_top(5);
     m_list_box.set_margin_bottom(5);
+    m_list_box.set_sort_func(sigc::mem_fun(*this, &ReminderPopupWindow::compare_rows));
+    m_list_box.set_header_func(sigc::mem_fun(*this, &ReminderPopupWindow::update_header));
     m_scrolled_window.add(m_list_box);
 
+    // One provider for every completed row. Installing a provider per row
+    // grew the screen's style cascade with each rebuild.
+    m_css_provider = Gtk::CssProvider::create();
+    m_css_provider->load_from_data(".completed-reminder { "
+                                   "background-color: rgba(200, 255, 200, 0.5); "
+                                   "border: 1px solid rgba(100, 200, 100, 0.5); "
+                                   "}");
+    Gtk::StyleContext::add_provider_for_screen(Gdk::Screen::get_default(), m_css_provider,
+                                               GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
     // Add a close button at the bottom
     m_close_button.set_label("Close");
     m_close_button.set_halign(Gtk::ALIGN_CENTER);
@@ -72,6 +103,10 @@ void ReminderPopupWindow::connect_signals()
     m_close_button.signal_clicked().connect(
         sigc::mem_fun(*this, &ReminderPopupWindow::on_close_button_clicked));
 
+    // Connect view selector
+    m_filter_combo.signal_changed().connect(
+        sigc::mem_fun(*this, &ReminderPopupWindow::on_filter_changed));
+
     // Connect window delete event
     m_window.signal_delete_event().connect(
         sigc::mem_fun(*this, &ReminderPopupWindow::on_window_delete_event));
@@ -89,36 +124,214 @@ void ReminderPopupWindow::hide()
     m_window.hide();
 }
 
+LatencyHistogram &ReminderPopupWindow::refresh_time()
+{
+    return m_refresh_time;
+}
+
 Gtk::Window &ReminderPopupWindow::get_window()
 {
     return m_window;
 }
 
-void ReminderPopupWindow::set_reminders(const std::vector<Reminder> &reminders)
+void ReminderPopupWindow::set_store(const ReminderStore *store)
+{
+    m_store = store;
+    clear_rows();
+    refresh();
+}
+
+void ReminderPopupWindow::set_scheduler(const Scheduler *scheduler)
+{
+    m_scheduler = scheduler;
+}
+
+long long ReminderPopupWindow::fire_time_of(int id) const
+{
+    auto it = m_fire_times.find(id);
+    return it != m_fire_times.end() ? it->second : std::numeric_limits<long long>::max();
+}
+
+int ReminderPopupWindow::compare_rows(Gtk::ListBoxRow *a, Gtk::ListBoxRow *b)
+{
+    int id_a = GPOINTER_TO_INT(a->get_data("reminder_id"));
+    int id_b = GPOINTER_TO_INT(b->get_data("reminder_id"));
+    long long time_a = fire_time_of(id_a);
+    long long time_b = fire_time_of(id_b);
+
+    if (time_a != time_b)
+        return time_a < time_b ? -1 : 1;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+void ReminderPopupWindow::update_header(Gtk::ListBoxRow *row, Gtk::ListBoxRow *before)
 {
-    refresh_list(reminders);
+    int index = row->get_index();
+    std::string title;
+
+    if (index == 0)
+    {
+        title = "Next up";
+    }
+    else if (index == NEXT_UP_SIZE)
+    {
+        title = "Later";
+    }
+
+    if (title.empty())
+    {
+        if (row->get_header())
+        {
+            row->unset_header();
+        }
+        return;
+    }
+
+    // Reuse the header if it already says the right thing
+    auto current = dynamic_cast<Gtk::Label *>(row->get_header());
+    if (current && current->get_text() == title)
+        return;
+
+    auto label = Gtk::manage(new Gtk::Label());
+    label->set_markup("<b>" + title + "</b>");
+    label->set_halign(Gtk::ALIGN_START);
+    label->set_margin_top(6);
+    label->set_margin_bottom(4);
+    label->show();
+    row->set_header(*label);
 }
 
-void ReminderPopupWindow::refresh_list(const std::vector<Reminder> &reminders)
+void ReminderPopupWindow::queue_header_update()
+{
+    // Section boundaries depend on positions, so any insert, removal or move
+    // can shift them. Coalesce the refresh of all headers into one idle pass.
+    if (m_headers_pending)
+        return;
+
+    m_headers_pending = true;
+    Glib::signal_idle().connect_once([this]()
+                                     {
+        m_headers_pending = false;
+        m_list_box.invalidate_headers(); });
+}
+
+void ReminderPopupWindow::clear_rows()
 {
-    // Clear existing widgets
     auto children = m_list_box.get_children();
     for (auto child : children)
     {
         m_list_box.remove(*child);
         delete child;
     }
+    m_rows.clear();
+    m_fire_times.clear();
+}
+
+void ReminderPopupWindow::refresh()
+{
+    if (!m_store)
+        return;
+
+    auto started = std::chrono::steady_clock::now();
+
+    // Drop rows that left the view
+    std::vector<int> ids = m_store->query(m_filter);
+    std::unordered_set<int> visible(ids.begin(), ids.end());
+
+    std::vector<int> stale;
+    for (const auto &entry : m_rows)
+    {
+        if (visible.count(entry.first) == 0)
+        {
+            stale.push_back(entry.first);
+        }
+    }
+    for (int id : stale)
+    {
+        remove_reminder(id);
+    }
+
+    // Add rows that entered it; existing rows are kept as they are
+    for (int id : ids)
+    {
+        if (m_rows.count(id) == 0)
+        {
+            update_reminder(*m_store->find(id));
+        }
+    }
+
+    m_refresh_time.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+}
+
+void ReminderPopupWindow::update_reminder(const Reminder &reminder)
+{
+    if (m_store && !m_store->matches(m_filter, reminder))
+    {
+        remove_reminder(reminder.id);
+        return;
+    }
+
+    auto widget = create_reminder_widget(reminder);
+    if (!widget)
+        return;
+
+    // Take the sort key from the scheduler; completed reminders sort last
+    long long previous_time = fire_time_of(reminder.id);
+    Scheduler::time_point when;
+    if (m_scheduler && !reminder.completed && m_scheduler->next_fire(reminder.id, when))
+    {
+        m_fire_times[reminder.id] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        when.time_since_epoch())
+                                        .count();
+    }
+    else
+    {
+        m_fire_times.erase(reminder.id);
+    }
 
-    // Add reminder widgets
-    for (const auto &reminder : reminders)
+    auto it = m_rows.find(reminder.id);
+    if (it != m_rows.end())
     {
-        auto widget = create_reminder_widget(reminder);
-        if (widget)
+        // Replace the contents of the existing row
+        Gtk::ListBoxRow *row = it->second;
+        Gtk::Widget *old_widget = row->get_child();
+        if (old_widget)
         {
-            m_list_box.add(*widget);
-            widget->show_all();
+            row->remove();
+            delete old_widget;
         }
+        row->add(*widget);
+        row->show_all();
+
+        // Reposition just this row if its fire time moved
+        if (fire_time_of(reminder.id) != previous_time)
+        {
+            row->changed();
+            queue_header_update();
+        }
+        return;
     }
+
+    auto row = Gtk::manage(new Gtk::ListBoxRow());
+    row->set_data("reminder_id", GINT_TO_POINTER(reminder.id));
+    row->add(*widget);
+    m_list_box.add(*row);
+    row->show_all();
+    m_rows[reminder.id] = row;
+    queue_header_update();
+}
+
+void ReminderPopupWindow::remove_reminder(int id)
+{
+    auto it = m_rows.find(id);
+    if (it == m_rows.end())
+        return;
+
+    m_list_box.remove(*it->second);
+    delete it->second;
+    m_rows.erase(it);
+    m_fire_times.erase(id);
+    queue_header_update();
 }
 
 Gtk::Widget *ReminderPopupWindow::create_reminder_widget(const Reminder &reminder)
@@ -140,25 +353,8 @@ Gtk::Widget *ReminderPopupWindow::create_reminder_widget(const Reminder &reminde
     // Style the frame based on completion status
     if (reminder.completed)
     {
-        // Set a subtle background color for completed reminders
-        Gtk::StyleContext::add_provider_for_screen(
-            Gdk::Screen::get_default(),
-            Gtk::CssProvider::create(),
-            GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-
+        // Styled by the window's shared provider, see setup_ui
         frame->get_style_context()->add_class("completed-reminder");
-        frame->set_name("completed-reminder-" + std::to_string(reminder.id));
-
-        // Add inline CSS for the completed reminder
-        auto css_provider = Gtk::CssProvider::create();
-        css_provider->load_from_data(
-            "#completed-reminder-" + std::to_string(reminder.id) + " { "
-                                                                   "background-color: rgba(200, 255, 200, 0.5); "
-                                                                   "border: 1px solid rgba(100, 200, 100, 0.5); "
-                                                                   "}");
-
-        frame->get_style_context()->add_provider(
-            css_provider, GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
     }
 
     frame->add(*row_box);
@@ -192,12 +388,17 @@ Gtk::Widget *ReminderPopupWindow::create_reminder_widget(const Reminder &reminde
 
     // Title with bold formatting
     auto title_label = Gtk::manage(new Gtk::Label());
-    std::string markup = "<b>" + reminder.title + "</b>";
+    std::string title = Glib::Markup::escape_text(reminder.title);
+    std::string markup = "<b>" + title + "</b>";
 
     // Add strikethrough if completed
     if (reminder.completed)
     {
-        markup = "<b><s>" + reminder.title + "</s></b>";
+        markup = "<b><s>" + title + "</s></b>";
+    }
+    else if (reminder.priority == PRIORITY_HIGH)
+    {
+        markup = "❗ " + markup;
     }
 
     title_label->set_markup(markup);
@@ -214,11 +415,11 @@ Gtk::Widget *ReminderPopupWindow::create_reminder_widget(const Reminder &reminde
         // Add strikethrough if completed
         if (reminder.completed)
         {
-            desc_label->set_markup("<small><s>" + reminder.description + "</s></small>");
+            desc_label->set_markup("<small><s>" + Glib::Markup::escape_text(reminder.description) + "</s></small>");
         }
         else
         {
-            desc_label->set_markup("<small>" + reminder.description + "</small>");
+            desc_label->set_markup("<small>" + Glib::Markup::escape_text(reminder.description) + "</small>");
         }
 
         desc_label->set_line_wrap(true);
@@ -237,9 +438,9 @@ Gtk::Widget *ReminderPopupWindow::create_reminder_widget(const Reminder &reminde
 
     // Format time in 12-hour format
     std::string time_str = reminder.time;
-    // Extract hour and minute
+    // Extract hour, and minute with seconds if the time has them
     int hour = std::stoi(reminder.time.substr(0, 2));
-    std::string minute = reminder.time.substr(3, 2);
+    std::string minute = reminder.time.substr(3);
     std::string ampm = "AM";
 
     // Convert to 12-hour format
@@ -299,6 +500,21 @@ Gtk::Widget *ReminderPopupWindow::create_reminder_widget(const Reminder &reminde
         info_box->pack_start(*status_label, Gtk::PACK_SHRINK);
     }
 
+    // Tags
+    if (!reminder.tags.empty())
+    {
+        std::string tags_text;
+        for (const auto &tag : reminder.tags)
+        {
+            tags_text += (tags_text.empty() ? "#" : " #") + tag;
+        }
+
+        auto tags_label = Gtk::manage(new Gtk::Label());
+        tags_label->set_markup("<small>" + Glib::Markup::escape_text(tags_text) + "</small>");
+        tags_label->set_halign(Gtk::ALIGN_START);
+        info_box->pack_start(*tags_label, Gtk::PACK_SHRINK);
+    }
+
     return frame;
 }
 
@@ -314,6 +530,29 @@ bool ReminderPopupWindow::on_window_delete_event(GdkEventAny *event)
     return true; // Prevent the window from being destroyed
 }
 
+void ReminderPopupWindow::on_filter_changed()
+{
+    ReminderFilter filter;
+    switch (m_filter_combo.get_active_row_number())
+    {
+    case 0: // Active
+        filter.hide_completed = true;
+        break;
+    case 1: // Due today
+        filter.pending_today = true;
+        break;
+    case 2: // Due today, high priority
+        filter.pending_today = true;
+        filter.min_priority = PRIORITY_HIGH;
+        break;
+    default: // All reminders
+        break;
+    }
+
+    m_filter = filter;
+    refresh();
+}
+
 void ReminderPopupWindow::on_reminder_toggled(Gtk::CheckButton *check, int reminder_id)
 {
     bool is_active = check->get_active();
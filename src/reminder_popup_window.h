@@ -3,9 +3,10 @@
 #include <gtkmm.h>
 #include <vector>
 #include <string>
-
-// Forward declaration
-struct Reminder;
+#include <unordered_map>
+#include "reminder_store.h"
+#include "scheduler.h"
+#include "metrics.h"
 
 class ReminderPopupWindow
 {
@@ -15,9 +16,17 @@ public:
 
     void show();
     void hide();
-    void set_reminders(const std::vector<Reminder> &reminders);
+    // The popup renders a filtered view of the application's store
+    void set_store(const ReminderStore *store);
+    void set_scheduler(const Scheduler *scheduler);
+    void refresh();
+    void update_reminder(const Reminder &reminder);
+    void remove_reminder(int id);
     Gtk::Window &get_window();
 
+    // Time spent in refresh(), for the stats command
+    LatencyHistogram &refresh_time();
+
     // Signal accessor
     typedef sigc::signal<void, int, bool> type_signal_reminder_toggled;
     type_signal_reminder_toggled signal_reminder_toggled();
@@ -29,6 +38,23 @@ private:
     Gtk::ScrolledWindow m_scrolled_window;
     Gtk::ListBox m_list_box;
     Gtk::Button m_close_button;
+    Gtk::ComboBoxText m_filter_combo;
+    Glib::RefPtr<Gtk::CssProvider> m_css_provider;
+
+    // Data source and the view currently shown
+    const ReminderStore *m_store;
+    const Scheduler *m_scheduler;
+    ReminderFilter m_filter;
+
+    // Rows are ordered by next fire time, taken from the scheduler's queue
+    // when a row is updated. The first NEXT_UP_SIZE rows form "Next up".
+    static const int NEXT_UP_SIZE = 5;
+    std::unordered_map<int, long long> m_fire_times; // Milliseconds since epoch
+    bool m_headers_pending;
+    LatencyHistogram m_refresh_time;
+
+    // Rows keyed by reminder ID for in-place updates
+    std::unordered_map<int, Gtk::ListBoxRow *> m_rows;
 
     // Signal for reminder completion toggled
     type_signal_reminder_toggled m_signal_reminder_toggled;
@@ -36,11 +62,16 @@ private:
     // Helper methods
     void setup_ui();
     void connect_signals();
-    void refresh_list(const std::vector<Reminder> &reminders);
+    void clear_rows();
+    long long fire_time_of(int id) const;
+    int compare_rows(Gtk::ListBoxRow *a, Gtk::ListBoxRow *b);
+    void update_header(Gtk::ListBoxRow *row, Gtk::ListBoxRow *before);
+    void queue_header_update();
     Gtk::Widget *create_reminder_widget(const Reminder &reminder);
 
     // Signal handlers
     void on_close_button_clicked();
+    void on_filter_changed();
     bool on_window_delete_event(GdkEventAny *event);
     void on_reminder_toggled(Gtk::CheckButton *check, int reminder_id);
 };
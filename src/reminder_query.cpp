@@ -0,0 +1,277 @@
+#include "reminder_query.h"
+#include "reminder.h"
+#include "time_utils.h"
+#include <sqlite3.h>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// Tag names are joined with the unit separator, which can't be typed into
+// a tag, and split again for output
+static const char TAG_SEPARATOR = '\x1f';
+
+static std::string json_string(const std::string &text)
+{
+    std::string result = "\"";
+    for (unsigned char c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if (c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                result += escaped;
+            }
+            else
+            {
+                result += c;
+            }
+        }
+    }
+    return result + "\"";
+}
+
+// One field of a TSV row: tabs and line breaks would split the row
+static std::string tsv_field(std::string text)
+{
+    for (char &c : text)
+    {
+        if (c == '\t' || c == '\n' || c == '\r')
+            c = ' ';
+    }
+    return text;
+}
+
+static std::string column_text(sqlite3_stmt *stmt, int column)
+{
+    const unsigned char *text = sqlite3_column_text(stmt, column);
+    return text ? reinterpret_cast<const char *>(text) : "";
+}
+
+static std::vector<std::string> split_tags(const std::string &joined)
+{
+    std::vector<std::string> tags;
+    size_t start = 0;
+    while (!joined.empty() && start <= joined.size())
+    {
+        size_t end = joined.find(TAG_SEPARATOR, start);
+        if (end == std::string::npos)
+            end = joined.size();
+        tags.push_back(joined.substr(start, end - start));
+        start = end + 1;
+    }
+    return tags;
+}
+
+static const char *priority_name(int priority)
+{
+    switch (priority)
+    {
+    case PRIORITY_LOW:
+        return "low";
+    case PRIORITY_HIGH:
+        return "high";
+    default:
+        return "normal";
+    }
+}
+
+bool parse_query_kind(const std::string &text, QueryKind &kind)
+{
+    if (text == "list")
+        kind = QueryKind::List;
+    else if (text == "due")
+        kind = QueryKind::Due;
+    else if (text == "overdue")
+        kind = QueryKind::Overdue;
+    else
+        return false;
+    return true;
+}
+
+// Times are zero-padded, so they order as strings. A reminder is due
+// during the whole minute it names: "HH:MM" sorts before every "HH:MM:SS"
+// of that minute, so it works as an inclusive lower bound, and an upper
+// bound given to the minute is widened to its last second.
+static bool time_bounds(const QueryOptions &options, const Clock &clock,
+                        std::string &lower, std::string &upper, std::string &before)
+{
+    int hour, minute, second;
+    lower = "00:00";
+    upper = "23:59:59";
+    before = "24:00";
+
+    if (!options.since.empty())
+    {
+        if (!parse_reminder_time(options.since, hour, minute, second))
+        {
+            std::cerr << "Invalid --since time: " << options.since << std::endl;
+            return false;
+        }
+        lower = format_reminder_time(hour, minute, second);
+    }
+
+    if (!options.until.empty())
+    {
+        if (!parse_reminder_time(options.until, hour, minute, second))
+        {
+            std::cerr << "Invalid --until time: " << options.until << std::endl;
+            return false;
+        }
+        upper = options.until.size() == 5 ? options.until + ":59" : options.until;
+    }
+
+    std::string now = current_time_string(clock);
+    if (options.kind == QueryKind::Due && lower < now)
+        lower = now;
+    else if (options.kind == QueryKind::Overdue)
+        before = now;
+
+    return true;
+}
+
+static void write_row(sqlite3_stmt *stmt, QueryFormat format, bool first, std::ostream &out)
+{
+    int id = sqlite3_column_int(stmt, 0);
+    std::string time = column_text(stmt, 1);
+    std::string title = column_text(stmt, 2);
+    std::string description = column_text(stmt, 3);
+    int priority = sqlite3_column_int(stmt, 4);
+    bool completed = sqlite3_column_int(stmt, 5) != 0;
+    bool notified = sqlite3_column_int(stmt, 6) != 0;
+    std::vector<std::string> tags = split_tags(column_text(stmt, 7));
+
+    switch (format)
+    {
+    case QueryFormat::Json:
+        out << (first ? "\n  " : ",\n  ")
+            << "{\"id\":" << id
+            << ",\"time\":" << json_string(time)
+            << ",\"title\":" << json_string(title)
+            << ",\"description\":" << json_string(description)
+            << ",\"priority\":" << json_string(priority_name(priority))
+            << ",\"completed\":" << (completed ? "true" : "false")
+            << ",\"notified\":" << (notified ? "true" : "false")
+            << ",\"tags\":[";
+        for (size_t i = 0; i < tags.size(); i++)
+        {
+            out << (i > 0 ? "," : "") << json_string(tags[i]);
+        }
+        out << "]}";
+        break;
+
+    case QueryFormat::Tsv:
+        out << id << '\t' << time << '\t' << priority_name(priority) << '\t'
+            << completed << '\t' << notified << '\t' << tsv_field(title) << '\t'
+            << tsv_field(description) << '\t';
+        for (size_t i = 0; i < tags.size(); i++)
+        {
+            out << (i > 0 ? "," : "") << tsv_field(tags[i]);
+        }
+        out << '\n';
+        break;
+
+    case QueryFormat::Text:
+        out << (completed ? "[x] " : "[ ] ") << convert_to_12hour_format(time) << "  " << title;
+        if (priority != PRIORITY_NORMAL)
+            out << " (" << priority_name(priority) << ")";
+        for (const auto &tag : tags)
+        {
+            out << " #" << tag;
+        }
+        out << "  [" << id << "]\n";
+        break;
+    }
+}
+
+int run_query(const QueryOptions &options, const Clock &clock, std::ostream &out)
+{
+    std::string lower, upper, before;
+    if (!time_bounds(options, clock, lower, upper, before))
+        return 1;
+
+    // Read-only, so a missing database isn't created and nothing here can
+    // take a write lock
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(options.db_path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Can't open " << options.db_path << ": " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return 1;
+    }
+    sqlite3_busy_timeout(db, 1000);
+
+    // Rows come off idx_reminders_time already in order, so nothing is
+    // sorted or collected first. The unary + keeps the planner from
+    // picking idx_reminders_active for the completed test, which would
+    // need a sort. Tags come from the reminder_tags primary key.
+    std::string where =
+        " FROM reminders r WHERE r.time >= ?1 AND r.time <= ?2 AND r.time < ?3";
+    if (options.kind != QueryKind::List)
+        where += " AND +r.completed = 0";
+
+    std::string sql = options.count
+                          ? "SELECT count(*)" + where + ";"
+                          : "SELECT r.id, r.time, r.title, r.description, r.priority, r.completed, r.notified,"
+                            " (SELECT group_concat(t.name, char(31)) FROM reminder_tags rt"
+                            " JOIN tags t ON t.id = rt.tag_id WHERE rt.reminder_id = r.id)" +
+                                where + " ORDER BY r.time, r.id;";
+
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Query failed: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return 1;
+    }
+
+    sqlite3_bind_text(stmt, 1, lower.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, upper.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, before.c_str(), -1, SQLITE_TRANSIENT);
+
+    if (!options.count && options.format == QueryFormat::Tsv)
+        out << "id\ttime\tpriority\tcompleted\tnotified\ttitle\tdescription\ttags\n";
+    if (!options.count && options.format == QueryFormat::Json)
+        out << "[";
+
+    int rc;
+    bool first = true;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (options.count)
+        {
+            out << sqlite3_column_int(stmt, 0) << '\n';
+            continue;
+        }
+        write_row(stmt, options.format, first, out);
+        first = false;
+    }
+
+    if (!options.count && options.format == QueryFormat::Json)
+        out << (first ? "]\n" : "\n]\n");
+    out.flush();
+
+    if (rc != SQLITE_DONE)
+        std::cerr << "Query failed: " << sqlite3_errmsg(db) << std::endl;
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return rc == SQLITE_DONE ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "clock.h"
+#include <ostream>
+#include <string>
+
+// Read-only queries for scripts and monitoring, answered straight from the
+// database without starting the app.
+enum class QueryKind
+{
+    List,   // Every reminder
+    Due,    // Not completed and still to come today
+    Overdue // Not completed and already past today
+};
+
+enum class QueryFormat
+{
+    Text,
+    Tsv, // Header line, then one row per reminder
+    Json // An array of objects, written as rows are read
+};
+
+struct QueryOptions
+{
+    QueryKind kind = QueryKind::List;
+    QueryFormat format = QueryFormat::Text;
+    std::string db_path;
+    std::string since; // "HH:MM[:SS]", inclusive; empty = start of day
+    std::string until; // "HH:MM[:SS]", inclusive; empty = end of day
+    bool count = false; // Print only the number of matches
+};
+
+bool parse_query_kind(const std::string &text, QueryKind &kind);
+
+// Run the query on a read-only connection and write the matches, ordered
+// by time, as they are stepped. In WAL mode this never waits on or blocks
+// a running instance. Returns the exit status: 0, or 1 on error.
+int run_query(const QueryOptions &options, const Clock &clock, std::ostream &out);
@@ -0,0 +1,715 @@
+#include "reminder_service.h"
+#include "delivery_history.h"
+#include "time_utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <pwd.h>
+#include <sys/fsuid.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Wait this long after the last change to a database before reloading it,
+// so a burst of WAL writes costs one reload
+static const int RELOAD_DELAY_MS = 200;
+
+// Latency budgets for the stall detector. Database access may legitimately
+// wait up to the 2 s busy timeout.
+static const int POLL_BUDGET_MS = 5000;
+static const int SCHEDULER_BUDGET_MS = 200;
+
+// Regular login accounts
+static const uid_t FIRST_USER_UID = 1000;
+static const uid_t NOBODY_UID = 65534;
+
+// Switches the file system identity of the calling thread to a user for the
+// lifetime of the object. File access is then checked against, and new files
+// are owned by, that user, which keeps one user's data out of another's
+// reach and stops root-owned -wal/-shm files appearing in home directories.
+class FsIdentity
+{
+public:
+    FsIdentity(uid_t uid, gid_t gid) : m_old_gid(setfsgid(gid)),
+                                       m_old_uid(setfsuid(uid))
+    {
+    }
+
+    ~FsIdentity()
+    {
+        setfsuid(m_old_uid);
+        setfsgid(m_old_gid);
+    }
+
+private:
+    int m_old_gid;
+    int m_old_uid;
+};
+
+static std::string database_path(const ServiceUser &user)
+{
+    return user.data_dir + "/reminders.db";
+}
+
+ReminderService::ReminderService() : m_inotify_fd(-1),
+                                     m_poll_loop(m_stall_detector.add_loop("poll", std::chrono::milliseconds(POLL_BUDGET_MS))),
+                                     m_scheduler_loop(m_stall_detector.add_loop("scheduler", std::chrono::milliseconds(SCHEDULER_BUDGET_MS)))
+{
+    m_wake_pipe[0] = -1;
+    m_wake_pipe[1] = -1;
+}
+
+ReminderService::~ReminderService()
+{
+    m_scheduler.stop();
+
+    for (auto &entry : m_deliveries)
+    {
+        close(entry.first);
+    }
+
+    for (int fd : {m_wake_pipe[0], m_wake_pipe[1], m_inotify_fd})
+    {
+        if (fd != -1)
+            close(fd);
+    }
+}
+
+bool ReminderService::add_user(const std::string &name)
+{
+    struct passwd *pw = getpwnam(name.c_str());
+    if (!pw)
+    {
+        std::cerr << "Unknown user: " << name << std::endl;
+        return false;
+    }
+
+    for (const auto &user : m_users)
+    {
+        if (user.uid == pw->pw_uid)
+            return true;
+    }
+
+    ServiceUser user;
+    user.name = pw->pw_name;
+    user.uid = pw->pw_uid;
+    user.gid = pw->pw_gid;
+    user.home = pw->pw_dir;
+    user.data_dir = user.home + "/.local/share";
+    m_users.push_back(user);
+    return true;
+}
+
+void ReminderService::add_all_users()
+{
+    std::vector<std::string> names;
+
+    setpwent();
+    while (struct passwd *pw = getpwent())
+    {
+        if (pw->pw_uid < FIRST_USER_UID || pw->pw_uid >= NOBODY_UID)
+            continue;
+
+        // Only users who have used the app, checked with their own rights
+        std::string path = std::string(pw->pw_dir) + "/.local/share/reminders.db";
+        struct stat st;
+        bool exists;
+        {
+            FsIdentity identity(pw->pw_uid, pw->pw_gid);
+            exists = stat(path.c_str(), &st) == 0;
+        }
+
+        if (exists)
+            names.push_back(pw->pw_name);
+    }
+    endpwent();
+
+    for (const auto &name : names)
+    {
+        add_user(name);
+    }
+}
+
+size_t ReminderService::user_count() const
+{
+    return m_users.size();
+}
+
+sqlite3 *ReminderService::open_database(const ServiceUser &user, int flags)
+{
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(database_path(user).c_str(), &db, flags, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Can't open database of " << user.name << ": " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    // The user's own app may be writing at the same moment
+    sqlite3_busy_timeout(db, 2000);
+    return db;
+}
+
+static sqlite3_int64 read_sync_version(sqlite3 *db)
+{
+    sqlite3_int64 version = -1;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db, "SELECT version FROM sync_state WHERE id = 1;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            version = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return version;
+}
+
+void ReminderService::start_serving(size_t index)
+{
+    ServiceUser &user = m_users[index];
+
+    {
+        FsIdentity identity(user.uid, user.gid);
+        user.watch = inotify_add_watch(m_inotify_fd, user.data_dir.c_str(),
+                                       IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    }
+
+    if (user.watch == -1)
+    {
+        std::cerr << "Can't watch " << user.data_dir << ": " << std::strerror(errno) << std::endl;
+    }
+    else
+    {
+        m_user_of_watch[user.watch] = index;
+    }
+
+    load_user(index);
+}
+
+bool ReminderService::load_user(size_t index)
+{
+    ServiceUser &user = m_users[index];
+    user.dirty = false;
+
+    std::map<int, Reminder> loaded;
+    sqlite3_int64 version;
+    {
+        FsIdentity identity(user.uid, user.gid);
+        sqlite3 *db = open_database(user, SQLITE_OPEN_READWRITE);
+        if (!db)
+            return false;
+
+        // Read the version and the rows from one snapshot
+        sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+        version = read_sync_version(db);
+
+        if (version == -1)
+        {
+            std::cerr << "Database of " << user.name << " has not been set up by the app yet" << std::endl;
+        }
+        else if (version != user.version)
+        {
+            const char *sql = "SELECT id, title, description, time, notified, priority, escalate_minutes "
+                              "FROM reminders WHERE completed = 0;";
+            sqlite3_stmt *stmt;
+
+            if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                while (sqlite3_step(stmt) == SQLITE_ROW)
+                {
+                    Reminder reminder;
+                    reminder.id = sqlite3_column_int(stmt, 0);
+                    reminder.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+                    const unsigned char *description = sqlite3_column_text(stmt, 2);
+                    if (description)
+                    {
+                        reminder.description = reinterpret_cast<const char *>(description);
+                    }
+                    reminder.time = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+                    reminder.completed = false;
+                    reminder.notified = sqlite3_column_int(stmt, 4) != 0;
+                    reminder.priority = sqlite3_column_int(stmt, 5);
+                    reminder.escalate_minutes = sqlite3_column_int(stmt, 6);
+
+                    if (is_valid_reminder_time(reminder.time))
+                    {
+                        loaded.emplace(reminder.id, reminder);
+                    }
+                }
+                sqlite3_finalize(stmt);
+            }
+            else
+            {
+                std::cerr << "Failed to read reminders of " << user.name << ": " << sqlite3_errmsg(db) << std::endl;
+                version = -1;
+            }
+        }
+
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_close(db);
+    }
+
+    if (version == -1 || version == user.version)
+        return version != -1;
+
+    // Drop what disappeared or was completed, then (re)arm the rest
+    for (const auto &entry : user.reminders)
+    {
+        if (loaded.find(entry.first) == loaded.end())
+        {
+            release_slot(index, entry.first);
+            user.escalation_notices.erase(entry.first);
+        }
+    }
+
+    user.reminders.swap(loaded);
+    user.version = version;
+
+    for (const auto &entry : user.reminders)
+    {
+        arm(index, entry.second);
+    }
+
+    return true;
+}
+
+void ReminderService::set_reminder_flag(size_t index, int reminder_id, const std::string &column, bool value)
+{
+    ServiceUser &user = m_users[index];
+    FsIdentity identity(user.uid, user.gid);
+
+    sqlite3 *db = open_database(user, SQLITE_OPEN_READWRITE);
+    if (!db)
+        return;
+
+    std::string sql = "UPDATE reminders SET " + column + " = ? WHERE id = ?;";
+    sqlite3_stmt *stmt;
+
+    sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    sqlite3_int64 before = read_sync_version(db);
+
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_int(stmt, 1, value ? 1 : 0);
+        sqlite3_bind_int(stmt, 2, reminder_id);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            std::cerr << "Failed to update reminder of " << user.name << ": " << sqlite3_errmsg(db) << std::endl;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    sqlite3_int64 after = read_sync_version(db);
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(db);
+
+    // Our own write needs no reload, unless someone else wrote in between
+    if (before == user.version)
+    {
+        user.version = after;
+    }
+}
+
+void ReminderService::reset_notified()
+{
+    for (size_t index = 0; index < m_users.size(); index++)
+    {
+        ServiceUser &user = m_users[index];
+        user.escalation_notices.clear();
+
+        // The user's app does the same at midnight; the update is idempotent
+        {
+            FsIdentity identity(user.uid, user.gid);
+            sqlite3 *db = open_database(user, SQLITE_OPEN_READWRITE);
+            if (db)
+            {
+                sqlite3_exec(db, "UPDATE reminders SET notified = 0 WHERE notified = 1;", nullptr, nullptr, nullptr);
+                sqlite3_close(db);
+            }
+        }
+
+        for (auto &entry : user.reminders)
+        {
+            entry.second.notified = false;
+            arm(index, entry.second);
+        }
+        user.dirty = true;
+    }
+}
+
+int ReminderService::slot_for(size_t user, int reminder_id)
+{
+    auto key = std::make_pair(user, reminder_id);
+    auto it = m_slot_of.find(key);
+    if (it != m_slot_of.end())
+        return it->second;
+
+    int slot;
+    if (!m_free_slots.empty())
+    {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+        m_slots[slot - 1] = Slot{user, reminder_id};
+    }
+    else
+    {
+        m_slots.push_back(Slot{user, reminder_id});
+        slot = static_cast<int>(m_slots.size());
+    }
+
+    m_slot_of[key] = slot;
+    return slot;
+}
+
+void ReminderService::release_slot(size_t user, int reminder_id)
+{
+    auto it = m_slot_of.find(std::make_pair(user, reminder_id));
+    if (it == m_slot_of.end())
+        return;
+
+    m_scheduler.cancel_all(it->second);
+    m_free_slots.push_back(it->second);
+    m_slot_of.erase(it);
+}
+
+void ReminderService::arm(size_t user, const Reminder &reminder)
+{
+    // The shared rules, applied under the reminder's slot
+    Reminder queued = reminder;
+    queued.id = slot_for(user, reminder.id);
+    m_scheduler.arm(queued);
+}
+
+int ReminderService::run(bool all_users)
+{
+    // Signals are read from a descriptor; block them before the scheduler
+    // thread starts so it inherits the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    for (int signal : {SIGTERM, SIGINT, SIGHUP, SIGCHLD})
+        sigaddset(&signals, signal);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (signal_fd == -1 || m_inotify_fd == -1 || pipe2(m_wake_pipe, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+        std::cerr << "Failed to set up the event loop: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    for (size_t index = 0; index < m_users.size(); index++)
+    {
+        start_serving(index);
+    }
+
+    m_scheduler.arm_day_rollover();
+    m_scheduler.start([this](const std::vector<Deadline> &due)
+                      {
+        StallScope scope(m_stall_detector, m_scheduler_loop, "waking the service");
+        {
+            std::lock_guard<std::mutex> lock(m_fired_mutex);
+            m_fired.insert(m_fired.end(), due.begin(), due.end());
+        }
+        char byte = 1;
+        if (write(m_wake_pipe[1], &byte, 1) == -1 && errno != EAGAIN)
+        {
+            std::cerr << "Failed to wake the service: " << std::strerror(errno) << std::endl;
+        } });
+
+    std::cout << "Serving " << m_users.size() << " user(s), " << m_scheduler.size() << " deadline(s) queued" << std::endl;
+
+    // poll() may sleep for hours, so only the work between polls is timed
+    m_stall_detector.start();
+    sd_notify_state("READY=1");
+
+    bool running = true;
+    while (running)
+    {
+        std::vector<pollfd> fds = {{m_wake_pipe[0], POLLIN, 0}, {m_inotify_fd, POLLIN, 0}, {signal_fd, POLLIN, 0}};
+        for (const auto &entry : m_deliveries)
+        {
+            fds.push_back({entry.first, POLLIN, 0});
+        }
+
+        // Sleep indefinitely unless a changed database is waiting to be read
+        bool any_dirty = std::any_of(m_users.begin(), m_users.end(),
+                                     [](const ServiceUser &user)
+                                     { return user.dirty; });
+
+        int ready = poll(fds.data(), fds.size(), any_dirty ? RELOAD_DELAY_MS : -1);
+        if (ready == -1 && errno != EINTR)
+        {
+            std::cerr << "poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        if (ready == 0)
+        {
+            StallScope scope(m_stall_detector, m_poll_loop, "reloading databases");
+            for (size_t index = 0; index < m_users.size(); index++)
+            {
+                if (m_users[index].dirty)
+                    load_user(index);
+            }
+            continue;
+        }
+
+        if (fds[0].revents)
+        {
+            char buffer[64];
+            while (read(m_wake_pipe[0], buffer, sizeof(buffer)) > 0)
+            {
+            }
+            StallScope scope(m_stall_detector, m_poll_loop, "delivering reminders");
+            on_deadlines_fired();
+        }
+
+        if (fds[1].revents)
+        {
+            StallScope scope(m_stall_detector, m_poll_loop, "reading database changes");
+            on_inotify();
+        }
+
+        if (fds[2].revents)
+        {
+            StallScope scope(m_stall_detector, m_poll_loop, "handling signals");
+            signalfd_siginfo info;
+            while (read(signal_fd, &info, sizeof(info)) == sizeof(info))
+            {
+                if (info.ssi_signo == SIGCHLD)
+                {
+                    while (waitpid(-1, nullptr, WNOHANG) > 0)
+                    {
+                    }
+                }
+                else if (info.ssi_signo == SIGHUP && all_users)
+                {
+                    size_t known = m_users.size();
+                    add_all_users();
+                    for (size_t index = known; index < m_users.size(); index++)
+                    {
+                        start_serving(index);
+                    }
+                    std::cout << "Serving " << m_users.size() << " user(s)" << std::endl;
+                }
+                else if (info.ssi_signo == SIGTERM || info.ssi_signo == SIGINT)
+                {
+                    running = false;
+                }
+            }
+        }
+
+        for (size_t i = 3; i < fds.size(); i++)
+        {
+            if (fds[i].revents)
+            {
+                StallScope scope(m_stall_detector, m_poll_loop, "handling notification actions");
+                on_delivery_output(fds[i].fd);
+            }
+        }
+    }
+
+    sd_notify_state("STOPPING=1");
+    m_stall_detector.stop();
+    m_scheduler.stop();
+    close(signal_fd);
+    return 0;
+}
+
+void ReminderService::on_inotify()
+{
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+
+    while ((length = read(m_inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *ptr = buffer; ptr < buffer + length;)
+        {
+            auto event = reinterpret_cast<inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            // Only the database and its -wal/-journal files matter
+            if (event->len == 0 || std::strncmp(event->name, "reminders.db", 12) != 0)
+                continue;
+
+            auto it = m_user_of_watch.find(event->wd);
+            if (it != m_user_of_watch.end())
+            {
+                m_users[it->second].dirty = true;
+            }
+        }
+    }
+}
+
+void ReminderService::on_deadlines_fired()
+{
+    std::vector<Deadline> fired;
+    {
+        std::lock_guard<std::mutex> lock(m_fired_mutex);
+        fired.swap(m_fired);
+    }
+
+    // Deliveries are recorded per user once the whole batch is out
+    std::map<size_t, std::vector<DeliveryEvent>> delivered;
+
+    for (const auto &deadline : fired)
+    {
+        if (deadline.kind == DeadlineKind::DayRollover)
+        {
+            reset_notified();
+            m_scheduler.arm_day_rollover();
+            continue;
+        }
+
+        if (deadline.reminder_id < 1 || deadline.reminder_id > static_cast<int>(m_slots.size()))
+            continue;
+
+        const Slot &slot = m_slots[deadline.reminder_id - 1];
+        ServiceUser &user = m_users[slot.user];
+        auto it = user.reminders.find(slot.reminder_id);
+        if (it == user.reminders.end())
+            continue;
+
+        Reminder &reminder = it->second;
+
+        // Same notice rules as the desktop app
+        int notice = 0;
+        if (deadline.kind == DeadlineKind::Escalation)
+        {
+            notice = ++user.escalation_notices[reminder.id];
+        }
+        else if (deadline.kind == DeadlineKind::Primary)
+        {
+            user.escalation_notices.erase(reminder.id);
+        }
+
+        if (deliver(slot.user, reminder, notice))
+        {
+            delivered[slot.user].push_back({reminder.id, reminder.title, reminder.description, reminder.time,
+                                            reminder.priority, notice, deadline.kind, deadline.when,
+                                            m_scheduler.clock().now()});
+        }
+
+        if (deadline.kind == DeadlineKind::Primary)
+        {
+            set_reminder_flag(slot.user, reminder.id, "notified", true);
+            reminder.notified = true;
+            arm(slot.user, reminder);
+        }
+        else
+        {
+            Reminder queued = reminder;
+            queued.id = deadline.reminder_id;
+            m_scheduler.escalate(queued);
+        }
+    }
+
+    for (const auto &entry : delivered)
+    {
+        record_deliveries(entry.first, entry.second);
+    }
+}
+
+void ReminderService::record_deliveries(size_t index, const std::vector<DeliveryEvent> &events)
+{
+    ServiceUser &user = m_users[index];
+    FsIdentity identity(user.uid, user.gid);
+
+    sqlite3 *db = open_database(user, SQLITE_OPEN_READWRITE);
+    if (!db)
+        return;
+
+    // The user's app may be older than the history table
+    if (create_delivery_history_schema(db))
+    {
+        append_deliveries(db, events);
+    }
+    sqlite3_close(db);
+}
+
+bool ReminderService::deliver(size_t index, const Reminder &reminder, int notice)
+{
+    const ServiceUser &user = m_users[index];
+
+    if (!has_session_bus(user.uid))
+    {
+        std::cout << "No session for " << user.name << ", skipping '" << reminder.title << "'" << std::endl;
+        return false;
+    }
+
+    DeliveryTarget target{user.uid, user.gid, user.home};
+    int action_fd;
+    pid_t pid = spawn_delivery(target, reminder, notice, action_fd);
+    if (pid == -1)
+        return false;
+
+    fcntl(action_fd, F_SETFL, O_NONBLOCK);
+    m_deliveries[action_fd] = Delivery{pid, index, reminder.id, std::string()};
+    return true;
+}
+
+void ReminderService::on_delivery_output(int fd)
+{
+    auto it = m_deliveries.find(fd);
+    if (it == m_deliveries.end())
+        return;
+
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        it->second.output.append(buffer, static_cast<size_t>(n));
+    }
+
+    if (n == -1 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    // The child has exited or is about to; SIGCHLD reaps it
+    Delivery delivery = it->second;
+    close(fd);
+    m_deliveries.erase(it);
+
+    std::string action = delivery.output.substr(0, delivery.output.find('\n'));
+    if (!action.empty())
+    {
+        on_action(delivery.user, delivery.reminder_id, action);
+    }
+}
+
+void ReminderService::on_action(size_t index, int reminder_id, const std::string &action)
+{
+    ServiceUser &user = m_users[index];
+    auto it = user.reminders.find(reminder_id);
+    if (it == user.reminders.end())
+        return;
+
+    // Either action acknowledges the reminder and stops its escalation
+    user.escalation_notices.erase(reminder_id);
+
+    if (action == "done")
+    {
+        set_reminder_flag(index, reminder_id, "completed", true);
+        user.reminders.erase(it);
+        release_slot(index, reminder_id);
+    }
+    else if (action.compare(0, 7, "snooze-") == 0)
+    {
+        int minutes = std::atoi(action.c_str() + 7);
+        int slot = slot_for(index, reminder_id);
+        m_scheduler.cancel(slot, DeadlineKind::Escalation);
+        m_scheduler.schedule(slot, DeadlineKind::Snooze,
+                             m_scheduler.clock().now() + std::chrono::minutes(minutes));
+    }
+}
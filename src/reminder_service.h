@@ -0,0 +1,103 @@
+#pragma once
+
+#include "notification_bridge.h"
+#include "notification_sink.h"
+#include "reminder.h"
+#include "scheduler.h"
+#include "watchdog.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <sqlite3.h>
+#include <vector>
+
+// One user served by reminderd. Only what scheduling needs is kept in
+// memory: the user's identity and their active reminders.
+struct ServiceUser
+{
+    std::string name;
+    uid_t uid;
+    gid_t gid;
+    std::string home;
+    std::string data_dir; // Directory holding reminders.db
+    int watch = -1;       // inotify watch on data_dir
+    sqlite3_int64 version = -1;   // sync_state version last loaded
+    bool dirty = false;           // Database changed since it was loaded
+    std::map<int, Reminder> reminders;    // Active reminders by database ID
+    std::map<int, int> escalation_notices; // Repeat notices shown per reminder
+};
+
+// System service that schedules the reminders of many users from one
+// process. All users share one deadline queue and one worker thread, and the
+// main thread sleeps in poll() until a deadline fires, a database changes or
+// a notification is answered. Each user's database is only opened while it
+// is read or written, with the file system identity switched to that user,
+// and notifications go out through a per-user delivery bridge.
+class ReminderService
+{
+public:
+    ReminderService();
+    virtual ~ReminderService();
+
+    // Serve the named users, or every regular user with a reminders database
+    bool add_user(const std::string &name);
+    void add_all_users();
+    size_t user_count() const;
+
+    // Run until SIGTERM or SIGINT; SIGHUP rescans the users when serving all
+    int run(bool all_users);
+
+private:
+    std::vector<ServiceUser> m_users;
+    std::map<int, size_t> m_user_of_watch;
+
+    // The scheduler queue is keyed by slot, an ID naming one user's reminder
+    struct Slot
+    {
+        size_t user;
+        int reminder_id;
+    };
+    std::vector<Slot> m_slots; // Index + 1 is the scheduler ID; 0 is the rollover
+    std::map<std::pair<size_t, int>, int> m_slot_of;
+    std::vector<int> m_free_slots;
+    Scheduler m_scheduler;
+
+    // Fired deadlines handed from the scheduler thread to poll()
+    std::mutex m_fired_mutex;
+    std::vector<Deadline> m_fired;
+    int m_wake_pipe[2];
+    int m_inotify_fd;
+
+    // Stall detection for the poll loop and the scheduler thread
+    StallDetector m_stall_detector;
+    int m_poll_loop;
+    int m_scheduler_loop;
+
+    // Notifications on screen: action pipe -> delivery
+    struct Delivery
+    {
+        pid_t pid;
+        size_t user;
+        int reminder_id;
+        std::string output;
+    };
+    std::map<int, Delivery> m_deliveries;
+
+    void start_serving(size_t index);
+    bool load_user(size_t index);
+    sqlite3 *open_database(const ServiceUser &user, int flags);
+    void set_reminder_flag(size_t index, int reminder_id, const std::string &column, bool value);
+    void reset_notified();
+
+    int slot_for(size_t user, int reminder_id);
+    void release_slot(size_t user, int reminder_id);
+    void arm(size_t user, const Reminder &reminder);
+
+    void on_inotify();
+    void on_deadlines_fired();
+    bool deliver(size_t user, const Reminder &reminder, int notice);
+    void record_deliveries(size_t user, const std::vector<DeliveryEvent> &events);
+    void on_delivery_output(int fd);
+    void on_action(size_t user, int reminder_id, const std::string &action);
+};
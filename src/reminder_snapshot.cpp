@@ -0,0 +1,303 @@
+#include "reminder_snapshot.h"
+#include "time_utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char SNAPSHOT_MAGIC[8] = {'R', 'M', 'S', 'N', 'A', 'P', '\r', '\n'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t count;
+    uint64_t pool_size;
+    int64_t sync_version;
+    int32_t date; // YYYYMMDD the notified flags belong to
+    uint32_t reserved;
+    uint64_t checksum; // Of everything after the header
+};
+
+static_assert(sizeof(SnapshotEntry) == 24, "snapshot entries are written as is");
+static_assert(sizeof(SnapshotHeader) == 56, "the snapshot header is written as is");
+
+// Four independent multiply-xor lanes, so the check keeps up with memory
+// bandwidth; this guards against torn and corrupted files, not tampering
+static uint64_t snapshot_checksum(const uint8_t *data, size_t size)
+{
+    const uint64_t PRIME = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[4] = {PRIME, PRIME ^ 1, PRIME ^ 2, PRIME ^ 3};
+
+    size_t blocks = size / 32;
+    for (size_t b = 0; b < blocks; b++)
+    {
+        for (int l = 0; l < 4; l++)
+        {
+            uint64_t word;
+            memcpy(&word, data + b * 32 + l * 8, 8);
+            lanes[l] = (lanes[l] ^ word) * PRIME;
+            lanes[l] ^= lanes[l] >> 29;
+        }
+    }
+
+    uint64_t hash = size;
+    for (int l = 0; l < 4; l++)
+    {
+        hash = (hash ^ lanes[l]) * PRIME;
+    }
+    for (size_t i = blocks * 32; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * PRIME;
+    }
+    return hash ^ (hash >> 32);
+}
+
+static int32_t local_date(const Clock &clock)
+{
+    std::tm local_tm = clock.local_time(clock.now());
+    return (local_tm.tm_year + 1900) * 10000 + (local_tm.tm_mon + 1) * 100 + local_tm.tm_mday;
+}
+
+ReminderSnapshot::ReminderSnapshot() : m_data(nullptr),
+                                       m_size(0),
+                                       m_entries(nullptr),
+                                       m_count(0),
+                                       m_pool(nullptr),
+                                       m_pool_size(0),
+                                       m_sync_version(0),
+                                       m_date(0)
+{
+}
+
+ReminderSnapshot::~ReminderSnapshot()
+{
+    close();
+}
+
+bool ReminderSnapshot::open(const std::string &path, std::string &error)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        error = strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader))
+    {
+        error = "too short";
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        error = strerror(errno);
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t *>(mapped);
+    m_size = size;
+
+    SnapshotHeader header;
+    memcpy(&header, m_data, sizeof(header));
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        error = "not a reminder snapshot";
+    else if (header.version != SNAPSHOT_VERSION || header.entry_size != sizeof(SnapshotEntry))
+        error = "written by another version";
+    else if (header.count > (size - sizeof(header)) / sizeof(SnapshotEntry) ||
+             sizeof(header) + header.count * sizeof(SnapshotEntry) + header.pool_size != size)
+        error = "truncated";
+    else if (snapshot_checksum(m_data + sizeof(header), size - sizeof(header)) != header.checksum)
+        error = "checksum mismatch";
+
+    if (!error.empty())
+    {
+        close();
+        return false;
+    }
+
+    m_entries = reinterpret_cast<const SnapshotEntry *>(m_data + sizeof(header));
+    m_count = static_cast<size_t>(header.count);
+    m_pool = reinterpret_cast<const char *>(m_entries + m_count);
+    m_pool_size = static_cast<size_t>(header.pool_size);
+    m_sync_version = header.sync_version;
+    m_date = header.date;
+    return true;
+}
+
+void ReminderSnapshot::close()
+{
+    if (m_data)
+    {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_entries = nullptr;
+    m_count = 0;
+    m_pool = nullptr;
+    m_pool_size = 0;
+}
+
+size_t ReminderSnapshot::size() const
+{
+    return m_count;
+}
+
+const SnapshotEntry &ReminderSnapshot::entry(size_t index) const
+{
+    return m_entries[index];
+}
+
+std::string ReminderSnapshot::title(const SnapshotEntry &entry) const
+{
+    if (static_cast<size_t>(entry.title_offset) + entry.title_length > m_pool_size)
+        return std::string();
+
+    return std::string(m_pool + entry.title_offset, entry.title_length);
+}
+
+int64_t ReminderSnapshot::sync_version() const
+{
+    return m_sync_version;
+}
+
+std::vector<Deadline> ReminderSnapshot::primary_deadlines(const Clock &clock) const
+{
+    std::vector<Deadline> deadlines;
+    deadlines.reserve(m_count);
+
+    // Regular days cost one cached calendar lookup per reminder; on the
+    // days DST changes each time goes through mktime, like next_occurrence
+    Clock::time_point now = clock.now();
+    std::tm today_tm = clock.local_time(now);
+    std::tm tomorrow_tm = following_day(clock, today_tm);
+    bool same_day = m_date == local_date(clock);
+
+    // Entries are sorted by time of day: the ones still due today come
+    // first, in order, then the rest tomorrow, in the same order
+    auto due_today = [&](const SnapshotEntry &entry)
+    {
+        if (same_day && (entry.flags & SNAPSHOT_NOTIFIED))
+            return false;
+
+        auto window = std::chrono::seconds(entry.flags & SNAPSHOT_HAS_SECONDS ? 1 : 60);
+        return local_time_on_day(clock, today_tm, entry.seconds) + window > now;
+    };
+
+    for (size_t i = 0; i < m_count; i++)
+    {
+        if (due_today(m_entries[i]))
+        {
+            deadlines.push_back(Deadline{local_time_on_day(clock, today_tm, m_entries[i].seconds),
+                                         m_entries[i].id, DeadlineKind::Primary});
+        }
+    }
+    for (size_t i = 0; i < m_count; i++)
+    {
+        if (!due_today(m_entries[i]))
+        {
+            deadlines.push_back(Deadline{local_time_on_day(clock, tomorrow_tm, m_entries[i].seconds),
+                                         m_entries[i].id, DeadlineKind::Primary});
+        }
+    }
+
+    return deadlines;
+}
+
+std::string snapshot_path_for(const std::string &db_path)
+{
+    size_t dot = db_path.rfind('.');
+    size_t slash = db_path.rfind('/');
+    std::string base = dot == std::string::npos || (slash != std::string::npos && dot < slash) ? db_path : db_path.substr(0, dot);
+    return base + ".snapshot";
+}
+
+bool write_reminder_snapshot(const std::string &path, const std::map<int, Reminder> &reminders,
+                             int64_t sync_version, const Clock &clock)
+{
+    std::vector<SnapshotEntry> entries;
+    std::string pool;
+    entries.reserve(reminders.size());
+
+    for (const auto &item : reminders)
+    {
+        const Reminder &reminder = item.second;
+        int hour = 0, minute = 0, second = 0;
+        if (reminder.completed || !parse_reminder_time(reminder.time, hour, minute, second))
+            continue;
+
+        SnapshotEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.id = reminder.id;
+        entry.seconds = hour * 3600 + minute * 60 + second;
+        entry.flags = (reminder.notified ? SNAPSHOT_NOTIFIED : 0) |
+                      (reminder.time.size() == 8 ? SNAPSHOT_HAS_SECONDS : 0);
+        entry.priority = static_cast<uint8_t>(reminder.priority);
+        entry.escalate_minutes = reminder.escalate_minutes;
+        entry.title_offset = static_cast<uint32_t>(pool.size());
+        entry.title_length = static_cast<uint32_t>(reminder.title.size());
+        pool += reminder.title;
+        entries.push_back(entry);
+    }
+
+    // The map is in ID order, so a stable sort leaves ties by ID
+    std::stable_sort(entries.begin(), entries.end(), [](const SnapshotEntry &a, const SnapshotEntry &b)
+                     { return a.seconds < b.seconds; });
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.entry_size = sizeof(SnapshotEntry);
+    header.count = entries.size();
+    header.pool_size = pool.size();
+    header.sync_version = sync_version;
+    header.date = local_date(clock);
+
+    std::vector<uint8_t> bytes(sizeof(header) + entries.size() * sizeof(SnapshotEntry) + pool.size());
+    if (!entries.empty())
+        memcpy(bytes.data() + sizeof(header), entries.data(), entries.size() * sizeof(SnapshotEntry));
+    if (!pool.empty())
+        memcpy(bytes.data() + sizeof(header) + entries.size() * sizeof(SnapshotEntry), pool.data(), pool.size());
+    header.checksum = snapshot_checksum(bytes.data() + sizeof(header), bytes.size() - sizeof(header));
+    memcpy(bytes.data(), &header, sizeof(header));
+
+    // Readers see the old file or the new one, never a mix; a crash before
+    // the data reaches disk leaves a file the checksum rejects
+    std::string partial = path + ".partial";
+    FILE *file = fopen(partial.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "Can't write snapshot " << partial << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(partial.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Can't write snapshot " << path << ": " << strerror(errno) << std::endl;
+        unlink(partial.c_str());
+        return false;
+    }
+
+    return true;
+}
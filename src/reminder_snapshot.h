@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "clock.h"
+#include "reminder.h"
+#include "scheduler.h"
+
+// One active reminder in a snapshot: what the scheduler needs to arm it,
+// and where its title is in the string pool
+struct SnapshotEntry
+{
+    int32_t id;
+    int32_t seconds; // After local midnight
+    uint8_t flags;   // SNAPSHOT_* bits
+    uint8_t priority;
+    uint16_t reserved;
+    int32_t escalate_minutes;
+    uint32_t title_offset;
+    uint32_t title_length;
+};
+
+enum SnapshotFlags
+{
+    SNAPSHOT_NOTIFIED = 1,
+    SNAPSHOT_HAS_SECONDS = 2 // Time was "HH:MM:SS", due for one second instead of a minute
+};
+
+// Binary copy of the active (not completed) reminders, written next to the
+// database whenever they change, so the next start can arm the scheduler
+// before SQLite is opened. Entries are fixed size and sorted by time of
+// day, so the file is used in place through mmap: verifying the checksum
+// and producing the sorted deadline run are single linear passes, and
+// nothing is copied to the heap except the deadlines themselves.
+//
+// The file is a cache in the machine's native byte order. A snapshot that
+// is missing, truncated, from another format version or fails its checksum
+// is ignored, and the database is loaded as before.
+class ReminderSnapshot
+{
+public:
+    ReminderSnapshot();
+    virtual ~ReminderSnapshot();
+
+    // Map and verify the snapshot at path. On failure error says why.
+    bool open(const std::string &path, std::string &error);
+    void close();
+
+    size_t size() const;
+    const SnapshotEntry &entry(size_t index) const;
+    std::string title(const SnapshotEntry &entry) const;
+
+    // Change version of the database when the snapshot was written
+    int64_t sync_version() const;
+
+    // Primary deadlines of every reminder, sorted for Scheduler::preload,
+    // by the same rules as Scheduler::arm. Notified flags recorded on an
+    // earlier day are ignored, as the daily reset would clear them.
+    std::vector<Deadline> primary_deadlines(const Clock &clock) const;
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+    const SnapshotEntry *m_entries;
+    size_t m_count;
+    const char *m_pool;
+    size_t m_pool_size;
+    int64_t m_sync_version;
+    int32_t m_date;
+};
+
+// Where the snapshot of the database at db_path lives
+std::string snapshot_path_for(const std::string &db_path);
+
+// Write the active reminders among reminders to path, replacing it
+// atomically. sync_version is the database's change version they match.
+bool write_reminder_snapshot(const std::string &path, const std::map<int, Reminder> &reminders,
+                             int64_t sync_version, const Clock &clock);
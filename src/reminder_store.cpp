@@ -0,0 +1,197 @@
+#include "reminder_store.h"
+#include <algorithm>
+
+void ReminderStore::clear()
+{
+    m_reminders.clear();
+    m_active.clear();
+    m_pending.clear();
+    for (auto &ids : m_by_priority)
+    {
+        ids.clear();
+    }
+    m_by_tag.clear();
+}
+
+void ReminderStore::upsert(const Reminder &reminder)
+{
+    auto it = m_reminders.find(reminder.id);
+    if (it != m_reminders.end())
+    {
+        unindex(it->second);
+        it->second = reminder;
+    }
+    else
+    {
+        m_reminders.emplace(reminder.id, reminder);
+    }
+
+    index(reminder);
+}
+
+void ReminderStore::remove(int id)
+{
+    auto it = m_reminders.find(id);
+    if (it == m_reminders.end())
+        return;
+
+    unindex(it->second);
+    m_reminders.erase(it);
+}
+
+const Reminder *ReminderStore::find(int id) const
+{
+    auto it = m_reminders.find(id);
+    return it != m_reminders.end() ? &it->second : nullptr;
+}
+
+size_t ReminderStore::size() const
+{
+    return m_reminders.size();
+}
+
+size_t ReminderStore::fired_count() const
+{
+    // Pending is the part of active that has not fired
+    return m_active.size() - m_pending.size();
+}
+
+const std::map<int, Reminder> &ReminderStore::all() const
+{
+    return m_reminders;
+}
+
+static int clamp_priority(int priority)
+{
+    return std::max(static_cast<int>(PRIORITY_LOW), std::min(priority, static_cast<int>(PRIORITY_HIGH)));
+}
+
+void ReminderStore::index(const Reminder &reminder)
+{
+    if (!reminder.completed)
+    {
+        m_active.insert(reminder.id);
+        if (!reminder.notified)
+        {
+            m_pending.insert(reminder.id);
+        }
+    }
+
+    m_by_priority[clamp_priority(reminder.priority)].insert(reminder.id);
+
+    for (const auto &tag : reminder.tags)
+    {
+        m_by_tag[tag].insert(reminder.id);
+    }
+}
+
+void ReminderStore::unindex(const Reminder &reminder)
+{
+    m_active.erase(reminder.id);
+    m_pending.erase(reminder.id);
+    m_by_priority[clamp_priority(reminder.priority)].erase(reminder.id);
+
+    for (const auto &tag : reminder.tags)
+    {
+        auto it = m_by_tag.find(tag);
+        if (it == m_by_tag.end())
+            continue;
+
+        it->second.erase(reminder.id);
+        if (it->second.empty())
+        {
+            m_by_tag.erase(it);
+        }
+    }
+}
+
+bool ReminderStore::matches(const ReminderFilter &filter, const Reminder &reminder) const
+{
+    if (filter.hide_completed && reminder.completed)
+        return false;
+    if (filter.pending_today && (reminder.completed || reminder.notified))
+        return false;
+    if (clamp_priority(reminder.priority) < filter.min_priority)
+        return false;
+    if (!filter.tag.empty() &&
+        std::find(reminder.tags.begin(), reminder.tags.end(), filter.tag) == reminder.tags.end())
+        return false;
+
+    return true;
+}
+
+std::vector<int> ReminderStore::query(const ReminderFilter &filter) const
+{
+    static const std::set<int> no_ids;
+
+    // Collect the index sets that constrain the result
+    std::vector<const std::set<int> *> sets;
+
+    if (filter.pending_today)
+    {
+        sets.push_back(&m_pending);
+    }
+    else if (filter.hide_completed)
+    {
+        sets.push_back(&m_active);
+    }
+
+    if (!filter.tag.empty())
+    {
+        auto it = m_by_tag.find(filter.tag);
+        sets.push_back(it != m_by_tag.end() ? &it->second : &no_ids);
+    }
+
+    // A single priority band is an index set; a range is checked per row
+    if (filter.min_priority == PRIORITY_HIGH)
+    {
+        sets.push_back(&m_by_priority[PRIORITY_HIGH]);
+    }
+
+    std::vector<int> ids;
+
+    if (sets.empty())
+    {
+        ids.reserve(m_reminders.size());
+        for (const auto &entry : m_reminders)
+        {
+            if (matches(filter, entry.second))
+            {
+                ids.push_back(entry.first);
+            }
+        }
+        return ids;
+    }
+
+    // Walk the smallest set and probe the others
+    std::sort(sets.begin(), sets.end(),
+              [](const std::set<int> *a, const std::set<int> *b)
+              { return a->size() < b->size(); });
+
+    for (int id : *sets.front())
+    {
+        bool in_all = true;
+        for (size_t i = 1; i < sets.size() && in_all; i++)
+        {
+            in_all = sets[i]->count(id) != 0;
+        }
+
+        if (in_all && (filter.min_priority <= PRIORITY_LOW || matches(filter, m_reminders.at(id))))
+        {
+            ids.push_back(id);
+        }
+    }
+
+    return ids;
+}
+
+std::vector<std::string> ReminderStore::tags() const
+{
+    std::vector<std::string> names;
+    names.reserve(m_by_tag.size());
+    for (const auto &entry : m_by_tag)
+    {
+        names.push_back(entry.first);
+    }
+    return names;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "reminder.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Criteria for a filtered view. Empty tag means any tag.
+struct ReminderFilter
+{
+    bool hide_completed = false;
+    bool pending_today = false; // Only reminders that have not fired today
+    int min_priority = PRIORITY_LOW;
+    std::string tag;
+};
+
+// In-memory reminder set with secondary indexes, so filtered views are
+// answered from the smallest matching index instead of a full scan
+class ReminderStore
+{
+public:
+    void clear();
+    void upsert(const Reminder &reminder);
+    void remove(int id);
+
+    const Reminder *find(int id) const;
+    size_t size() const;
+
+    // Reminders that fired today and are not completed yet
+    size_t fired_count() const;
+    const std::map<int, Reminder> &all() const;
+
+    // IDs matching the filter, in ascending ID order
+    std::vector<int> query(const ReminderFilter &filter) const;
+    bool matches(const ReminderFilter &filter, const Reminder &reminder) const;
+
+    // Every tag currently in use, sorted
+    std::vector<std::string> tags() const;
+
+private:
+    std::map<int, Reminder> m_reminders;
+
+    // Secondary indexes
+    std::set<int> m_active;                        // Not completed
+    std::set<int> m_pending;                       // Not completed and not notified
+    std::set<int> m_by_priority[PRIORITY_HIGH + 1];
+    std::map<std::string, std::set<int>> m_by_tag;
+
+    void index(const Reminder &reminder);
+    void unindex(const Reminder &reminder);
+};
@@ -0,0 +1,69 @@
+// reminderd: serves the reminders of many users from one process, for
+// multi-seat terminal servers where a full desktop app per user is too
+// expensive. Run as root from data/reminderd.service.
+//
+// Usage: reminderd [--all-users] [--user NAME]... [--lock PATH]
+
+#include "notification_bridge.h"
+#include "reminder_service.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    // Delivery children re-execute this binary as the target user
+    if (argc > 1 && strcmp(argv[1], "--deliver") == 0)
+    {
+        return run_delivery(argc, argv);
+    }
+
+    bool all_users = false;
+    std::vector<std::string> users;
+    std::string lock_path = SERVICE_LOCK_PATH;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--all-users") == 0)
+            all_users = true;
+        else if (strcmp(argv[i], "--user") == 0 && i + 1 < argc)
+            users.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--lock") == 0 && i + 1 < argc)
+            lock_path = argv[++i];
+        else
+        {
+            std::cerr << "Usage: reminderd [--all-users] [--user NAME]... [--lock PATH]" << std::endl;
+            return 2;
+        }
+    }
+
+    // One service per host; users' apps test this lock before notifying
+    int lock_fd = open(lock_path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (lock_fd == -1 || flock(lock_fd, LOCK_EX | LOCK_NB) == -1)
+    {
+        std::cerr << "Another instance of reminderd is already running, or " << lock_path << " is not writable" << std::endl;
+        return 1;
+    }
+
+    ReminderService service;
+    for (const auto &name : users)
+    {
+        service.add_user(name);
+    }
+    if (all_users)
+    {
+        service.add_all_users();
+    }
+
+    if (service.user_count() == 0 && !all_users)
+    {
+        std::cerr << "No users to serve; pass --all-users or --user NAME" << std::endl;
+        return 2;
+    }
+
+    return service.run(all_users);
+}
@@ -0,0 +1,368 @@
+#include "scheduler.h"
+#include "time_utils.h"
+#include <algorithm>
+
+const char *deadline_kind_name(DeadlineKind kind)
+{
+    switch (kind)
+    {
+    case DeadlineKind::Primary:
+        return "primary";
+    case DeadlineKind::Snooze:
+        return "snooze";
+    case DeadlineKind::Escalation:
+        return "escalation";
+    default:
+        return "rollover";
+    }
+}
+
+Scheduler::Scheduler(Clock &clock) : m_clock(clock),
+                                     m_running(false),
+                                     m_preload_next(0)
+{
+}
+
+Scheduler::~Scheduler()
+{
+    stop();
+}
+
+void Scheduler::start(FireCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running)
+        return;
+
+    m_callback = callback;
+    m_running = true;
+    m_thread = std::thread(&Scheduler::run, this);
+}
+
+void Scheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeup.notify_all();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void Scheduler::schedule(int reminder_id, DeadlineKind kind, time_point when)
+{
+    bool new_front;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        new_front = schedule_locked(Handle(reminder_id, kind), when);
+    }
+
+    // Only an earlier deadline changes how long the worker should sleep
+    if (new_front)
+    {
+        m_wakeup.notify_one();
+    }
+}
+
+void Scheduler::cancel(int reminder_id, DeadlineKind kind)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    erase_locked(Handle(reminder_id, kind));
+}
+
+void Scheduler::cancel_all(int reminder_id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    erase_locked(Handle(reminder_id, DeadlineKind::Primary));
+    erase_locked(Handle(reminder_id, DeadlineKind::Snooze));
+    erase_locked(Handle(reminder_id, DeadlineKind::Escalation));
+    erase_locked(Handle(reminder_id, DeadlineKind::DayRollover));
+}
+
+size_t Scheduler::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Approximate while deadlines are preloaded: a superseded one may
+    // already have fired
+    size_t preloaded = m_preloaded.size() - m_preload_next;
+    return m_queue.size() + preloaded - std::min(preloaded, m_preload_superseded.size());
+}
+
+bool Scheduler::next_deadline(time_point &when) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return front_locked(when);
+}
+
+void Scheduler::preload(std::vector<Deadline> deadlines)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_preloaded = std::move(deadlines);
+        m_preload_next = 0;
+        m_preload_superseded.clear();
+    }
+    m_wakeup.notify_one();
+}
+
+void Scheduler::drop_preloaded()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_preloaded.clear();
+    m_preloaded.shrink_to_fit();
+    m_preload_next = 0;
+    m_preload_superseded.clear();
+}
+
+// Index of the first preloaded deadline still in force
+size_t Scheduler::preload_front_locked() const
+{
+    size_t i = m_preload_next;
+    while (i < m_preloaded.size() && m_preload_superseded.count(m_preloaded[i].reminder_id))
+    {
+        i++;
+    }
+    return i;
+}
+
+bool Scheduler::front_locked(time_point &when) const
+{
+    size_t preloaded = preload_front_locked();
+    bool found = false;
+
+    if (!m_queue.empty())
+    {
+        when = std::get<0>(*m_queue.begin());
+        found = true;
+    }
+    if (preloaded < m_preloaded.size() && (!found || m_preloaded[preloaded].when < when))
+    {
+        when = m_preloaded[preloaded].when;
+        found = true;
+    }
+
+    return found;
+}
+
+void Scheduler::arm(const Reminder &reminder)
+{
+    if (reminder.completed)
+    {
+        cancel_all(reminder.id);
+        return;
+    }
+
+    // Worked out before taking the lock, as the occurrence may need mktime
+    time_point primary = next_occurrence(m_clock, reminder.time, reminder.notified);
+    time_point escalation = m_clock.now() + std::chrono::minutes(reminder.escalate_minutes);
+
+    // One decision under one lock, so the worker can't pop or the app
+    // cancel a deadline between looking at the queue and changing it
+    bool new_front = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // A reminder with an unreadable time is kept but never fires
+        Handle primary_handle(reminder.id, DeadlineKind::Primary);
+        if (primary == time_point::max())
+            erase_locked(primary_handle);
+        else
+            new_front = schedule_locked(primary_handle, primary);
+
+        // A pending snooze stands in for the escalation until it fires
+        Handle escalation_handle(reminder.id, DeadlineKind::Escalation);
+        if (!reminder.notified || reminder.escalate_minutes <= 0)
+        {
+            erase_locked(escalation_handle);
+        }
+        else if (!m_index.count(escalation_handle) &&
+                 !m_index.count(Handle(reminder.id, DeadlineKind::Snooze)))
+        {
+            new_front = schedule_locked(escalation_handle, escalation) || new_front;
+        }
+    }
+
+    if (new_front)
+    {
+        m_wakeup.notify_one();
+    }
+}
+
+void Scheduler::arm_day_rollover()
+{
+    schedule(0, DeadlineKind::DayRollover, next_midnight(m_clock));
+}
+
+void Scheduler::escalate(const Reminder &reminder)
+{
+    if (reminder.completed || reminder.escalate_minutes <= 0)
+        return;
+
+    schedule(reminder.id, DeadlineKind::Escalation,
+             m_clock.now() + std::chrono::minutes(reminder.escalate_minutes));
+}
+
+Clock &Scheduler::clock() const
+{
+    return m_clock;
+}
+
+bool Scheduler::next_fire(int reminder_id, time_point &when) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool found = false;
+
+    for (DeadlineKind kind : {DeadlineKind::Primary, DeadlineKind::Snooze})
+    {
+        auto it = m_index.find(Handle(reminder_id, kind));
+        if (it != m_index.end() && (!found || it->second < when))
+        {
+            when = it->second;
+            found = true;
+        }
+    }
+
+    // A linear scan, but only until the preloaded run is dropped
+    if (!m_preloaded.empty() && !m_preload_superseded.count(reminder_id))
+    {
+        for (size_t i = m_preload_next; i < m_preloaded.size(); i++)
+        {
+            if (m_preloaded[i].reminder_id == reminder_id)
+            {
+                if (!found || m_preloaded[i].when < when)
+                    when = m_preloaded[i].when;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+std::vector<Deadline> Scheduler::upcoming(size_t limit) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Deadline> result;
+
+    // The queue and the preloaded run are both in fire order; merge them
+    // and skip internal deadlines
+    auto it = m_queue.begin();
+    size_t preloaded = m_preload_next;
+
+    while (result.size() < limit)
+    {
+        while (preloaded < m_preloaded.size() && m_preload_superseded.count(m_preloaded[preloaded].reminder_id))
+        {
+            preloaded++;
+        }
+
+        bool have_queued = it != m_queue.end();
+        bool have_preloaded = preloaded < m_preloaded.size();
+        if (!have_queued && !have_preloaded)
+            break;
+
+        if (have_preloaded && (!have_queued || m_preloaded[preloaded].when < std::get<0>(*it)))
+        {
+            result.push_back(m_preloaded[preloaded++]);
+            continue;
+        }
+
+        if (std::get<2>(*it) != DeadlineKind::DayRollover)
+        {
+            result.push_back(Deadline{std::get<0>(*it), std::get<1>(*it), std::get<2>(*it)});
+        }
+        ++it;
+    }
+
+    return result;
+}
+
+std::vector<Deadline> Scheduler::pop_due(time_point now)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Deadline> due;
+
+    while (!m_queue.empty() && std::get<0>(*m_queue.begin()) <= now)
+    {
+        const Key &key = *m_queue.begin();
+        due.push_back(Deadline{std::get<0>(key), std::get<1>(key), std::get<2>(key)});
+        m_index.erase(Handle(std::get<1>(key), std::get<2>(key)));
+        m_queue.erase(m_queue.begin());
+    }
+
+    for (m_preload_next = preload_front_locked();
+         m_preload_next < m_preloaded.size() && m_preloaded[m_preload_next].when <= now;
+         m_preload_next = preload_front_locked())
+    {
+        due.push_back(m_preloaded[m_preload_next++]);
+    }
+
+    // Keep each batch in fire order
+    if (m_preload_next > 0 && !due.empty())
+    {
+        std::stable_sort(due.begin(), due.end(), [](const Deadline &a, const Deadline &b)
+                         { return a.when < b.when; });
+    }
+
+    return due;
+}
+
+bool Scheduler::schedule_locked(const Handle &handle, time_point when)
+{
+    erase_locked(handle);
+
+    auto inserted = m_queue.insert(Key(when, handle.first, handle.second)).first;
+    m_index[handle] = when;
+    return inserted == m_queue.begin();
+}
+
+void Scheduler::erase_locked(const Handle &handle)
+{
+    if (handle.second == DeadlineKind::Primary && m_preload_next < m_preloaded.size())
+    {
+        m_preload_superseded.insert(handle.first);
+    }
+
+    auto it = m_index.find(handle);
+    if (it == m_index.end())
+        return;
+
+    m_queue.erase(Key(it->second, handle.first, handle.second));
+    m_index.erase(it);
+}
+
+void Scheduler::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_running)
+    {
+        // Sleep until the earliest deadline, or until the queue changes
+        time_point next;
+        if (!front_locked(next))
+        {
+            m_wakeup.wait(lock);
+            continue;
+        }
+
+        if (m_clock.now() < next)
+        {
+            m_clock.wait_until(m_wakeup, lock, next);
+            continue;
+        }
+
+        lock.unlock();
+        std::vector<Deadline> due = pop_due(m_clock.now());
+        if (!due.empty() && m_callback)
+        {
+            m_callback(due);
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "clock.h"
+#include "reminder.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+// What a deadline in the queue stands for
+enum class DeadlineKind
+{
+    Primary,    // The reminder's next daily occurrence
+    Snooze,     // One-off deadline requested from a notification
+    Escalation, // Repeat notification for a reminder nobody has acknowledged
+    DayRollover // Local midnight, used to reset the daily notification state
+};
+
+// Short lowercase name of a deadline kind, for logs and exported events
+const char *deadline_kind_name(DeadlineKind kind);
+
+struct Deadline
+{
+    std::chrono::system_clock::time_point when;
+    int reminder_id;
+    DeadlineKind kind;
+};
+
+// Deadline queue ordered by fire time. Each (reminder, kind) pair has at most
+// one entry, so scheduling again repositions it. All operations are O(log n);
+// the worker thread sleeps until the earliest deadline instead of polling.
+// Time comes from the injected clock.
+class Scheduler
+{
+public:
+    typedef Clock::time_point time_point;
+    typedef std::function<void(const std::vector<Deadline> &)> FireCallback;
+
+    explicit Scheduler(Clock &clock = system_clock());
+    virtual ~Scheduler();
+
+    // Start/stop the worker thread. The callback runs on the worker thread.
+    void start(FireCallback callback);
+    void stop();
+
+    // Queue maintenance, safe to call from any thread
+    void schedule(int reminder_id, DeadlineKind kind, time_point when);
+    void cancel(int reminder_id, DeadlineKind kind);
+    void cancel_all(int reminder_id);
+    size_t size() const;
+    bool next_deadline(time_point &when) const;
+
+    // Scheduling rules for daily reminders: a reminder is due at its next
+    // occurrence, tomorrow's if it already fired today, and not at all once
+    // completed. The rollover deadline resets the daily state at midnight.
+    // A reminder with an escalation policy that fired today keeps an
+    // escalation deadline until it is completed, snoozed or reset.
+    void arm(const Reminder &reminder);
+    void arm_day_rollover();
+    void escalate(const Reminder &reminder);
+    Clock &clock() const;
+
+    // Arm primary deadlines in bulk, e.g. from the startup snapshot. They
+    // must be sorted by time and ID. Instead of being indexed one by one
+    // they are kept as a sorted run consumed from the front, so arming
+    // 100k reminders costs little more than copying the vector. Scheduling
+    // or cancelling a reminder's primary deadline afterwards supersedes its
+    // preloaded one. Preloaded deadlines stay until drop_preloaded(), which
+    // is called once the same reminders have been armed individually.
+    void preload(std::vector<Deadline> deadlines);
+    void drop_preloaded();
+
+    // Ordered views of the queue, for rendering what comes next
+    bool next_fire(int reminder_id, time_point &when) const;
+    std::vector<Deadline> upcoming(size_t limit) const;
+
+    // Remove and return every deadline at or before now
+    std::vector<Deadline> pop_due(time_point now);
+
+private:
+    typedef std::tuple<time_point, int, DeadlineKind> Key;
+    typedef std::pair<int, DeadlineKind> Handle;
+
+    std::set<Key> m_queue;                // Ordered by fire time
+    std::map<Handle, time_point> m_index; // Current fire time of each entry
+
+    Clock &m_clock;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::thread m_thread;
+    bool m_running;
+    FireCallback m_callback;
+
+    // Sorted preloaded deadlines; those before m_preload_next are gone
+    std::vector<Deadline> m_preloaded;
+    size_t m_preload_next;
+    std::unordered_set<int> m_preload_superseded;
+
+    void run();
+    size_t preload_front_locked() const;
+    bool front_locked(time_point &when) const;
+    bool schedule_locked(const Handle &handle, time_point when);
+    void erase_locked(const Handle &handle);
+};
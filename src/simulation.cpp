@@ -0,0 +1,173 @@
+#include "simulation.h"
+#include "clock.h"
+#include "scheduler.h"
+#include "time_utils.h"
+#include <algorithm>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+Simulation::Simulation(const SimulationOptions &options) : m_options(options)
+{
+}
+
+int Simulation::run(std::ostream &out)
+{
+    // Start at the next local midnight so every reminder is due on day one
+    ManualClock clock(next_midnight(system_clock()));
+    Scheduler scheduler(clock);
+
+    std::tm end_tm = clock.local_time(clock.now());
+    end_tm.tm_mday += m_options.days;
+    Clock::time_point end = clock.from_local_time(end_tm);
+
+    // Seeded random reminders; index 0 is unused so IDs match positions
+    std::mt19937 rng(m_options.seed);
+    std::uniform_int_distribution<int> hour_dist(0, 23);
+    std::uniform_int_distribution<int> minute_dist(0, 59);
+    std::uniform_real_distribution<double> snooze_dist(0.0, 1.0);
+
+    std::vector<Reminder> reminders(m_options.reminders + 1);
+    for (int id = 1; id <= m_options.reminders; id++)
+    {
+        int hour = hour_dist(rng);
+        int minute = minute_dist(rng);
+        int second = m_options.seconds ? minute_dist(rng) : 0;
+
+        Reminder &reminder = reminders[id];
+        reminder.id = id;
+        reminder.title = "Reminder " + std::to_string(id);
+        reminder.time = format_reminder_time(hour, minute, second);
+        reminder.completed = false;
+        reminder.notified = false;
+        scheduler.arm(reminder);
+    }
+    scheduler.arm_day_rollover();
+
+    std::vector<unsigned char> fired_today(reminders.size(), 0);
+    std::vector<long long> lateness_ms;
+    long long primary_fires = 0;
+    long long snooze_fires = 0;
+    long long missed = 0;
+    long long duplicates = 0;
+    int day = 0;
+
+    auto check_day = [&]()
+    {
+        for (int id = 1; id <= m_options.reminders; id++)
+        {
+            if (fired_today[id] == 0)
+                missed++;
+            else if (fired_today[id] > 1)
+                duplicates += fired_today[id] - 1;
+        }
+        std::fill(fired_today.begin(), fired_today.end(), 0);
+    };
+
+    auto wall_start = std::chrono::steady_clock::now();
+
+    Clock::time_point next;
+    while (scheduler.next_deadline(next) && next < end)
+    {
+        if (m_options.step_seconds > 0)
+        {
+            // Only notice deadlines on the next polling tick
+            auto step = std::chrono::seconds(m_options.step_seconds);
+            auto behind = next - clock.now();
+            if (behind > Clock::time_point::duration::zero())
+            {
+                clock.advance(((behind + step - std::chrono::nanoseconds(1)) / step) * step);
+            }
+        }
+        else if (clock.now() < next)
+        {
+            clock.set(next);
+        }
+
+        for (const auto &deadline : scheduler.pop_due(clock.now()))
+        {
+            if (deadline.kind == DeadlineKind::DayRollover)
+            {
+                check_day();
+                day++;
+                for (int id = 1; id <= m_options.reminders; id++)
+                {
+                    reminders[id].notified = false;
+                    scheduler.arm(reminders[id]);
+                }
+                scheduler.arm_day_rollover();
+                continue;
+            }
+
+            long long late = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 clock.now() - deadline.when)
+                                 .count();
+            lateness_ms.push_back(late);
+
+            if (m_options.print_events)
+            {
+                std::tm fired_tm = clock.local_time(clock.now());
+                out << "fire\t" << std::put_time(&fired_tm, "%Y-%m-%d %H:%M:%S") << "\t"
+                    << deadline.reminder_id << "\t" << deadline_kind_name(deadline.kind) << "\t"
+                    << late << "\n";
+            }
+
+            Reminder &reminder = reminders[deadline.reminder_id];
+            if (deadline.kind == DeadlineKind::Snooze)
+            {
+                snooze_fires++;
+                continue;
+            }
+
+            primary_fires++;
+            fired_today[reminder.id]++;
+            reminder.notified = true;
+            scheduler.arm(reminder);
+
+            if (snooze_dist(rng) < m_options.snooze_ratio)
+            {
+                scheduler.schedule(reminder.id, DeadlineKind::Snooze, clock.now() + std::chrono::minutes(5));
+            }
+        }
+    }
+
+    // The last day ends without a rollover inside the window
+    if (day < m_options.days)
+    {
+        check_day();
+    }
+
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    long long total = 0;
+    long long max_late = 0;
+    long long p99 = 0;
+    for (long long late : lateness_ms)
+    {
+        total += late;
+        max_late = std::max(max_late, late);
+    }
+    if (!lateness_ms.empty())
+    {
+        auto nth = lateness_ms.begin() + (lateness_ms.size() * 99) / 100;
+        std::nth_element(lateness_ms.begin(), nth, lateness_ms.end());
+        p99 = *nth;
+    }
+
+    size_t events = lateness_ms.size();
+    out << "Simulated " << m_options.reminders << " reminders over " << m_options.days << " day(s)";
+    if (m_options.step_seconds > 0)
+    {
+        out << " with a " << m_options.step_seconds << "s polling step";
+    }
+    out << "\n"
+        << "Fire events: " << events << " (primary " << primary_fires << ", snooze " << snooze_fires << ")\n"
+        << "Lateness ms: avg " << (events ? total / static_cast<long long>(events) : 0)
+        << ", p99 " << p99 << ", max " << max_late << "\n"
+        << "Missed: " << missed << ", duplicates: " << duplicates << "\n"
+        << std::fixed << std::setprecision(2)
+        << "Wall time: " << wall_seconds << " s ("
+        << (wall_seconds > 0 ? events / wall_seconds : 0) << " events/s)" << std::endl;
+
+    return (missed == 0 && duplicates == 0) ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ostream>
+
+struct SimulationOptions
+{
+    int reminders = 100000;
+    int days = 1;
+    int step_seconds = 0;      // 0 jumps straight to each deadline; >0 models a polling loop
+    double snooze_ratio = 0.0; // Fraction of fired reminders that get snoozed for 5 minutes
+    unsigned seed = 1;
+    bool seconds = false;      // Random "HH:MM:SS" times instead of whole minutes
+    bool print_events = false; // One line per fire event
+};
+
+// Replays days of virtual time through the real Scheduler and scheduling
+// rules using a ManualClock. Reports every fire event's lateness and checks
+// that each active reminder fires exactly once per day.
+class Simulation
+{
+public:
+    explicit Simulation(const SimulationOptions &options);
+
+    // Returns 0 when every check passed
+    int run(std::ostream &out);
+
+private:
+    SimulationOptions m_options;
+};
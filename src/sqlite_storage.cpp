@@ -0,0 +1,572 @@
+#include "sqlite_storage.h"
+#include <iostream>
+#include <unordered_map>
+
+// Writes and multi-statement reads join a transaction the caller already
+// holds, and otherwise run in one of their own. Returns whether one was begun.
+static bool begin_unless_nested(sqlite3 *db)
+{
+    if (!sqlite3_get_autocommit(db))
+        return false;
+
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+    return true;
+}
+
+static void finish(sqlite3 *db, bool begun, bool ok)
+{
+    if (begun)
+    {
+        sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+}
+
+SqliteStorage::SqliteStorage(bool sync, Clock &clock) : m_db(nullptr),
+                                                        m_owned(false),
+                                                        m_sync(sync),
+                                                        m_clock(clock)
+{
+}
+
+// completed_at is in seconds since the epoch
+sqlite3_int64 SqliteStorage::now_seconds() const
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(m_clock.now().time_since_epoch()).count();
+}
+
+SqliteStorage::~SqliteStorage()
+{
+    close();
+}
+
+const char *SqliteStorage::name() const
+{
+    return m_sync ? "sqlite" : "sqlite-nosync";
+}
+
+bool SqliteStorage::open(const std::string &path)
+{
+    close();
+
+    sqlite3 *db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+    {
+        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return false;
+    }
+
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    sqlite3_busy_timeout(db, 2000);
+    if (!m_sync)
+    {
+        sqlite3_exec(db, "PRAGMA synchronous=OFF;", nullptr, nullptr, nullptr);
+    }
+
+    attach(db);
+    m_owned = true;
+    return true;
+}
+
+void SqliteStorage::close()
+{
+    if (m_owned)
+    {
+        sqlite3_close(m_db);
+    }
+    m_db = nullptr;
+    m_owned = false;
+}
+
+void SqliteStorage::attach(sqlite3 *db)
+{
+    close();
+    m_db = db;
+    create_schema();
+}
+
+void SqliteStorage::create_schema()
+{
+    const char *create_table_sql =
+        "CREATE TABLE IF NOT EXISTS reminders("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "title TEXT NOT NULL,"
+        "description TEXT,"
+        "time TEXT NOT NULL,"
+        "completed INTEGER DEFAULT 0,"
+        "notified INTEGER DEFAULT 0,"
+        "row_version INTEGER DEFAULT 0,"
+        "priority INTEGER DEFAULT 1,"
+        "completed_at INTEGER,"
+        "escalate_minutes INTEGER DEFAULT 0);";
+
+    char *err_msg = nullptr;
+    int rc = sqlite3_exec(m_db, create_table_sql, nullptr, nullptr, &err_msg);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "SQL error: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        err_msg = nullptr;
+    }
+
+    // Databases created by older releases lack the later columns; add them in
+    // place. A fresh database already has them all from the CREATE above.
+    ensure_column("notified", "INTEGER DEFAULT 0");
+    ensure_column("row_version", "INTEGER DEFAULT 0");
+    ensure_column("priority", "INTEGER DEFAULT 1");
+    ensure_column("completed_at", "INTEGER");
+    ensure_column("escalate_minutes", "INTEGER DEFAULT 0");
+
+    // Tags (which double as lists) live in a join table. Tag changes touch the
+    // owning reminder so they travel with its row_version.
+    const char *tags_schema_sql =
+        "CREATE TABLE IF NOT EXISTS tags("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "name TEXT NOT NULL UNIQUE);"
+        "CREATE TABLE IF NOT EXISTS reminder_tags("
+        "reminder_id INTEGER NOT NULL,"
+        "tag_id INTEGER NOT NULL,"
+        "PRIMARY KEY (reminder_id, tag_id)) WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS idx_reminder_tags_tag ON reminder_tags(tag_id, reminder_id);"
+        "CREATE INDEX IF NOT EXISTS idx_reminders_active ON reminders(completed, priority, time);"
+        "CREATE INDEX IF NOT EXISTS idx_reminders_time ON reminders(time);"
+        "CREATE TRIGGER IF NOT EXISTS reminder_tags_insert AFTER INSERT ON reminder_tags "
+        "BEGIN "
+        "UPDATE reminders SET row_version = row_version WHERE id = NEW.reminder_id;"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS reminder_tags_delete AFTER DELETE ON reminder_tags "
+        "BEGIN "
+        "UPDATE reminders SET row_version = row_version WHERE id = OLD.reminder_id;"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS reminders_delete_tags AFTER DELETE ON reminders "
+        "BEGIN "
+        "DELETE FROM reminder_tags WHERE reminder_id = OLD.id;"
+        "END;";
+
+    rc = sqlite3_exec(m_db, tags_schema_sql, nullptr, nullptr, &err_msg);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "SQL error when creating tags schema: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+    }
+}
+
+void SqliteStorage::ensure_column(const std::string &name, const std::string &definition)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(m_db, "PRAGMA table_info(reminders);", -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+        return;
+
+    bool has_column = false;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::string column_name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        if (column_name == name)
+        {
+            has_column = true;
+            break;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    // Add the column if it doesn't exist
+    if (!has_column)
+    {
+        std::cout << "Adding '" << name << "' column to existing database..." << std::endl;
+        std::string alter_table_sql = "ALTER TABLE reminders ADD COLUMN " + name + " " + definition + ";";
+        char *err_msg = nullptr;
+        rc = sqlite3_exec(m_db, alter_table_sql.c_str(), nullptr, nullptr, &err_msg);
+
+        if (rc != SQLITE_OK)
+        {
+            std::cerr << "SQL error when adding " << name << " column: " << err_msg << std::endl;
+            sqlite3_free(err_msg);
+        }
+    }
+}
+
+Reminder SqliteStorage::read_row(sqlite3_stmt *stmt)
+{
+    Reminder reminder;
+    reminder.id = sqlite3_column_int(stmt, 0);
+    reminder.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+
+    const unsigned char *description = sqlite3_column_text(stmt, 2);
+    if (description)
+    {
+        reminder.description = reinterpret_cast<const char *>(description);
+    }
+
+    reminder.time = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+    reminder.completed = sqlite3_column_int(stmt, 4) != 0;
+    reminder.notified = sqlite3_column_int(stmt, 5) != 0;
+    reminder.priority = sqlite3_column_int(stmt, 6);
+    reminder.escalate_minutes = sqlite3_column_int(stmt, 7);
+
+    return reminder;
+}
+
+void SqliteStorage::load_tags(Reminder &reminder)
+{
+    const char *sql = "SELECT t.name FROM reminder_tags rt JOIN tags t ON t.id = rt.tag_id "
+                      "WHERE rt.reminder_id = ? ORDER BY t.name;";
+    sqlite3_stmt *stmt;
+
+    reminder.tags.clear();
+
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
+        return;
+    }
+
+    sqlite3_bind_int(stmt, 1, reminder.id);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        reminder.tags.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+void SqliteStorage::save_tags(int id, const std::vector<std::string> &tags)
+{
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(m_db, "DELETE FROM reminder_tags WHERE reminder_id = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_int(stmt, 1, id);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+
+    for (const auto &tag : tags)
+    {
+        if (sqlite3_prepare_v2(m_db, "INSERT OR IGNORE INTO tags (name) VALUES (?);", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, tag.c_str(), -1, SQLITE_STATIC);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+
+        const char *link_sql = "INSERT OR IGNORE INTO reminder_tags (reminder_id, tag_id) "
+                               "SELECT ?, id FROM tags WHERE name = ?;";
+        if (sqlite3_prepare_v2(m_db, link_sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_int(stmt, 1, id);
+            sqlite3_bind_text(stmt, 2, tag.c_str(), -1, SQLITE_STATIC);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+    }
+}
+
+bool SqliteStorage::load_all(std::vector<Reminder> &reminders)
+{
+    if (!m_db)
+        return false;
+
+    // Read the rows and their tags from one snapshot
+    bool begun = begin_unless_nested(m_db);
+
+    const char *sql = "SELECT id, title, description, time, completed, notified, priority, escalate_minutes FROM reminders;";
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
+        finish(m_db, begun, true);
+        return false;
+    }
+
+    std::unordered_map<int, size_t> index;
+    reminders.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        reminders.push_back(read_row(stmt));
+        index.emplace(reminders.back().id, reminders.size() - 1);
+    }
+
+    sqlite3_finalize(stmt);
+
+    // Attach tags with one pass over the join table
+    const char *tags_sql = "SELECT rt.reminder_id, t.name FROM reminder_tags rt "
+                           "JOIN tags t ON t.id = rt.tag_id ORDER BY t.name;";
+    if (sqlite3_prepare_v2(m_db, tags_sql, -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            auto it = index.find(sqlite3_column_int(stmt, 0));
+            if (it != index.end())
+            {
+                reminders[it->second].tags.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    finish(m_db, begun, true);
+    return true;
+}
+
+int SqliteStorage::insert(const Reminder &reminder)
+{
+    return insert_row(reminder, false);
+}
+
+bool SqliteStorage::restore(const Reminder &reminder)
+{
+    return insert_row(reminder, true) != -1;
+}
+
+int SqliteStorage::insert_row(const Reminder &reminder, bool keep_id)
+{
+    if (!m_db)
+        return -1;
+
+    // A NULL id lets SQLite pick the next one
+    const char *sql = "INSERT INTO reminders (title, description, time, completed, notified, priority, escalate_minutes, id, completed_at) "
+                      "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, CASE WHEN ?4 THEN ?9 END);";
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, reminder.title.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, reminder.description.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, reminder.time.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, reminder.completed ? 1 : 0);
+    sqlite3_bind_int(stmt, 5, reminder.notified ? 1 : 0);
+    sqlite3_bind_int(stmt, 6, reminder.priority);
+    sqlite3_bind_int(stmt, 7, reminder.escalate_minutes);
+    if (keep_id)
+    {
+        sqlite3_bind_int(stmt, 8, reminder.id);
+    }
+    else
+    {
+        sqlite3_bind_null(stmt, 8);
+    }
+    sqlite3_bind_int64(stmt, 9, now_seconds());
+
+    // The row and its tags are written together
+    bool begun = begin_unless_nested(m_db);
+
+    rc = sqlite3_step(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Failed to execute statement: " << sqlite3_errmsg(m_db) << std::endl;
+        sqlite3_finalize(stmt);
+        finish(m_db, begun, false);
+        return -1;
+    }
+
+    sqlite3_finalize(stmt);
+
+    int id = static_cast<int>(sqlite3_last_insert_rowid(m_db));
+    save_tags(id, reminder.tags);
+
+    finish(m_db, begun, true);
+    return id;
+}
+
+bool SqliteStorage::update(const Reminder &reminder, bool tags_changed)
+{
+    if (!m_db)
+        return false;
+
+    // completed_at keeps its value unless completed changes
+    const char *sql = "UPDATE reminders SET title = ?1, description = ?2, "
+                      "time = ?3, completed = ?4, notified = ?5, priority = ?6, escalate_minutes = ?7, "
+                      "completed_at = CASE WHEN NOT ?4 THEN NULL WHEN completed THEN completed_at ELSE ?9 END "
+                      "WHERE id = ?8;";
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, reminder.title.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, reminder.description.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, reminder.time.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, reminder.completed ? 1 : 0);
+    sqlite3_bind_int(stmt, 5, reminder.notified ? 1 : 0);
+    sqlite3_bind_int(stmt, 6, reminder.priority);
+    sqlite3_bind_int(stmt, 7, reminder.escalate_minutes);
+    sqlite3_bind_int(stmt, 8, reminder.id);
+    sqlite3_bind_int64(stmt, 9, now_seconds());
+
+    bool begun = begin_unless_nested(m_db);
+
+    rc = sqlite3_step(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Failed to execute statement: " << sqlite3_errmsg(m_db) << std::endl;
+        sqlite3_finalize(stmt);
+        finish(m_db, begun, false);
+        return false;
+    }
+
+    sqlite3_finalize(stmt);
+
+    // No row matched: the reminder is gone, e.g. deleted by another program
+    if (sqlite3_changes(m_db) == 0)
+    {
+        finish(m_db, begun, false);
+        return false;
+    }
+
+    // Only rewrite the join table when the tags actually changed
+    if (tags_changed)
+    {
+        save_tags(reminder.id, reminder.tags);
+    }
+
+    finish(m_db, begun, true);
+    return true;
+}
+
+bool SqliteStorage::contains(int id)
+{
+    if (!m_db)
+        return false;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT 1 FROM reminders WHERE id = ?;", -1, &stmt, nullptr) != SQLITE_OK)
+        return false;
+
+    sqlite3_bind_int(stmt, 1, id);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+bool SqliteStorage::remove(int id)
+{
+    if (!m_db)
+        return false;
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(m_db, "DELETE FROM reminders WHERE id = ?;", -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    rc = sqlite3_step(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Failed to execute statement: " << sqlite3_errmsg(m_db) << std::endl;
+    }
+
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+bool SqliteStorage::set_flag(int id, ReminderFlag flag, bool value)
+{
+    if (!m_db)
+        return false;
+
+    // Single-row write for flag changes coming from notifications
+    const char *sql = flag == ReminderFlag::Completed ? "UPDATE reminders SET completed = ?1, "
+                                                        "completed_at = CASE WHEN NOT ?1 THEN NULL WHEN completed THEN completed_at ELSE ?3 END "
+                                                        "WHERE id = ?2;"
+                                                      : "UPDATE reminders SET notified = ?1 WHERE id = ?2;";
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << std::endl;
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, value ? 1 : 0);
+    sqlite3_bind_int(stmt, 2, id);
+    if (flag == ReminderFlag::Completed)
+    {
+        sqlite3_bind_int64(stmt, 3, now_seconds());
+    }
+
+    rc = sqlite3_step(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Failed to execute statement: " << sqlite3_errmsg(m_db) << std::endl;
+    }
+
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+bool SqliteStorage::reset_notified()
+{
+    if (!m_db)
+        return false;
+
+    // Rows already cleared are left alone, so their row_version doesn't move
+    char *err_msg = nullptr;
+    int rc = sqlite3_exec(m_db, "UPDATE reminders SET notified = 0 WHERE notified != 0;", nullptr, nullptr, &err_msg);
+
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "SQL error when resetting notification status: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteStorage::begin()
+{
+    return m_db && sqlite3_exec(m_db, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+bool SqliteStorage::commit()
+{
+    if (!m_db)
+        return false;
+
+    if (sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to commit: " << sqlite3_errmsg(m_db) << std::endl;
+        rollback();
+        return false;
+    }
+    return true;
+}
+
+void SqliteStorage::rollback()
+{
+    if (m_db && !sqlite3_get_autocommit(m_db))
+    {
+        sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+#include "clock.h"
+#include "storage_engine.h"
+
+// Reminders in the SQLite database shared with reminderd and other
+// programs. The app attaches its own connection, which it also uses for
+// change tracking, the archive and the delivery history; standalone use
+// (e.g. the storage benchmark) opens a connection of its own.
+class SqliteStorage : public StorageEngine
+{
+public:
+    // Sync only applies to connections opened here: with it off, commits
+    // are not flushed to disk. completed_at is stamped from the clock, so
+    // archiving and completion history follow a simulated clock too.
+    explicit SqliteStorage(bool sync = true, Clock &clock = system_clock());
+    virtual ~SqliteStorage();
+
+    const char *name() const override;
+
+    bool open(const std::string &path) override;
+    void close() override;
+
+    // Use a connection owned by the caller, creating the reminders and
+    // tags tables in it if needed
+    void attach(sqlite3 *db);
+
+    bool load_all(std::vector<Reminder> &reminders) override;
+    int insert(const Reminder &reminder) override;
+    bool restore(const Reminder &reminder) override;
+    bool update(const Reminder &reminder, bool tags_changed) override;
+    bool remove(int id) override;
+    bool set_flag(int id, ReminderFlag flag, bool value) override;
+    bool reset_notified() override;
+    bool begin() override;
+    bool commit() override;
+    void rollback() override;
+
+    // Whether a row with this ID exists, e.g. to tell a failed update from
+    // one whose reminder was deleted underneath it
+    bool contains(int id);
+
+    // Row helpers for queries run outside the engine. read_row expects the
+    // columns id, title, description, time, completed, notified, priority,
+    // escalate_minutes first.
+    static Reminder read_row(sqlite3_stmt *stmt);
+    void load_tags(Reminder &reminder);
+
+private:
+    sqlite3 *m_db;
+    bool m_owned;
+    bool m_sync;
+    Clock &m_clock;
+
+    sqlite3_int64 now_seconds() const;
+
+    // Insert with the reminder's own ID if keep_id, else a new one
+    int insert_row(const Reminder &reminder, bool keep_id);
+    void create_schema();
+    void ensure_column(const std::string &name, const std::string &definition);
+    void save_tags(int id, const std::vector<std::string> &tags);
+};
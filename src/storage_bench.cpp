@@ -0,0 +1,306 @@
+// Head to head benchmark of the storage engines.
+//
+// Each engine gets a fresh store in a scratch directory, filled with the
+// same generated reminders. The store is then closed and dropped from the
+// page cache, and reopened to time a cold start (open plus loading every
+// reminder), then a warm one. Next comes a seeded mix of single mutations
+// like the app makes: edits, completion and notified flags, adds and
+// deletes, each timed on its own. File sizes are taken after filling and
+// after the mutations, with the store closed.
+//
+// One tab separated line is printed per engine.
+
+#include "log_storage.h"
+#include "metrics.h"
+#include "sqlite_storage.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct BenchOptions
+{
+    std::string dir;
+    int reminders = 1000;
+    int mutations = 2000;
+    bool sync = true;
+    bool keep = false;
+};
+
+static void print_usage()
+{
+    std::cerr << "Usage: reminder-storage-bench [options]\n"
+              << "  --dir PATH          where to create the stores (default: a new directory in /tmp)\n"
+              << "  --reminders N       reminders to start with (default 1000)\n"
+              << "  --mutations N       single mutations to time (default 2000)\n"
+              << "  --no-sync           don't flush each mutation to disk, for either engine\n"
+              << "  --keep              leave the stores in place\n";
+}
+
+static bool parse_options(int argc, char *argv[], BenchOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--no-sync")
+            options.sync = false;
+        else if (arg == "--keep")
+            options.keep = true;
+        else if (arg == "--dir" && has_value)
+            options.dir = argv[++i];
+        else if (arg == "--reminders" && has_value)
+            options.reminders = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--mutations" && has_value)
+            options.mutations = std::max(0, std::atoi(argv[++i]));
+        else
+            return false;
+    }
+    return true;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Every file an engine keeps for a store at path
+static std::vector<std::string> store_files(const std::string &path)
+{
+    return {path, path + "-wal", path + "-shm", path + "-journal", path + ".compact"};
+}
+
+static long store_size_kb(const std::string &path)
+{
+    long bytes = 0;
+    for (const auto &file : store_files(path))
+    {
+        struct stat st;
+        if (stat(file.c_str(), &st) == 0)
+            bytes += st.st_size;
+    }
+    return (bytes + 1023) / 1024;
+}
+
+// Drop the store from the page cache so the next open reads from disk
+static void evict_store(const std::string &path)
+{
+    for (const auto &file : store_files(path))
+    {
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            continue;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static Reminder generate_reminder(std::mt19937 &rng, int n)
+{
+    static const char *TAGS[] = {"home", "work", "errands", "health", "family"};
+
+    Reminder reminder;
+    reminder.id = -1;
+    reminder.title = "Reminder " + std::to_string(n);
+    reminder.description = "Generated by the storage benchmark, number " + std::to_string(n);
+
+    char time[16];
+    snprintf(time, sizeof(time), "%02d:%02d", static_cast<int>(rng() % 24), static_cast<int>(rng() % 60));
+    reminder.time = time;
+    reminder.completed = rng() % 4 == 0;
+    reminder.notified = false;
+    reminder.priority = static_cast<int>(rng() % 3);
+    reminder.escalate_minutes = rng() % 5 == 0 ? 10 : 0;
+
+    size_t tags = rng() % 3;
+    for (size_t i = 0; i < tags; i++)
+    {
+        reminder.tags.push_back(TAGS[(n + i) % 5]);
+    }
+    return reminder;
+}
+
+struct BenchResult
+{
+    double populate_ms = 0;
+    double cold_load_ms = 0;
+    double warm_load_ms = 0;
+    size_t loaded = 0;
+    LatencyHistogram mutation;
+    long populated_kb = 0;
+    long final_kb = 0;
+};
+
+static bool run_engine(StorageEngine &engine, const std::string &path, const BenchOptions &options, BenchResult &result)
+{
+    for (const auto &file : store_files(path))
+    {
+        unlink(file.c_str());
+    }
+
+    // Same reminders and mutations for every engine
+    std::mt19937 rng(42);
+
+    if (!engine.open(path))
+        return false;
+
+    std::vector<int> ids;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.reminders; i++)
+    {
+        int id = engine.insert(generate_reminder(rng, i));
+        if (id == -1)
+            return false;
+        ids.push_back(id);
+    }
+    result.populate_ms = elapsed_ms(started);
+    engine.close();
+    result.populated_kb = store_size_kb(path);
+
+    std::vector<Reminder> reminders;
+    evict_store(path);
+    started = std::chrono::steady_clock::now();
+    if (!engine.open(path) || !engine.load_all(reminders))
+        return false;
+    result.cold_load_ms = elapsed_ms(started);
+    result.loaded = reminders.size();
+    engine.close();
+
+    started = std::chrono::steady_clock::now();
+    if (!engine.open(path) || !engine.load_all(reminders))
+        return false;
+    result.warm_load_ms = elapsed_ms(started);
+
+    std::vector<Reminder> live = reminders;
+    int next_title = options.reminders;
+
+    for (int i = 0; i < options.mutations; i++)
+    {
+        int kind = static_cast<int>(rng() % 100);
+        size_t index = live.empty() ? 0 : rng() % live.size();
+        bool ok = true;
+
+        started = std::chrono::steady_clock::now();
+        if (live.empty() || kind < 15)
+        {
+            Reminder added = generate_reminder(rng, next_title++);
+            added.id = engine.insert(added);
+            ok = added.id != -1;
+            if (ok)
+                live.push_back(added);
+        }
+        else if (kind < 55)
+        {
+            live[index].title += "*";
+            ok = engine.update(live[index], false);
+        }
+        else if (kind < 70)
+        {
+            live[index].completed = !live[index].completed;
+            ok = engine.set_flag(live[index].id, ReminderFlag::Completed, live[index].completed);
+        }
+        else if (kind < 85)
+        {
+            live[index].notified = true;
+            ok = engine.set_flag(live[index].id, ReminderFlag::Notified, true);
+        }
+        else
+        {
+            ok = engine.remove(live[index].id);
+            live[index] = live.back();
+            live.pop_back();
+        }
+        result.mutation.record(elapsed_ms(started));
+
+        if (!ok)
+            return false;
+    }
+
+    // What comes back must match what was written
+    engine.close();
+    if (!engine.open(path) || !engine.load_all(reminders) || reminders.size() != live.size())
+    {
+        std::cerr << engine.name() << ": reloaded " << reminders.size() << " reminders, expected "
+                  << live.size() << std::endl;
+        return false;
+    }
+    engine.close();
+    result.final_kb = store_size_kb(path);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        print_usage();
+        return 2;
+    }
+
+    if (options.dir.empty())
+    {
+        char scratch[] = "/tmp/reminder-storage-bench-XXXXXX";
+        if (!mkdtemp(scratch))
+        {
+            perror("mkdtemp");
+            return 2;
+        }
+        options.dir = scratch;
+    }
+    else
+    {
+        mkdir(options.dir.c_str(), 0700);
+    }
+
+    std::vector<std::pair<std::unique_ptr<StorageEngine>, std::string>> engines;
+    engines.emplace_back(std::unique_ptr<StorageEngine>(new SqliteStorage(options.sync)), options.dir + "/bench.db");
+    engines.emplace_back(std::unique_ptr<StorageEngine>(new LogStorage(options.sync)), options.dir + "/bench.log");
+
+    std::cout << "engine\treminders\tpopulate_ms\tcold_load_ms\twarm_load_ms\tmutate_p50_ms\tmutate_p99_ms\tmutate_max_ms\tpopulated_kb\tfinal_kb" << std::endl;
+
+    int status = 0;
+    for (auto &entry : engines)
+    {
+        StorageEngine &engine = *entry.first;
+        const std::string &path = entry.second;
+
+        BenchResult result;
+        if (!run_engine(engine, path, options, result))
+        {
+            std::cerr << engine.name() << ": benchmark failed" << std::endl;
+            status = 1;
+            continue;
+        }
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << engine.name() << "\t" << result.loaded << "\t" << result.populate_ms << "\t"
+                  << result.cold_load_ms << "\t" << result.warm_load_ms << "\t"
+                  << result.mutation.percentile(50) << "\t" << result.mutation.percentile(99) << "\t"
+                  << result.mutation.max() << "\t" << result.populated_kb << "\t" << result.final_kb << std::endl;
+
+        if (!options.keep)
+        {
+            for (const auto &file : store_files(path))
+            {
+                unlink(file.c_str());
+            }
+        }
+    }
+
+    if (!options.keep)
+    {
+        rmdir(options.dir.c_str());
+    }
+    return status;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "reminder.h"
+
+// Flags flipped on their own, without rewriting the whole reminder
+enum class ReminderFlag
+{
+    Completed,
+    Notified
+};
+
+// Where reminders are kept between runs. The app reads everything once at
+// start and afterwards writes one small change at a time, so engines are
+// judged on how fast they load and how cheap a single mutation is.
+class StorageEngine
+{
+public:
+    virtual ~StorageEngine() {}
+
+    virtual const char *name() const = 0;
+
+    // Open or create the store at path
+    virtual bool open(const std::string &path) = 0;
+    virtual void close() = 0;
+
+    // Every reminder, tags included. Returns false if the store can't be read.
+    virtual bool load_all(std::vector<Reminder> &reminders) = 0;
+
+    // Returns the ID given to the new reminder, or -1
+    virtual int insert(const Reminder &reminder) = 0;
+
+    // Put a removed reminder back under its own ID, e.g. to undo a delete.
+    // Fails if the ID is in use.
+    virtual bool restore(const Reminder &reminder) = 0;
+
+    // tags_changed lets an engine skip rewriting tags that are unchanged.
+    // Fails if no reminder has the ID, so a stale edit is not taken for
+    // a saved one.
+    virtual bool update(const Reminder &reminder, bool tags_changed) = 0;
+
+    virtual bool remove(int id) = 0;
+    virtual bool set_flag(int id, ReminderFlag flag, bool value) = 0;
+
+    // Clear the notified flag of every reminder, for a new day
+    virtual bool reset_notified() = 0;
+
+    // Group writes so they apply all together or not at all, and reach
+    // the disk with one flush. A failed commit leaves nothing applied.
+    virtual bool begin() = 0;
+    virtual bool commit() = 0;
+    virtual void rollback() = 0;
+};
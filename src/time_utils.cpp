@@ -0,0 +1,231 @@
+#include "time_utils.h"
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+std::string current_time_string(const Clock &clock)
+{
+    std::tm now_tm = clock.local_time(clock.now());
+
+    std::stringstream ss;
+    ss << std::setw(2) << std::setfill('0') << now_tm.tm_hour << ":"
+       << std::setw(2) << std::setfill('0') << now_tm.tm_min;
+
+    return ss.str();
+}
+
+std::string shift_reminder_time(const std::string &text, int minutes)
+{
+    int hour = 0, minute = 0, second = 0;
+    if (!parse_reminder_time(text, hour, minute, second))
+        return text;
+
+    const int minutes_per_day = 24 * 60;
+    int shifted = ((hour * 60 + minute + minutes) % minutes_per_day + minutes_per_day) % minutes_per_day;
+    return format_reminder_time(shifted / 60, shifted % 60, second);
+}
+
+std::string current_date_string(const Clock &clock)
+{
+    std::tm now_tm = clock.local_time(clock.now());
+
+    std::stringstream ss;
+    ss << (now_tm.tm_year + 1900) << "-"
+       << std::setw(2) << std::setfill('0') << (now_tm.tm_mon + 1) << "-"
+       << std::setw(2) << std::setfill('0') << now_tm.tm_mday;
+
+    return ss.str();
+}
+
+bool parse_reminder_time(const std::string &text, int &hour, int &minute, int &second)
+{
+    if ((text.size() != 5 && text.size() != 8) || text[2] != ':' || (text.size() == 8 && text[5] != ':'))
+        return false;
+
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (i % 3 != 2 && (text[i] < '0' || text[i] > '9'))
+            return false;
+    }
+
+    hour = std::stoi(text.substr(0, 2));
+    minute = std::stoi(text.substr(3, 2));
+    second = text.size() == 8 ? std::stoi(text.substr(6, 2)) : 0;
+    return hour < 24 && minute < 60 && second < 60;
+}
+
+bool is_valid_reminder_time(const std::string &text)
+{
+    int hour, minute, second;
+    return parse_reminder_time(text, hour, minute, second);
+}
+
+std::string format_reminder_time(int hour, int minute, int second)
+{
+    std::stringstream ss;
+    ss << std::setw(2) << std::setfill('0') << hour << ":"
+       << std::setw(2) << std::setfill('0') << minute;
+    if (second != 0)
+    {
+        ss << ":" << std::setw(2) << std::setfill('0') << second;
+    }
+
+    return ss.str();
+}
+
+// Local midnight of the given day, and whether that day is exactly 24 hours
+// long. mktime is slow, so the last few days looked up are cached per thread
+// (scheduling alternates between today and tomorrow).
+static Clock::time_point local_midnight(const Clock &clock, const std::tm &day_tm, bool &regular_day)
+{
+    struct MidnightCache
+    {
+        int year = -1;
+        int yday = -1;
+        Clock::time_point midnight;
+        bool regular = false;
+    };
+    thread_local MidnightCache cache[4];
+    thread_local int next_slot = 0;
+
+    for (const auto &entry : cache)
+    {
+        if (entry.year == day_tm.tm_year && entry.yday == day_tm.tm_yday)
+        {
+            regular_day = entry.regular;
+            return entry.midnight;
+        }
+    }
+
+    MidnightCache &entry = cache[next_slot];
+    next_slot = (next_slot + 1) % 4;
+
+    std::tm midnight_tm = day_tm;
+    midnight_tm.tm_hour = 0;
+    midnight_tm.tm_min = 0;
+    midnight_tm.tm_sec = 0;
+    entry.midnight = clock.from_local_time(midnight_tm);
+
+    midnight_tm.tm_mday += 1;
+    entry.regular = clock.from_local_time(midnight_tm) - entry.midnight == std::chrono::hours(24);
+    entry.year = day_tm.tm_year;
+    entry.yday = day_tm.tm_yday;
+
+    regular_day = entry.regular;
+    return entry.midnight;
+}
+
+// The calendar day after the given one, cached like local_midnight
+static std::tm next_day(const Clock &clock, const std::tm &day_tm)
+{
+    thread_local int cached_year = -1;
+    thread_local int cached_yday = -1;
+    thread_local std::tm cached_next;
+
+    if (cached_year != day_tm.tm_year || cached_yday != day_tm.tm_yday)
+    {
+        // Let mktime normalise the date so month ends are handled; noon
+        // keeps DST shifts from landing on the wrong day
+        std::tm next_tm = day_tm;
+        next_tm.tm_mday += 1;
+        next_tm.tm_hour = 12;
+        next_tm.tm_min = 0;
+        next_tm.tm_sec = 0;
+        cached_next = clock.local_time(clock.from_local_time(next_tm));
+        cached_year = day_tm.tm_year;
+        cached_yday = day_tm.tm_yday;
+    }
+
+    return cached_next;
+}
+
+// Local time of day on the given day
+static Clock::time_point time_on_day(const Clock &clock, const std::tm &day_tm, int hour, int minute, int second)
+{
+    bool regular_day;
+    Clock::time_point midnight = local_midnight(clock, day_tm, regular_day);
+
+    if (regular_day)
+    {
+        return midnight + std::chrono::hours(hour) + std::chrono::minutes(minute) + std::chrono::seconds(second);
+    }
+
+    // Days with a DST change go through mktime
+    std::tm reminder_tm = day_tm;
+    reminder_tm.tm_hour = hour;
+    reminder_tm.tm_min = minute;
+    reminder_tm.tm_sec = second;
+    return clock.from_local_time(reminder_tm);
+}
+
+Clock::time_point next_occurrence(const Clock &clock, const std::string &reminder_time, bool skip_today)
+{
+    int hour, minute, second;
+    if (!parse_reminder_time(reminder_time, hour, minute, second))
+    {
+        std::cerr << "Invalid reminder time: " << reminder_time << std::endl;
+        return Clock::time_point::max();
+    }
+
+    // The reminder stays due until its minute, or its second, has passed
+    auto window = reminder_time.size() == 8 ? std::chrono::seconds(1) : std::chrono::seconds(60);
+
+    Clock::time_point now = clock.now();
+    std::tm local_tm = clock.local_time(now);
+    auto when = time_on_day(clock, local_tm, hour, minute, second);
+
+    if (skip_today || when + window <= now)
+    {
+        when = time_on_day(clock, next_day(clock, local_tm), hour, minute, second);
+    }
+
+    return when;
+}
+
+Clock::time_point local_time_on_day(const Clock &clock, const std::tm &day_tm, int seconds_of_day)
+{
+    return time_on_day(clock, day_tm, seconds_of_day / 3600, seconds_of_day / 60 % 60, seconds_of_day % 60);
+}
+
+std::tm following_day(const Clock &clock, const std::tm &day_tm)
+{
+    return next_day(clock, day_tm);
+}
+
+Clock::time_point next_midnight(const Clock &clock)
+{
+    std::tm midnight_tm = clock.local_time(clock.now());
+    midnight_tm.tm_mday += 1;
+    midnight_tm.tm_hour = 0;
+    midnight_tm.tm_min = 0;
+    midnight_tm.tm_sec = 0;
+
+    return clock.from_local_time(midnight_tm);
+}
+
+std::string convert_to_12hour_format(const std::string &time24h)
+{
+    // Parse hour and the rest from 24-hour format (HH:MM or HH:MM:SS)
+    int hour = std::stoi(time24h.substr(0, 2));
+    std::string minute = time24h.substr(3);
+
+    // Convert to 12-hour format
+    std::string period = (hour >= 12) ? "PM" : "AM";
+
+    // Convert hour from 24-hour to 12-hour format
+    if (hour > 12)
+    {
+        hour -= 12;
+    }
+    else if (hour == 0)
+    {
+        hour = 12;
+    }
+
+    // Format the time string
+    std::stringstream ss;
+    ss << std::setw(2) << std::setfill('0') << hour << ":"
+       << minute << " " << period;
+
+    return ss.str();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "clock.h"
+#include <string>
+
+// Time helpers shared by the application, the scheduler and the simulator.
+// Reminder times are local "HH:MM" or "HH:MM:SS" strings; times on a whole
+// minute are written as "HH:MM" so older versions can still read them.
+
+// "HH:MM" and "YYYY-MM-DD" for the clock's current local time
+std::string current_time_string(const Clock &clock);
+std::string current_date_string(const Clock &clock);
+
+// Split a reminder time into its fields; second is 0 for "HH:MM"
+bool parse_reminder_time(const std::string &text, int &hour, int &minute, int &second);
+bool is_valid_reminder_time(const std::string &text);
+std::string format_reminder_time(int hour, int minute, int second);
+
+// Move a reminder time by minutes, wrapping around midnight. Returns the
+// time unchanged if it can't be parsed.
+std::string shift_reminder_time(const std::string &text, int minutes);
+
+// Next time the reminder is due. A reminder is still due during the minute
+// (or, with seconds, the second) it names; skip_today moves the occurrence
+// to tomorrow. A time that can't be parsed never occurs:
+// Clock::time_point::max() is returned.
+Clock::time_point next_occurrence(const Clock &clock, const std::string &reminder_time, bool skip_today);
+
+// The instant seconds_of_day after local midnight names on the calendar
+// day of day_tm, and the calendar day after day_tm. Regular days are
+// answered from a cache; days with a DST change go through mktime.
+Clock::time_point local_time_on_day(const Clock &clock, const std::tm &day_tm, int seconds_of_day);
+std::tm following_day(const Clock &clock, const std::tm &day_tm);
+
+// Next local midnight
+Clock::time_point next_midnight(const Clock &clock);
+
+// "HH:MM[:SS]" (24-hour) to "hh:MM[:SS] AM/PM"
+std::string convert_to_12hour_format(const std::string &time24h);
@@ -0,0 +1,463 @@
+// Rendering benchmark for the Reminder App GUI.
+//
+// Starts a headless display (Xvfb, or GTK's Broadway backend), seeds a
+// scratch HOME with a database of generated reminders and launches the app
+// in it with its own XDG_RUNTIME_DIR, so it neither sees nor disturbs the
+// user's instance. Startup is timed until the app reports every reminder
+// loaded. A fixed script then goes through the control channel: opening and
+// rebuilding the popup, toggling, editing, opening the edit dialog,
+// scrolling, filtering, rebuilding the list, adding and deleting. Each step
+// is timed from request until the app's main loop is idle again.
+//
+// The result is one JSON object on stdout: the client side timings per step
+// and the app's own statistics, which include time spent in refresh_list,
+// the popup's refresh, edit dialog latency and frame paint times.
+
+#include "control_channel.h"
+#include "metrics.h"
+#include "sqlite_storage.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ftw.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct UiBenchOptions
+{
+    std::string app;
+    std::string display = "xvfb"; // xvfb, broadway or current
+    int reminders = 1000;
+    int iterations = 20;
+    double timeout_s = 60;
+    bool keep = false;
+};
+
+static void print_usage()
+{
+    std::cerr << "Usage: reminder-ui-bench [options]\n"
+              << "  --app PATH            reminder binary (default: next to this one)\n"
+              << "  --display KIND        xvfb, broadway or current (default xvfb)\n"
+              << "  --reminders N         reminders in the seeded database (default 1000)\n"
+              << "  --iterations N        times to run the script (default 20)\n"
+              << "  --timeout SECONDS     how long startup may take (default 60)\n"
+              << "  --keep                leave the scratch HOME in place\n";
+}
+
+static bool parse_options(int argc, char *argv[], UiBenchOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--keep")
+            options.keep = true;
+        else if (arg == "--app" && has_value)
+            options.app = argv[++i];
+        else if (arg == "--display" && has_value)
+            options.display = argv[++i];
+        else if (arg == "--reminders" && has_value)
+            options.reminders = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--iterations" && has_value)
+            options.iterations = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--timeout" && has_value)
+            options.timeout_s = std::atof(argv[++i]);
+        else
+            return false;
+    }
+
+    if (options.display != "xvfb" && options.display != "broadway" && options.display != "current")
+        return false;
+
+    if (options.app.empty())
+    {
+        std::string self = argv[0];
+        size_t slash = self.rfind('/');
+        options.app = slash == std::string::npos ? "reminder" : self.substr(0, slash + 1) + "reminder";
+    }
+    return true;
+}
+
+static pid_t spawn(const std::vector<std::string> &args)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        std::vector<char *> argv;
+        for (const auto &arg : args)
+        {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        std::cerr << "Can't run " << args[0] << ": " << strerror(errno) << std::endl;
+        _exit(127);
+    }
+    return pid;
+}
+
+static void stop(pid_t pid)
+{
+    if (pid <= 0)
+        return;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+static bool exited(pid_t pid)
+{
+    return waitpid(pid, nullptr, WNOHANG) == pid;
+}
+
+// Xvfb picks a free display number and writes it to the pipe
+static pid_t start_xvfb(std::string &display)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+
+    pid_t pid = spawn({"Xvfb", "-displayfd", std::to_string(fds[1]), "-screen", "0", "1280x1024x24", "-nolisten", "tcp"});
+    close(fds[1]);
+
+    std::string number;
+    struct pollfd pfd = {fds[0], POLLIN, 0};
+    char c;
+    while (poll(&pfd, 1, 10000) > 0 && read(fds[0], &c, 1) == 1 && c != '\n')
+    {
+        number += c;
+    }
+    close(fds[0]);
+
+    if (number.empty())
+    {
+        std::cerr << "Xvfb did not start" << std::endl;
+        stop(pid);
+        return -1;
+    }
+
+    display = ":" + number;
+    return pid;
+}
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+// Reminders spread over the day, a tenth completed, some tagged
+static std::vector<int> seed_database(const std::string &path, int count)
+{
+    // Schema messages go to stderr, stdout is for the results
+    std::streambuf *stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+    std::vector<int> ids;
+    SqliteStorage storage(false);
+    if (!storage.open(path) || !storage.begin())
+    {
+        std::cout.rdbuf(stdout_buffer);
+        return ids;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int minute_of_day = static_cast<int>(static_cast<long>(i) * 1440 / std::max(1, count));
+        std::ostringstream time;
+        time << std::setw(2) << std::setfill('0') << minute_of_day / 60 << ":"
+             << std::setw(2) << std::setfill('0') << minute_of_day % 60;
+
+        Reminder reminder;
+        reminder.id = 0;
+        reminder.title = "Benchmark reminder " + std::to_string(i);
+        reminder.description = "Seeded by reminder-ui-bench";
+        reminder.time = time.str();
+        reminder.completed = i % 10 == 9;
+        reminder.notified = false;
+        reminder.priority = i % 3;
+        if (i % 4 == 0)
+            reminder.tags = {"bench", "tag" + std::to_string(i % 7)};
+
+        int id = storage.insert(reminder);
+        if (id == -1)
+            break;
+        ids.push_back(id);
+    }
+
+    if (!storage.commit())
+        ids.clear();
+    storage.close();
+
+    std::cout.rdbuf(stdout_buffer);
+    return ids;
+}
+
+static std::map<std::string, std::string> parse_stats(const std::string &reply)
+{
+    std::map<std::string, std::string> stats;
+    std::vector<std::string> fields = split_fields(reply);
+    for (size_t i = 1; i < fields.size(); i++)
+    {
+        size_t equals = fields[i].find('=');
+        if (equals != std::string::npos)
+            stats[fields[i].substr(0, equals)] = fields[i].substr(equals + 1);
+    }
+    return stats;
+}
+
+static std::string json_string(const std::string &value)
+{
+    std::string out = "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static std::string json_number(double value)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << value;
+    return out.str();
+}
+
+class UiBench
+{
+public:
+    explicit UiBench(const UiBenchOptions &options) : m_options(options)
+    {
+    }
+
+    bool run(const std::string &home, std::ostream &out);
+
+private:
+    const UiBenchOptions &m_options;
+    ControlClient m_client;
+    std::map<std::string, LatencyHistogram> m_steps;
+    std::string m_error;
+
+    bool step(const std::string &name, const std::vector<std::string> &request, std::string *reply = nullptr);
+    bool wait_for_app(pid_t app, double &startup_ms);
+};
+
+bool UiBench::step(const std::string &name, const std::vector<std::string> &request, std::string *reply)
+{
+    auto started = std::chrono::steady_clock::now();
+    std::string line = m_client.request(request);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    if (line.compare(0, 2, "ok") != 0)
+    {
+        m_error = join_fields(request) + ": " + (line.empty() ? "no reply" : line);
+        return false;
+    }
+
+    m_steps[name].record(ms);
+    if (reply)
+        *reply = line;
+    return true;
+}
+
+bool UiBench::wait_for_app(pid_t app, double &startup_ms)
+{
+    // The database is loaded on the main loop after the window is up;
+    // startup ends when every seeded reminder is in memory
+    auto started = std::chrono::steady_clock::now();
+    auto deadline = started + std::chrono::duration<double>(m_options.timeout_s);
+
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (exited(app))
+        {
+            m_error = "the app exited during startup";
+            return false;
+        }
+
+        // Checked first, as a failed connect is reported on stderr
+        if (access(control_socket_path().c_str(), F_OK) == 0 && m_client.connect(control_socket_path()))
+        {
+            std::map<std::string, std::string> stats = parse_stats(m_client.request({"stats"}));
+            if (std::atoi(stats["reminders"].c_str()) >= m_options.reminders)
+            {
+                startup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+                return true;
+            }
+            m_client.close();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    m_error = "the app did not finish starting in time";
+    return false;
+}
+
+bool UiBench::run(const std::string &home, std::ostream &out)
+{
+    std::string data_dir = home + "/.local/share";
+    mkdir((home + "/.local").c_str(), 0700);
+    mkdir(data_dir.c_str(), 0700);
+    mkdir((home + "/run").c_str(), 0700);
+
+    auto seed_started = std::chrono::steady_clock::now();
+    std::vector<int> ids = seed_database(data_dir + "/reminders.db", m_options.reminders);
+    double seed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - seed_started).count();
+    if (static_cast<int>(ids.size()) != m_options.reminders)
+    {
+        std::cerr << "Can't seed the database" << std::endl;
+        return false;
+    }
+
+    // The children inherit the scratch environment
+    setenv("HOME", home.c_str(), 1);
+    setenv("XDG_RUNTIME_DIR", (home + "/run").c_str(), 1);
+
+    pid_t display_server = -1;
+    if (m_options.display == "xvfb")
+    {
+        std::string display;
+        display_server = start_xvfb(display);
+        if (display_server == -1)
+            return false;
+        setenv("DISPLAY", display.c_str(), 1);
+        setenv("GDK_BACKEND", "x11", 1);
+    }
+    else if (m_options.display == "broadway")
+    {
+        std::string display = ":" + std::to_string(10 + getpid() % 80);
+        display_server = spawn({"broadwayd", display});
+        setenv("GDK_BACKEND", "broadway", 1);
+        setenv("BROADWAY_DISPLAY", display.c_str(), 1);
+
+        // broadwayd has no readiness signal; give it a moment to listen
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    pid_t app = spawn({m_options.app, "--show"});
+    double startup_ms = 0;
+    bool ok = wait_for_app(app, startup_ms) && m_client.request({"reset"}) == "ok";
+
+    for (int i = 0; ok && i < m_options.iterations; i++)
+    {
+        std::string id = ids.empty() ? "" : std::to_string(ids[i % ids.size()]);
+        std::string time = (i % 24 < 10 ? "0" : "") + std::to_string(i % 24) + ":30";
+
+        ok = step("popup_show", {"ui", "popup"}) &&
+             step("popup_refresh", {"ui", "refresh-popup"}) &&
+             step("popup_hide", {"ui", "popup-hide"}) &&
+             step("scroll", {"ui", "scroll", "1"}) &&
+             step("scroll", {"ui", "scroll", "0"}) &&
+             step("filter", {"ui", "filter", "1"}) &&
+             step("filter", {"ui", "filter", "0"}) &&
+             step("refresh", {"ui", "refresh"});
+
+        if (ok && !id.empty())
+        {
+            ok = step("toggle", {"toggle", id}) &&
+                 step("toggle", {"toggle", id}) &&
+                 step("edit", {"edit", id, time, "Edited reminder " + std::to_string(i)}) &&
+                 step("dialog_open", {"ui", "edit", id}) &&
+                 step("dialog_close", {"ui", "close-dialog"});
+        }
+
+        std::string reply;
+        if (ok && step("add", {"add", time, "Added reminder " + std::to_string(i)}, &reply))
+        {
+            std::vector<std::string> fields = split_fields(reply);
+            ok = fields.size() == 2 && step("delete", {"delete", fields[1]});
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    std::string stats_reply = ok ? m_client.request({"stats"}) : "";
+    if (ok && stats_reply.compare(0, 2, "ok") != 0)
+    {
+        m_error = "no statistics from the app";
+        ok = false;
+    }
+
+    m_client.close();
+    stop(app);
+    stop(display_server);
+
+    if (!ok)
+    {
+        std::cerr << "UI benchmark failed: " << m_error << std::endl;
+        return false;
+    }
+
+    out << "{\n"
+        << "  \"format\": 1,\n"
+        << "  \"display\": " << json_string(m_options.display) << ",\n"
+        << "  \"reminders\": " << m_options.reminders << ",\n"
+        << "  \"iterations\": " << m_options.iterations << ",\n"
+        << "  \"seed_ms\": " << json_number(seed_ms) << ",\n"
+        << "  \"startup_ms\": " << json_number(startup_ms) << ",\n"
+        << "  \"steps\": {";
+
+    const char *separator = "\n";
+    for (const auto &entry : m_steps)
+    {
+        const LatencyHistogram &histogram = entry.second;
+        out << separator << "    " << json_string(entry.first) << ": {"
+            << "\"count\": " << histogram.count()
+            << ", \"avg_ms\": " << json_number(histogram.mean())
+            << ", \"p50_ms\": " << json_number(histogram.percentile(50))
+            << ", \"p99_ms\": " << json_number(histogram.percentile(99))
+            << ", \"max_ms\": " << json_number(histogram.max()) << "}";
+        separator = ",\n";
+    }
+
+    out << "\n  },\n  \"app\": {";
+    separator = "\n";
+    for (const auto &entry : parse_stats(stats_reply))
+    {
+        out << separator << "    " << json_string(entry.first) << ": " << json_number(std::atof(entry.second.c_str()));
+        separator = ",\n";
+    }
+    out << "\n  }\n}" << std::endl;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    UiBenchOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        print_usage();
+        return 2;
+    }
+
+    char scratch[] = "/tmp/reminder-ui-bench.XXXXXX";
+    if (!mkdtemp(scratch))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    UiBench bench(options);
+    bool ok = bench.run(scratch, std::cout);
+
+    if (options.keep)
+        std::cerr << "Scratch HOME kept in " << scratch << std::endl;
+    else
+        nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    return ok ? 0 : 1;
+}
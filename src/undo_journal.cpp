@@ -0,0 +1,101 @@
+#include "undo_journal.h"
+#include <utility>
+
+std::string JournalEntry::describe() const
+{
+    size_t added = 0, deleted = 0;
+    for (const auto &delta : deltas)
+    {
+        added += !delta.had_before && delta.has_after;
+        deleted += delta.had_before && !delta.has_after;
+    }
+
+    std::string verb = added == deltas.size() ? "add" : deleted == deltas.size() ? "delete"
+                                                                                   : "edit";
+    if (deltas.size() == 1)
+    {
+        const Reminder &reminder = deltas[0].has_after ? deltas[0].after : deltas[0].before;
+        return verb + " \"" + reminder.title + "\"";
+    }
+    return verb + " " + std::to_string(deltas.size()) + " reminders";
+}
+
+UndoJournal::UndoJournal(size_t capacity) : m_capacity(capacity)
+{
+}
+
+void UndoJournal::record(JournalEntry entry)
+{
+    if (entry.deltas.empty() || m_capacity == 0)
+        return;
+
+    m_redo.clear();
+    m_undo.push_back(std::move(entry));
+    while (m_undo.size() > m_capacity)
+    {
+        m_undo.pop_front();
+    }
+}
+
+void UndoJournal::clear()
+{
+    m_undo.clear();
+    m_redo.clear();
+}
+
+const JournalEntry *UndoJournal::next_undo() const
+{
+    return m_undo.empty() ? nullptr : &m_undo.back();
+}
+
+const JournalEntry *UndoJournal::next_redo() const
+{
+    return m_redo.empty() ? nullptr : &m_redo.back();
+}
+
+void UndoJournal::undone()
+{
+    if (m_undo.empty())
+        return;
+
+    m_redo.push_back(std::move(m_undo.back()));
+    m_undo.pop_back();
+}
+
+void UndoJournal::redone()
+{
+    if (m_redo.empty())
+        return;
+
+    // Redo entries come from the undo stack, so this stays within capacity
+    m_undo.push_back(std::move(m_redo.back()));
+    m_redo.pop_back();
+}
+
+void UndoJournal::discard_undo()
+{
+    if (!m_undo.empty())
+        m_undo.pop_back();
+}
+
+void UndoJournal::discard_redo()
+{
+    if (!m_redo.empty())
+        m_redo.pop_back();
+}
+
+bool UndoJournal::in_expected_state(const ReminderDelta &delta, bool undoing, const Reminder *current)
+{
+    bool exists = undoing ? delta.has_after : delta.had_before;
+    if (!exists || !current)
+        return exists == (current != nullptr);
+
+    const Reminder &expected = undoing ? delta.after : delta.before;
+    return current->title == expected.title &&
+           current->description == expected.description &&
+           current->time == expected.time &&
+           current->completed == expected.completed &&
+           current->priority == expected.priority &&
+           current->tags == expected.tags &&
+           current->escalate_minutes == expected.escalate_minutes;
+}
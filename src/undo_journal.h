@@ -0,0 +1,63 @@
+#pragma once
+
+#include "reminder.h"
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+// One reminder before and after an action. A missing side means the
+// reminder didn't exist then: there is no before for an add and no after
+// for a delete.
+struct ReminderDelta
+{
+    int id;
+    bool had_before;
+    bool has_after;
+    Reminder before;
+    Reminder after;
+};
+
+// Everything one user action changed, undone and redone as a unit
+struct JournalEntry
+{
+    std::vector<ReminderDelta> deltas;
+
+    // e.g. "delete 3 reminders", for the Undo and Redo tooltips
+    std::string describe() const;
+};
+
+// Bounded undo and redo stacks of recent actions. Only the reminders an
+// action touched are kept, so undoing is a handful of row writes and
+// in-place view updates, never a reload. Recording a new action clears
+// the redo stack; past the capacity, the oldest action is forgotten.
+class UndoJournal
+{
+public:
+    explicit UndoJournal(size_t capacity);
+
+    void record(JournalEntry entry);
+    void clear();
+
+    // Newest action on each stack, or nullptr
+    const JournalEntry *next_undo() const;
+    const JournalEntry *next_redo() const;
+
+    // Move the newest action to the other stack after applying it
+    void undone();
+    void redone();
+
+    // Drop the newest action from a stack, when it no longer applies
+    void discard_undo();
+    void discard_redo();
+
+    // Whether the reminder is still as the delta left it (undoing) or as
+    // it found it (redoing). The notified flag is ignored, since deadlines
+    // flip it without the user doing anything.
+    static bool in_expected_state(const ReminderDelta &delta, bool undoing, const Reminder *current);
+
+private:
+    size_t m_capacity;
+    std::deque<JournalEntry> m_undo;
+    std::vector<JournalEntry> m_redo;
+};
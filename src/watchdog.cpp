@@ -0,0 +1,232 @@
+#include "watchdog.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool sd_notify_state(const std::string &state)
+{
+    const char *path = getenv("NOTIFY_SOCKET");
+    if (!path || (path[0] != '/' && path[0] != '@') || strlen(path) >= sizeof(sockaddr_un::sun_path))
+        return false;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    // A leading '@' names a socket in the abstract namespace
+    socklen_t length = offsetof(struct sockaddr_un, sun_path) + strlen(path);
+    if (path[0] == '@')
+    {
+        addr.sun_path[0] = '\0';
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return false;
+
+    bool ok = sendto(fd, state.data(), state.size(), MSG_NOSIGNAL,
+                     reinterpret_cast<struct sockaddr *>(&addr), length) != -1;
+    close(fd);
+    return ok;
+}
+
+std::chrono::microseconds watchdog_timeout()
+{
+    const char *usec = getenv("WATCHDOG_USEC");
+    if (!usec)
+        return std::chrono::microseconds(0);
+
+    // Set for the main process only; children must not ping for it
+    const char *pid = getenv("WATCHDOG_PID");
+    if (pid && std::atol(pid) != static_cast<long>(getpid()))
+        return std::chrono::microseconds(0);
+
+    return std::chrono::microseconds(std::strtoull(usec, nullptr, 10));
+}
+
+StallDetector::StallDetector() : m_running(false),
+                                 m_stalls(0)
+{
+}
+
+StallDetector::~StallDetector()
+{
+    stop();
+}
+
+int StallDetector::add_loop(const std::string &name, std::chrono::milliseconds budget,
+                            std::chrono::milliseconds beat_period)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Loop loop;
+    loop.name = name;
+    loop.budget = budget;
+    loop.beat_period = beat_period;
+    loop.last_beat = std::chrono::steady_clock::now();
+    m_loops.push_back(loop);
+    return static_cast<int>(m_loops.size()) - 1;
+}
+
+void StallDetector::beat(int loop)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loops[loop].last_beat = std::chrono::steady_clock::now();
+}
+
+void StallDetector::enter(int loop, const char *stage)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loops[loop].stages.emplace_back(stage, std::chrono::steady_clock::now());
+}
+
+void StallDetector::leave(int loop)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_loops[loop].stages.empty())
+    {
+        m_loops[loop].stages.pop_back();
+    }
+}
+
+void StallDetector::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running)
+        return;
+
+    // Heartbeats are only due from now on
+    for (auto &loop : m_loops)
+    {
+        loop.last_beat = std::chrono::steady_clock::now();
+    }
+
+    m_running = true;
+    m_thread = std::thread(&StallDetector::run, this);
+}
+
+void StallDetector::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeup.notify_all();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+size_t StallDetector::stalls() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stalls;
+}
+
+// Returns true if any loop is stalled. Called with the mutex held.
+bool StallDetector::check(time_point now)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+
+    bool any_stalled = false;
+
+    for (auto &loop : m_loops)
+    {
+        milliseconds lag(0);
+        std::string where = "an unmarked handler";
+
+        if (!loop.stages.empty())
+        {
+            lag = duration_cast<milliseconds>(now - loop.stages.front().second);
+            where.clear();
+            for (const auto &stage : loop.stages)
+            {
+                where += (where.empty() ? "" : " > ") + std::string(stage.first);
+            }
+        }
+        if (loop.beat_period.count() > 0)
+        {
+            lag = std::max(lag, duration_cast<milliseconds>(now - loop.last_beat) - loop.beat_period);
+        }
+
+        if (lag > loop.budget)
+        {
+            any_stalled = true;
+            loop.worst = std::max(loop.worst, lag);
+            if (!loop.stalled)
+            {
+                loop.stalled = true;
+                loop.stalled_in = where;
+                m_stalls++;
+                std::cerr << "Stall: " << loop.name << " loop has spent " << lag.count() << " ms in "
+                          << where << " (budget " << loop.budget.count() << " ms)" << std::endl;
+            }
+        }
+        else if (loop.stalled)
+        {
+            loop.stalled = false;
+            std::cerr << "Stall: " << loop.name << " loop recovered after " << loop.worst.count()
+                      << " ms in " << loop.stalled_in << std::endl;
+            loop.worst = milliseconds(0);
+        }
+    }
+
+    return any_stalled;
+}
+
+void StallDetector::run()
+{
+    std::chrono::microseconds watchdog = watchdog_timeout();
+
+    // Check at half the tightest budget, and ping at half the watchdog timeout
+    std::chrono::milliseconds period(1000);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &loop : m_loops)
+        {
+            period = std::min(period, loop.budget / 2);
+        }
+    }
+    period = std::max(period, std::chrono::milliseconds(10));
+
+    time_point last_ping;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_running)
+    {
+        m_wakeup.wait_for(lock, period);
+        if (!m_running)
+            break;
+
+        time_point now = std::chrono::steady_clock::now();
+        bool stalled = check(now);
+
+        // A stalled loop withholds the ping; systemd restarts us once the
+        // stall outlasts WatchdogSec
+        if (watchdog.count() > 0 && !stalled && now - last_ping >= watchdog / 2)
+        {
+            sd_notify_state("WATCHDOG=1");
+            last_ping = now;
+        }
+    }
+}
+
+StallScope::StallScope(StallDetector &detector, int loop, const char *stage) : m_detector(detector),
+                                                                              m_loop(loop)
+{
+    m_detector.enter(m_loop, stage);
+}
+
+StallScope::~StallScope()
+{
+    m_detector.leave(m_loop);
+}
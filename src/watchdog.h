@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Send a state string such as "READY=1" to systemd's $NOTIFY_SOCKET.
+// Returns false when not started by systemd with a notify socket.
+bool sd_notify_state(const std::string &state);
+
+// WatchdogSec of the unit, or zero when the watchdog is off for this process
+std::chrono::microseconds watchdog_timeout();
+
+// Watches the event loops of a process for stalls. A loop is stalled when
+// it has spent longer than its budget in one marked stage, or, for loops
+// that send heartbeats, when a heartbeat is overdue by more than the
+// budget. Stalls are logged with the loop, the stage and how long it has
+// taken, once when detected and once on recovery. When the systemd watchdog
+// is enabled, WATCHDOG=1 is only sent while no loop is stalled, so a hung
+// loop gets the service restarted.
+class StallDetector
+{
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    StallDetector();
+    virtual ~StallDetector();
+
+    // Register loops before start(). A zero beat period means the loop is
+    // only judged by its stages, for loops that may sleep indefinitely.
+    int add_loop(const std::string &name, std::chrono::milliseconds budget,
+                 std::chrono::milliseconds beat_period = std::chrono::milliseconds(0));
+
+    // Called from the loop being watched
+    void beat(int loop);
+    void enter(int loop, const char *stage);
+    void leave(int loop);
+
+    void start();
+    void stop();
+
+    size_t stalls() const;
+
+private:
+    struct Loop
+    {
+        std::string name;
+        std::chrono::milliseconds budget;
+        std::chrono::milliseconds beat_period;
+        time_point last_beat;
+        std::vector<std::pair<const char *, time_point>> stages; // Innermost last
+        bool stalled = false;
+        std::chrono::milliseconds worst{0}; // Longest lag in the current stall
+        std::string stalled_in;
+    };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::vector<Loop> m_loops;
+    std::thread m_thread;
+    bool m_running;
+    size_t m_stalls;
+
+    void run();
+    bool check(time_point now);
+};
+
+// Marks a stage of a loop for the lifetime of the object
+class StallScope
+{
+public:
+    StallScope(StallDetector &detector, int loop, const char *stage);
+    virtual ~StallScope();
+
+private:
+    StallDetector &m_detector;
+    int m_loop;
+};